@@ -19,10 +19,12 @@
     in a frame.  Define PROFILEGPA to send task notifications to GPA.  
     BeginTask/EndTask are nops if profiling is disabled.
 */
+#ifdef _WIN32
 #define PROFILEGPA
+#endif
 #ifdef PROFILEGPA
 
-#include "..\src\profile.h"
+#include "../src/profile.h"
 
 //extern __itt_domain* gDomain;
 
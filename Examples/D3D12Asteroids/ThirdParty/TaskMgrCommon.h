@@ -13,7 +13,25 @@
 // License for the specific language governing permissions and limitations
 // under the License.
 ////////////////////////////////////////////////////////////////////////////////
+#pragma once
 
+//
+//  The TaskMgr interfaces use the Win32 base types, provide them on other
+//  platforms so TaskMgrSS & TaskScheduler build there unchanged.
+//
+#ifndef _WIN32
+typedef int                 BOOL;
+typedef int                 INT;
+typedef unsigned int        UINT;
+typedef char                CHAR;
+typedef const char*         LPCSTR;
+#define VOID                void
+#define TRUE                1
+#define FALSE               0
+#define OPTIONAL
+#define OUT
+#define UNREFERENCED_PARAMETER( P ) (void)( P )
+#endif
 
 //  Callback type for tasks in the tasking TaskMgrTBB system
 typedef void (*TASKSETFUNC )( void*,
@@ -34,4 +52,36 @@ typedef unsigned int        TASKSETHANDLE;
 //
 #define MAX_SUCCESSORS                  5
 #define MAX_TASKSETS                    256
-#define MAX_TASKSETNAMELENGTH           512
\ No newline at end of file
+#define MAX_TASKSETNAMELENGTH           512
+
+//
+//  Largest task count of a taskset.  The SS work-stealing deques pack a
+//  taskset handle and a range of its tasks in 64 bits, the end of the last
+//  range must fit the 20 bits of a task index.
+//
+#define MAX_TASKSETSIZE                 ( ( 1 << 20 ) - 1 )
+
+//
+//  The SS TaskMgr has no fixed limit on live tasksets or successors, only
+//  the 24 bits of a handle its deques keep.  Tasksets are allocated in
+//  slabs of TASKSET_SLAB_SIZE, MAX_TASKSETS sizes the work queue of each of
+//  its pools & successors past MAX_SUCCESSORS go to linked chunks of
+//  SUCCESSOR_CHUNK_SIZE.
+//
+#define TASKSET_SLAB_SIZE               256
+#define SUCCESSOR_CHUNK_SIZE            16
+#define MAX_TASKSETHANDLES              ( 1 << 24 )
+
+//
+//  Policy of a taskset towards the idle workers of the other pools of a
+//  hybrid TaskMgrSS (P-Core, E-Core & 'Any' pools).  A set never runs on
+//  a pool whose logical processors lack the ISA it was created for.
+//
+enum TaskSetSteal
+{
+    TASKSET_STEAL_STRICT = 0,   //  Runs on the pool it was created for only
+    TASKSET_STEAL_PREFER = 1,   //  Other pools may steal the ranges its own
+                                //  pool's workers split off
+    TASKSET_STEAL_ANY    = 2,   //  Other pools may also claim its tasks
+                                //  from the work queue of its pool
+};
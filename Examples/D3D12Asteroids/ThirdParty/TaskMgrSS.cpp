@@ -17,23 +17,24 @@
 /*!
     \file TaskMgrSS.h
 
-    TaksMgrSS is a class that uses a custom Windows threads schedulers with a
+    TaksMgrSS is a class that uses a custom std::thread based scheduler with a
     C-style handle and callback mechanism for scheduling tasks across any 
-    number of CPU cores.
+    number of CPU cores, on Windows & Linux.
 
 */
+#ifdef _WIN32
 #include "SampleComponents.h"
+#endif
 #include "TaskMgrSS.h"
 
 #include "TaskScheduler.h"
 #include "spin_mutex.h"
 
+#ifdef _WIN32
 #include <strsafe.h>
-
-#pragma warning ( push )
-#pragma warning ( disable : 4995 ) // skip deprecated warning on intrinsics.
-#include <intrin.h>
-#pragma warning ( pop )
+#endif
+#include <stdio.h>
+#include <new>
 
 
 //
@@ -45,41 +46,140 @@ TaskMgrSS                      gTaskMgrSS;
 TaskMgrSS::TaskSet::TaskSet() 
 : mpFunc( NULL )
 , mpvArg( 0 )
+, mbCompleted( TRUE )
+, muRefCount( 0 )
 , muSize( 0 )
 , mhTaskset( TASKSETHANDLE_INVALID )
-, mbCompleted( TRUE )
+, muStartCount( 0 )
+, muCompletionCount( 0 )
+, muTaskId( 0 )
+, mCoreType( CoreTypes::ANY )
+, mRequiredISA( ISA_SCALAR )
+, mSteal( TASKSET_STEAL_STRICT )
+, mpScheduler( NULL )
+, mhNext( TASKSETHANDLE_INVALID )
 {
     mszSetName[ 0 ] = 0;
     memset( Successors, 0, sizeof( Successors ) ) ;
+    muSuccessorCount = 0;
+    mpSuccessorChunks = NULL;
+    mpLastSuccessorChunk = NULL;
 };
 
-void TaskMgrSS::TaskSet::Execute(INT iContextId)
+void TaskMgrSS::TaskSet::BeginIncarnation()
+{
+    //
+    //  Threads still holding the handle from the previous incarnation fail
+    //  to claim from now on, before the new settings are written.
+    //
+    muTaskId = ( ( muTaskId.load() >> 32 ) + 1 ) << 32;
+}
+
+UINT TaskMgrSS::TaskSet::PublishTasks(INT iTaskCount)
+{
+    const UINT uIncarnation = (UINT)( muTaskId.load() >> 32 );
+
+    muTaskId = ( (uint64_t)uIncarnation << 32 ) | (UINT)iTaskCount;
+    return uIncarnation;
+}
+
+BOOL TaskMgrSS::TaskSet::ClaimRange(UINT uIncarnation, INT iCount, INT* piBegin, INT* piEnd)
 {
-    int uIdx = _InterlockedDecrement(&muTaskId);
-    if(uIdx >= 0)
+    //
+    //  muTaskId counts the tasks not claimed yet in its low bits.  Claims
+    //  with the handle of an earlier incarnation of the set fail, the set
+    //  may run on another pool or need another ISA by now.
+    //
+    uint64_t uTaskId = muTaskId.load();
+    INT      iEnd;
+
+    do
     {
-        //gTaskMgrSS.mTaskScheduler.DecrementTaskCount();
+        iEnd = (INT)(UINT)uTaskId;
+        if( (UINT)( uTaskId >> 32 ) != uIncarnation || iEnd <= 0 )
+        {
+            return FALSE;
+        }
+
+        *piBegin = iEnd > iCount ? iEnd - iCount : 0;
+    } while( !muTaskId.compare_exchange_weak( uTaskId, ( uTaskId & 0xFFFFFFFF00000000ull ) | (UINT)*piBegin ) );
 
+    *piEnd = iEnd;
+    return TRUE;
+}
+
+void TaskMgrSS::TaskSet::ExecuteRange(INT iContextId, INT iBegin, INT iEnd)
+{
+    const UINT uSize = muSize;
+
+    for( INT uIdx = iBegin; uIdx < iEnd; ++uIdx )
+    {
         //ProfileBeginTask( mszSetName );
 
-        mpFunc( mpvArg, iContextId, uIdx, muSize );
+        mpFunc( mpvArg, iContextId, uIdx, uSize );
 
        // ProfileEndTask();
+    }
 
-        //gTaskMgr.CompleteTaskSet( mhTaskset );
-        UINT uCount = _InterlockedDecrement( (LONG*)&muCompletionCount );
+    //gTaskMgr.CompleteTaskSet( mhTaskset );
+    UINT uCount = muCompletionCount -= iEnd - iBegin;
 
-        if( 0 == uCount )
+    if( 0 == uCount )
+    {
+        CompleteTaskSet();
+    }
+}
+
+BOOL TaskMgrSS::TaskSet::AddSuccessor(TaskSet* pSuccessor)
+{
+    if( muSuccessorCount < MAX_SUCCESSORS )
+    {
+        Successors[ muSuccessorCount++ ] = pSuccessor;
+        return TRUE;
+    }
+
+    //
+    //  Link a new chunk when the last one is full
+    //
+    const UINT uChunkIdx = ( muSuccessorCount - MAX_SUCCESSORS ) % SUCCESSOR_CHUNK_SIZE;
+    if( 0 == uChunkIdx )
+    {
+        SuccessorChunk* pChunk = gTaskMgrSS.AllocateSuccessorChunk();
+        if( NULL == pChunk )
         {
-            mbCompleted = TRUE;
-            mpFunc = 0;
-            CompleteTaskSet();
+            return FALSE;
         }
+
+        pChunk->mpNext = NULL;
+        if( mpLastSuccessorChunk )
+        {
+            mpLastSuccessorChunk->mpNext = pChunk;
+        }
+        else
+        {
+            mpSuccessorChunks = pChunk;
+        }
+        mpLastSuccessorChunk = pChunk;
     }
+
+    mpLastSuccessorChunk->mpSets[ uChunkIdx ] = pSuccessor;
+    ++muSuccessorCount;
+    return TRUE;
 }
 
 void TaskMgrSS::TaskSet::CompleteTaskSet()
 {
+    //
+    //  A completed set completes again when it gets a new successor (see
+    //  CreateTaskSet), only the first completion releases the reference
+    //  of the tasking system.
+    //
+    const BOOL bFirstCompletion = !mbCompleted.exchange( TRUE );
+    if( bFirstCompletion )
+    {
+        mpFunc = 0;
+    }
+
     //
     //  The task set has completed.  We need to look at the successors
     //  and signal them that this dependency of theirs has completed.
@@ -87,66 +187,57 @@ void TaskMgrSS::TaskSet::CompleteTaskSet()
 
     mSuccessorsLock.aquire();
 
-    for( UINT uSuccessor = 0; uSuccessor < MAX_SUCCESSORS; ++uSuccessor )
-    {
-        TaskSet* pSuccessor = Successors[ uSuccessor ];
+    TaskSet**       ppSuccessors = Successors;
+    UINT            uListSize = MAX_SUCCESSORS;
+    SuccessorChunk* pChunk = NULL;
+    UINT            uSuccessor = 0;
 
+    for( UINT uLeft = muSuccessorCount; uLeft > 0; --uLeft )
+    {
         //
-        //  A signaled successor must be removed from the Successors list 
-        //  before the mSuccessorsLock can be released.
+        //  Move on to the next chunk once the inline list or a chunk is done
         //
-        Successors[ uSuccessor ] = NULL;
-            
-        if( NULL != pSuccessor ) 
+        if( uSuccessor == uListSize )
         {
-            UINT uStart;
+            pChunk = pChunk ? pChunk->mpNext : mpSuccessorChunks;
+            ppSuccessors = pChunk->mpSets;
+            uListSize = SUCCESSOR_CHUNK_SIZE;
+            uSuccessor = 0;
+        }
 
-            uStart = _InterlockedDecrement( (LONG*)&pSuccessor->muStartCount );
+        TaskSet* pSuccessor = ppSuccessors[ uSuccessor++ ];
 
-            //
-            //  If the start count is 0 the successor has had all its 
-            //  dependencies satisfied and can be scheduled.
-            //
-            if (0 == uStart)
-            {
-                if (gTaskMgrSS.mProcInfo.hybrid)
-                {
-#if CORE_ONLY
-                    gTaskMgrSS.mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-#else
-                    if (pSuccessor->mCoreType == CoreTypes::INTEL_ATOM)
-                    {
-                        gTaskMgrSS.mAtomTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                    }
-                    else if (pSuccessor->mCoreType == CoreTypes::INTEL_CORE)
-                    {
-                        gTaskMgrSS.mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                    }
-                    else if (pSuccessor->mCoreType == CoreTypes::ANY)
-                    {
-#if RESERVE_ANY
-                        gTaskMgrSS.mAnyTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-#else
-                        gTaskMgrSS.mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-#endif
-                    }
-                    else
-                    {
-                        gTaskMgrSS.mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                    }
-#endif
-                }
-                else
-                {
-                    gTaskMgrSS.mTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                }
-            }
+        //
+        //  If the start count is 0 the successor has had all its 
+        //  dependencies satisfied and can be scheduled.
+        //
+        if( 0 == --pSuccessor->muStartCount )
+        {
+            gTaskMgrSS.ScheduleTaskSet( pSuccessor );
         }
     }
 
+    //
+    //  Signaled successors must be removed from the Successors list 
+    //  before the mSuccessorsLock can be released.
+    //
+    SuccessorChunk* pFirstChunk = mpSuccessorChunks;
+    SuccessorChunk* pLastChunk = mpLastSuccessorChunk;
+    muSuccessorCount = 0;
+    mpSuccessorChunks = NULL;
+    mpLastSuccessorChunk = NULL;
+
     mSuccessorsLock.release();
 
-    gTaskMgrSS.ReleaseHandle( mhTaskset );
+    if( pFirstChunk )
+    {
+        gTaskMgrSS.FreeSuccessorChunks( pFirstChunk, pLastChunk );
+    }
+
+    if( bFirstCompletion )
+    {
+        gTaskMgrSS.ReleaseHandle( mhTaskset );
+    }
 }
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -155,58 +246,109 @@ void TaskMgrSS::TaskSet::CompleteTaskSet()
 //
 ///////////////////////////////////////////////////////////////////////////////
 
-TaskMgrSS::TaskMgrSS() : miDemoModeThreadCountOverride(-1)
+TaskMgrSS::TaskMgrSS() : miDemoModeThreadCountOverride(-1), muSlabCount(0), muFreeSets(TASKSETHANDLE_INVALID), mpFreeChunks(NULL), mAnyISA(ISA_SCALAR), mCoreISA(ISA_SCALAR), mAtomISA(ISA_SCALAR)
 {
-    memset(
-        mSets,
-        0x0,
-        sizeof( mSets ) );
 }
 
 TaskMgrSS::~TaskMgrSS()
 {
+    for( UINT uSlab = 0; uSlab < muSlabCount; ++uSlab )
+    {
+        delete [] mpSlabs[ uSlab ];
+    }
+
+    SuccessorChunk* pChunk = mpFreeChunks;
+    while( pChunk )
+    {
+        SuccessorChunk* pNext = pChunk->mpNext;
+        delete pChunk;
+        pChunk = pNext;
+    }
 }
 
 BOOL TaskMgrSS::Init(PROCESSOR_INFO& procInfo)
 {
     mProcInfo = procInfo;
 
+    // Size the pools for throughput from the unparked logical processors this process may run on
+    // (affinity, cgroup cpuset) and its CPU quota, keeping one P-Core for the main thread.
+    const int iAnyCount = procInfo.GetEffectiveCoreTypeCount(CoreTypes::ANY);
+
+    // Core types may differ in ISA (e.g. AVX-512 on P-Cores only), CreateTaskSet keeps tasksets
+    // dispatched for an ISA on pools whose logical processors all support it.
+    mAnyISA  = GetCoreTypeISA(procInfo, CoreTypes::ANY).level;
+    mCoreISA = mProcInfo.hybrid ? GetCoreTypeISA(procInfo, CoreTypes::INTEL_CORE).level : mAnyISA;
+    mAtomISA = mProcInfo.hybrid ? GetCoreTypeISA(procInfo, CoreTypes::INTEL_ATOM).level : mAnyISA;
+
     if (mProcInfo.hybrid)
 	{
+        // Reserve 1 thread for main thread
+        THREAD_RECOMMENDATION core;
+        RecommendThreads(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE, core, 1);
+
         printf("%s\n\r", procInfo.brandString);
-        printf("Logical Cores %d(%d P-Core(s)/%d E-Core(s))\n\r", procInfo.numLogicalCores, (int)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE), (int)procInfo.GetCoreTypeCount(CoreTypes::INTEL_ATOM));
+        printf("Logical Cores %d(%d P-Core(s)/%d E-Core(s)), %d usable\n\r", procInfo.numLogicalCores, (int)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE), (int)procInfo.GetCoreTypeCount(CoreTypes::INTEL_ATOM), iAnyCount);
 #if CORE_ONLY
-        // Reserve 1 thread for main thread
-        mCoreTaskScheduler.Init(procInfo, CoreTypes::INTEL_CORE, (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE) - 1);
-        printf("Initialized Core-Only Heterogeneous Threadpool (%d Threads)\n\r", (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE) - 1);
+        mCoreTaskScheduler.Init(procInfo, CoreTypes::INTEL_CORE, (int)core.threadCount);
+        printf("Initialized Core-Only Heterogeneous Threadpool (%d Threads)\n\r", (int)core.threadCount);
 #else
+        // E-Core threads only get the quota left over by the P-Core threads & the main thread
+        THREAD_RECOMMENDATION atom;
+        RecommendThreads(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_ATOM, atom, 0, core.threadCount + 1);
+        const int iAtomQuota = (int)atom.threadCount;
+
+        // Workers of the pools run each other's tasksets, their context IDs
+        // follow the ones of the preceding pools, 0 is the main thread's
+        UINT uContextBase = 0;
 #if RESERVE_ANY
         // Allocate 2 threads for 'any' threadpool
-        mAnyTaskScheduler.Init(procInfo, CoreTypes::ANY, (ULONG)2);
+        mAnyTaskScheduler.Init(procInfo, CoreTypes::ANY, 2, uContextBase);
+        uContextBase += mAnyTaskScheduler.GetThreadCount();
         printf("Initialized 'Any' Heterogeneous Threadpool (2 Threads)\n\r");
 
-        // Reserve 1 thread for main thread & 1 thread for 'any' threadpool
-        mCoreTaskScheduler.Init(procInfo, CoreTypes::INTEL_CORE, (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE) - 2);
-        printf("Initialized 'P-Core' Heterogeneous Threadpool (%d Threads)\n\r", (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE) - 2);
+        // Reserve 1 thread for 'any' threadpool
+        const int iCoreThreads = std::max(0, (int)core.threadCount - 1);
+        mCoreTaskScheduler.Init(procInfo, CoreTypes::INTEL_CORE, iCoreThreads, uContextBase);
+        uContextBase += mCoreTaskScheduler.GetThreadCount();
+        printf("Initialized 'P-Core' Heterogeneous Threadpool (%d Threads)\n\r", iCoreThreads);
 
         // Reserve 1 thread for 'any' threadpool
-        mAtomTaskScheduler.Init(procInfo, CoreTypes::INTEL_ATOM, (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_ATOM) - 1);
-        printf("Initialized 'E-Core' Heterogeneous Threadpool (%d Threads)\n\r", (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_ATOM) - 1);
+        mAtomTaskScheduler.Init(procInfo, CoreTypes::INTEL_ATOM, std::max(1, iAtomQuota - 1), uContextBase);
+        printf("Initialized 'E-Core' Heterogeneous Threadpool (%d Threads)\n\r", std::max(1, iAtomQuota - 1));
 #else
-        // Reserve 1 thread for main thread
-		mCoreTaskScheduler.Init(procInfo, CoreTypes::INTEL_CORE, (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE) - 1);
-        printf("Initialized 'P-Core' Heterogeneous Threadpool (%d Threads)\n\r", (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_CORE) - 1);
-		mAtomTaskScheduler.Init(procInfo, CoreTypes::INTEL_ATOM, (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_ATOM));
-        printf("Initialized 'E-Core' Heterogeneous Threadpool (%d Threads)\n\r", (ULONG)procInfo.GetCoreTypeCount(CoreTypes::INTEL_ATOM));
+		mCoreTaskScheduler.Init(procInfo, CoreTypes::INTEL_CORE, (int)core.threadCount, uContextBase);
+        uContextBase += mCoreTaskScheduler.GetThreadCount();
+        printf("Initialized 'P-Core' Heterogeneous Threadpool (%d Threads)\n\r", (int)core.threadCount);
+		mAtomTaskScheduler.Init(procInfo, CoreTypes::INTEL_ATOM, std::max(1, iAtomQuota), uContextBase);
+        printf("Initialized 'E-Core' Heterogeneous Threadpool (%d Threads)\n\r", std::max(1, iAtomQuota));
+#endif
+        // Idle workers of a pool run the tasksets of the others that allow it (see TaskSetSteal)
+        mCoreTaskScheduler.AddPeer(&mAtomTaskScheduler, mCoreISA);
+        mAtomTaskScheduler.AddPeer(&mCoreTaskScheduler, mAtomISA);
+#if RESERVE_ANY
+        mCoreTaskScheduler.AddPeer(&mAnyTaskScheduler, mCoreISA);
+        mAtomTaskScheduler.AddPeer(&mAnyTaskScheduler, mAtomISA);
+        mAnyTaskScheduler.AddPeer(&mCoreTaskScheduler, mAnyISA);
+        mAnyTaskScheduler.AddPeer(&mAtomTaskScheduler, mAnyISA);
 #endif
 #endif
+        // Without workers the P-Core pool runs on the main thread only, which
+        // may be on any logical processor (see TaskScheduler::WaitForFlag)
+        if (0 == mCoreTaskScheduler.GetThreadCount())
+        {
+            mCoreISA = mAnyISA;
+        }
     }
     else
     {
+        // Reserve 1 thread for main thread
+        THREAD_RECOMMENDATION any;
+        RecommendThreads(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::ANY, any, 1);
+
         printf("%s\n\r", procInfo.brandString);
-        printf("Logical Cores %d\n\r", procInfo.numLogicalCores);
-        mTaskScheduler.Init(procInfo, CoreTypes::ANY, procInfo.numLogicalCores - 1);
-        printf("Initialized Homogeneous Threadpool (%d Threads)\n\r", procInfo.numLogicalCores - 1);
+        printf("Logical Cores %d, %d usable\n\r", procInfo.numLogicalCores, iAnyCount);
+        mTaskScheduler.Init(procInfo, CoreTypes::ANY, (int)any.threadCount);
+        printf("Initialized Homogeneous Threadpool (%d Threads)\n\r", (int)any.threadCount);
     }
 
     return TRUE;
@@ -215,12 +357,15 @@ BOOL TaskMgrSS::Init(PROCESSOR_INFO& procInfo)
 VOID TaskMgrSS::Shutdown()
 {
     //  
-    //  Release any left-over tasksets
-    for( UINT uSet = 0; uSet < MAX_TASKSETS; ++uSet )
+    //  Release any left-over tasksets, including those tasks created
+    for( UINT uSlab = 0; uSlab < muSlabCount; ++uSlab )
     {
-        if( mSets[ uSet ].mpFunc )
+        for( UINT uSet = 0; uSet < TASKSET_SLAB_SIZE; ++uSet )
         {
-            WaitForSet( uSet );   
+            if( 0 != mpSlabs[ uSlab ][ uSet ].muRefCount )
+            {
+                WaitForSet( uSlab * TASKSET_SLAB_SIZE + uSet );
+            }
         }
     }
 
@@ -229,6 +374,13 @@ VOID TaskMgrSS::Shutdown()
 #if CORE_ONLY
         mCoreTaskScheduler.Shutdown();
 #else
+        // Workers read the work queues & deques of their peers, stop them all first
+#if RESERVE_ANY
+        mAnyTaskScheduler.Stop();
+#endif
+        mAtomTaskScheduler.Stop();
+        mCoreTaskScheduler.Stop();
+
 #if RESERVE_ANY
         mAnyTaskScheduler.Shutdown();
 #endif
@@ -242,6 +394,16 @@ VOID TaskMgrSS::Shutdown()
     }
 }
 
+BOOL TaskMgrSS::UpdateTopology(PROCESSOR_INFO& procInfo)
+{
+    //
+    //  The pools are sized & bound from procInfo in Init, rebuild them
+    //  once the tasksets queued on the current threads have completed.
+    Shutdown();
+
+    return Init(procInfo);
+}
+
 
 BOOL TaskMgrSS::CreateTaskSet(TASKSETFUNC     pFunc,
                               VOID*           pArg,
@@ -250,37 +412,60 @@ BOOL TaskMgrSS::CreateTaskSet(TASKSETFUNC     pFunc,
                               UINT            uInDepends,
                               OPTIONAL LPCSTR szSetName,
                               TASKSETHANDLE*  pOutHandle,
-                              CoreTypes       coreType)
+                              CoreTypes       coreType,
+                              ISALevel        requiredISA,
+                              TaskSetSteal    steal)
 {
     TASKSETHANDLE           hSet;
-    TASKSETHANDLE           hSetParent = TASKSETHANDLE_INVALID;
+    TaskSet*                pSet;
     TASKSETHANDLE*          pDepends = pInDepends;
     UINT                    uDepends = uInDepends;
     BOOL                    bResult = FALSE;
 
 
     //  Validate incomming parameters
-    if( 0 == uTaskCount || NULL == pFunc )
+    if( 0 == uTaskCount || uTaskCount > MAX_TASKSETSIZE || NULL == pFunc )
     {
         return FALSE;
     }
 
+    //  Never place a taskset on a pool with logical processors lacking the
+    //  ISA it was dispatched for, its threads would fault once they migrate.
+    if( requiredISA > GetPoolISALevel( coreType ) )
+    {
+        if( !mProcInfo.hybrid || requiredISA > GetPoolISALevel( CoreTypes::INTEL_CORE ) )
+        {
+            return FALSE;
+        }
+        coreType = CoreTypes::INTEL_CORE;
+    }
+
     //
     //  Allocate and setup the internal taskset
     //
     hSet = AllocateTaskSet();
+    if( TASKSETHANDLE_INVALID == hSet )
+    {
+        return FALSE;
+    }
+
+    pSet = GetTaskSet( hSet );
+    pSet->BeginIncarnation();
 
-    mSets[ hSet ].muRefCount        = 2;
-    mSets[ hSet ].muStartCount      = uDepends;
-    mSets[ hSet ].mpvArg            = pArg;
-    mSets[ hSet ].muSize            = uTaskCount;
-    mSets[ hSet ].muCompletionCount = uTaskCount;
-    mSets[ hSet ].muTaskId          = uTaskCount;
-    mSets[ hSet ].mhTaskset         = hSet;
-    mSets[ hSet ].mpFunc            = pFunc;
-    mSets[ hSet ].mbCompleted       = FALSE;
-    mSets[ hSet ].mCoreType         = mProcInfo.hybrid ? coreType : CoreTypes::ANY;
-    //mSets[ hSet ].mhAssignedSlot    = TASKSETHANDLE_INVALID;
+    pSet->muStartCount      = uDepends;
+    pSet->mpvArg            = pArg;
+    pSet->muSize            = uTaskCount;
+    pSet->muCompletionCount = uTaskCount;
+    pSet->mhTaskset         = hSet;
+    pSet->mpFunc            = pFunc;
+    pSet->mbCompleted       = FALSE;
+    pSet->mCoreType         = mProcInfo.hybrid ? coreType : CoreTypes::ANY;
+    pSet->mRequiredISA      = requiredISA;
+    pSet->mSteal            = steal;
+    //pSet->mhAssignedSlot    = TASKSETHANDLE_INVALID;
+
+    //  Marks the set live for Shutdown, which may run on another thread
+    pSet->muRefCount        = 2;
 
 #ifdef PROFILEGPA
     //
@@ -288,15 +473,15 @@ BOOL TaskMgrSS::CreateTaskSet(TASKSETFUNC     pFunc,
     if( szSetName )
     {
         StringCbCopyA(
-            mSets[ hSet ].mszSetName,
-            sizeof( mSets[ hSet ].mszSetName ),
+            pSet->mszSetName,
+            sizeof( pSet->mszSetName ),
             szSetName );
     }
     else
     {
         StringCbCopyA(
-            mSets[ hSet ].mszSetName,
-            sizeof( mSets[ hSet ].mszSetName ),
+            pSet->mszSetName,
+            sizeof( pSet->mszSetName ),
             "Unnamed Task" );
     }
 #else
@@ -309,36 +494,7 @@ BOOL TaskMgrSS::CreateTaskSet(TASKSETFUNC     pFunc,
     //
 	if(uDepends == 0)
 	{
-        if (mProcInfo.hybrid)
-        {
-#if CORE_ONLY
-            mCoreTaskScheduler.AddTaskSet(hSet, uTaskCount);
-#else
-            switch (mSets[hSet].mCoreType)
-            {
-            case CoreTypes::INTEL_ATOM:
-                mAtomTaskScheduler.AddTaskSet(hSet, uTaskCount);
-                break;
-            case CoreTypes::INTEL_CORE:
-                mCoreTaskScheduler.AddTaskSet(hSet, uTaskCount);
-                break;
-            case CoreTypes::ANY:
-#if RESERVE_ANY
-                mAnyTaskScheduler.AddTaskSet(hSet, uTaskCount);
-#else
-                mCoreTaskScheduler.AddTaskSet(hSet, uTaskCount);
-#endif
-                break;
-            default:
-                mCoreTaskScheduler.AddTaskSet(hSet, uTaskCount);
-                break;
-            }
-#endif
-        }
-        else
-        {
-            mTaskScheduler.AddTaskSet(hSet, uTaskCount);
-        }
+        ScheduleTaskSet(pSet);
 	}
     else for( UINT uDepend = 0; uDepend < uDepends; ++uDepend )
     {
@@ -347,36 +503,24 @@ BOOL TaskMgrSS::CreateTaskSet(TASKSETFUNC     pFunc,
         if(hDependsOn == TASKSETHANDLE_INVALID)
             continue;
 
-        TaskSet *pDependsOn = &mSets[ hDependsOn ];
-        LONG     lPrevCompletion;
+        TaskSet *pDependsOn = GetTaskSet( hDependsOn );
 
         //
         //  A taskset with a new successor is consider incomplete even if it
         //  already has completed.  This mechanism allows us tasksets that are
         //  already done to appear active and capable of spawning successors.
         //
-        lPrevCompletion = _InterlockedExchangeAdd( (LONG*)&pDependsOn->muCompletionCount, 1 );
+        ++pDependsOn->muCompletionCount;
 
         pDependsOn->mSuccessorsLock.aquire();
 
-        UINT uSuccessor;
-        for( uSuccessor = 0; uSuccessor < MAX_SUCCESSORS; ++uSuccessor )
-        {
-            if( NULL == pDependsOn->Successors[ uSuccessor ] )
-            {
-                pDependsOn->Successors[ uSuccessor ] = &mSets[ hSet ];
-                break;
-            }
-        }
-
         //
-        //  If the successor list is full we have a problem.  The app
-        //  needs to give us more space by increasing MAX_SUCCESSORS
+        //  The successor list only fails to grow when out of memory
         //
-        if( uSuccessor == MAX_SUCCESSORS )
+        if( !pDependsOn->AddSuccessor( pSet ) )
         {
-            printf( "Too many successors for this task set.\nIncrease MAX_SUCCESSORS\n" );
             pDependsOn->mSuccessorsLock.release();
+            CompleteTaskSet( hDependsOn );
             goto Cleanup;
         }
 
@@ -398,9 +542,74 @@ Cleanup:
     return bResult;
 }
 
+ISALevel TaskMgrSS::GetPoolISALevel( CoreTypes coreType ) const
+{
+    if( !mProcInfo.hybrid )
+    {
+        return mAnyISA;
+    }
+#if CORE_ONLY
+    UNREFERENCED_PARAMETER( coreType );
+    return mCoreISA;
+#else
+    switch( coreType )
+    {
+    case CoreTypes::INTEL_ATOM:
+        return mAtomISA;
+    case CoreTypes::ANY:
+#if RESERVE_ANY
+        return mAnyISA;
+#else
+        return mCoreISA;
+#endif
+    default:
+        return mCoreISA;
+    }
+#endif
+}
+
+VOID TaskMgrSS::GetCrossPoolSteals( CoreTypes coreType, UINT* puRanges, UINT* puTasks )
+{
+    *puRanges = 0;
+    *puTasks = 0;
+
+    //  Homogeneous & Core-Only setups have a single pool
+    if( !mProcInfo.hybrid )
+    {
+        return;
+    }
+#if CORE_ONLY
+    UNREFERENCED_PARAMETER( coreType );
+#else
+    switch( coreType )
+    {
+    case CoreTypes::INTEL_ATOM:
+        mAtomTaskScheduler.GetCrossPoolSteals( puRanges, puTasks );
+        break;
+    case CoreTypes::ANY:
+#if RESERVE_ANY
+        mAnyTaskScheduler.GetCrossPoolSteals( puRanges, puTasks );
+#else
+        mCoreTaskScheduler.GetCrossPoolSteals( puRanges, puTasks );
+#endif
+        break;
+    default:
+        mCoreTaskScheduler.GetCrossPoolSteals( puRanges, puTasks );
+        break;
+    }
+#endif
+}
+
 VOID TaskMgrSS::ReleaseHandle( TASKSETHANDLE hSet )
 {
-    _InterlockedDecrement( (LONG*)&mSets[ hSet ].muRefCount );
+    //
+    //  The set is recycled once both the app & the tasking system are done
+    //  with it.
+    //
+    if( 0 == --GetTaskSet( hSet )->muRefCount )
+    {
+        FreeTaskSets( hSet, hSet );
+    }
 }
 
 
@@ -417,38 +626,41 @@ VOID TaskMgrSS::WaitForSet( TASKSETHANDLE               hSet )
     //
     //  Yield the main thread to SS to get our taskset done faster!
     //  NOTE: tasks can only be waited on once.  After that they will
-    //  deadlock if waited on again.
-    if( !mSets[ hSet ].mbCompleted )
+    //  deadlock if waited on again.  The main thread only helps with
+    //  the tasksets its ISA, that of any logical processor, allows.
+    TaskSet* pSet = GetTaskSet( hSet );
+
+    if( !pSet->mbCompleted )
     {
         if (mProcInfo.hybrid)
         {
 #if CORE_ONLY
-            mCoreTaskScheduler.WaitForFlag(&mSets[hSet].mbCompleted);
+            mCoreTaskScheduler.WaitForFlag(&pSet->mbCompleted, mAnyISA);
 #else
-            switch (mSets[hSet].mCoreType)
+            switch (pSet->mCoreType)
             {
             case CoreTypes::INTEL_ATOM:
-                mAtomTaskScheduler.WaitForFlag(&mSets[hSet].mbCompleted);
+                mAtomTaskScheduler.WaitForFlag(&pSet->mbCompleted, mAnyISA);
                 break;
             case CoreTypes::INTEL_CORE:
-                mCoreTaskScheduler.WaitForFlag(&mSets[hSet].mbCompleted);
+                mCoreTaskScheduler.WaitForFlag(&pSet->mbCompleted, mAnyISA);
                 break;
             case CoreTypes::ANY:
 #if RESERVE_ANY
-                mAnyTaskScheduler.WaitForFlag(&mSets[hSet].mbCompleted);
+                mAnyTaskScheduler.WaitForFlag(&pSet->mbCompleted, mAnyISA);
 #else
-                mCoreTaskScheduler.WaitForFlag(&mSets[hSet].mbCompleted);
+                mCoreTaskScheduler.WaitForFlag(&pSet->mbCompleted, mAnyISA);
 #endif
                 break;
             default:
-                mCoreTaskScheduler.WaitForFlag(&mSets[hSet].mbCompleted);
+                mCoreTaskScheduler.WaitForFlag(&pSet->mbCompleted, mAnyISA);
                 break;
             }
 #endif
         }
         else
         {
-            mTaskScheduler.WaitForFlag(&mSets[hSet].mbCompleted);
+            mTaskScheduler.WaitForFlag(&pSet->mbCompleted, mAnyISA);
         }
     }
 
@@ -457,112 +669,184 @@ VOID TaskMgrSS::WaitForSet( TASKSETHANDLE               hSet )
 BOOL
 TaskMgrSS::IsSetComplete( TASKSETHANDLE hSet )
 {
-    return TRUE == mSets[ hSet ].mbCompleted;
+    return TRUE == GetTaskSet( hSet )->mbCompleted;
 }
 
 
 TASKSETHANDLE TaskMgrSS::AllocateTaskSet()
 {
-      // This line is fine
-    UINT                        uSet = muNextFreeSet;
+    TASKSETHANDLE hSet = PopFreeTaskSet();
+
+    if( TASKSETHANDLE_INVALID != hSet )
+    {
+        return hSet;
+    }
 
     //
-    //  Create a new task set and find a slot in the TaskMgrSS to put it in.
+    //  Every set is live, add a slab.  Threads running out at the same time
+    //  take turns, the later ones usually find the sets of the first one.
     //
-    //  NOTE: if we have too many tasks pending we will spin on the slot.  If
-    //  spinning occures, see TaskMgrCommon.h and increase MAX_TASKSETS
+    mSlabLock.aquire();
+
+    hSet = PopFreeTaskSet();
+    if( TASKSETHANDLE_INVALID != hSet )
+    {
+        mSlabLock.release();
+        return hSet;
+    }
+
+    //
+    //  Handles are limited to what the deques of the TaskScheduler can pack.
     //
+    const UINT uSlab = muSlabCount.load( std::memory_order_relaxed );
+    TaskSet* pSlab = NULL;
+    if( uSlab < MAX_TASKSETHANDLES / TASKSET_SLAB_SIZE )
+    {
+        pSlab = new (std::nothrow) TaskSet[ TASKSET_SLAB_SIZE ];
+    }
 
+    if( NULL == pSlab )
+    {
+        mSlabLock.release();
+        return TASKSETHANDLE_INVALID;
+    }
+
+    //
+    //  Handles of the slab reach other threads through the free list, which
+    //  publishes the slab pointer along with them.
+    //
+    mpSlabs[ uSlab ] = pSlab;
+    muSlabCount.store( uSlab + 1, std::memory_order_release );
+
+    //
+    //  Keep the first set of the slab and release the others
+    //
+    const TASKSETHANDLE hFirst = uSlab * TASKSET_SLAB_SIZE;
+    for( UINT uSet = 1; uSet < TASKSET_SLAB_SIZE - 1; ++uSet )
+    {
+        pSlab[ uSet ].mhNext.store( hFirst + uSet + 1, std::memory_order_relaxed );
+    }
+    FreeTaskSets( hFirst + 1, hFirst + TASKSET_SLAB_SIZE - 1 );
+
+    mSlabLock.release();
+
+    return hFirst;
+}
+
+TASKSETHANDLE TaskMgrSS::PopFreeTaskSet()
+{
+    //
+    //  Any thread may pop.  Each pop bumps the count in the high bits of the
+    //  head so an exchange fails if the head set was popped & pushed again
+    //  (ABA) after it was read, mhNext being stale by then.  The set itself
+    //  stays readable since slabs are never freed.
+    //
+    uint64_t uHead = muFreeSets.load( std::memory_order_acquire );
+
+    while( TASKSETHANDLE_INVALID != (TASKSETHANDLE)uHead )
+    {
+        const TASKSETHANDLE hNext = GetTaskSet( (TASKSETHANDLE)uHead )->mhNext.load( std::memory_order_relaxed );
+        const uint64_t      uNext = ( ( ( uHead >> 32 ) + 1 ) << 32 ) | hNext;
+
+        if( muFreeSets.compare_exchange_weak( uHead, uNext, std::memory_order_acquire ) )
+        {
+            break;
+        }
+    }
+
+    return (TASKSETHANDLE)uHead;
+}
+
+VOID TaskMgrSS::FreeTaskSets( TASKSETHANDLE hFirst, TASKSETHANDLE hLast )
+{
+    TaskSet*    pLast = GetTaskSet( hLast );
+    uint64_t    uHead = muFreeSets.load( std::memory_order_relaxed );
+
+    do
+    {
+        pLast->mhNext.store( (TASKSETHANDLE)uHead, std::memory_order_relaxed );
+    } while( !muFreeSets.compare_exchange_weak( uHead, ( uHead & 0xFFFFFFFF00000000ull ) | hFirst, std::memory_order_release, std::memory_order_relaxed ) );
+}
+
+TaskMgrSS::SuccessorChunk* TaskMgrSS::AllocateSuccessorChunk()
+{
     //
-    //  NOTE: Allocating tasksets is not thread-safe due to allocation of the
-    //  slot for the task pointer.  This can be easily made threadsafe with 
-    //  an interlocked op on the muNextFreeSet variable and a spin on the slot.  
-    //  It will cost a small amount of performance.
+    //  Chunks are released lock free, but only needed by sets with more than
+    //  MAX_SUCCESSORS successors, so a lock is held to pop one.  With a single
+    //  thread popping, the head can't be popped & pushed again (ABA) between
+    //  the load and the exchange.
     //
-    while( NULL != mSets[ uSet ].mpFunc && mSets[ uSet ].muRefCount != 0 )
-    { 
-        uSet = ( uSet + 1 ) % MAX_TASKSETS;
+    mChunkLock.aquire();
+
+    SuccessorChunk* pChunk = mpFreeChunks.load( std::memory_order_acquire );
+
+    while( NULL != pChunk &&
+           !mpFreeChunks.compare_exchange_weak( pChunk, pChunk->mpNext, std::memory_order_acquire ) )
+    {
     }
 
-    muNextFreeSet = ( uSet + 1 ) & (MAX_TASKSETS - 1);
+    mChunkLock.release();
 
-    return (TASKSETHANDLE)uSet;
+    if( NULL == pChunk )
+    {
+        pChunk = new (std::nothrow) SuccessorChunk;
+    }
+
+    return pChunk;
+}
+
+VOID TaskMgrSS::FreeSuccessorChunks( SuccessorChunk* pFirst, SuccessorChunk* pLast )
+{
+    SuccessorChunk* pHead = mpFreeChunks.load( std::memory_order_relaxed );
+
+    do
+    {
+        pLast->mpNext = pHead;
+    } while( !mpFreeChunks.compare_exchange_weak( pHead, pFirst, std::memory_order_release, std::memory_order_relaxed ) );
 }
 
 VOID TaskMgrSS::CompleteTaskSet( TASKSETHANDLE hSet )
 {
-    TaskSet*             pSet = &mSets[ hSet ];
+    TaskSet*             pSet = GetTaskSet( hSet );
 
-    UINT uCount = _InterlockedDecrement( (LONG*)&pSet->muCompletionCount );
+    UINT uCount = --pSet->muCompletionCount;
 
     if( 0 == uCount )
     {
-        pSet->mbCompleted = TRUE;
-        pSet->mpFunc = 0;
-        //
-        //  The task set has completed.  We need to look at the successors
-        //  and signal them that this dependency of theirs has completed.
-        //
-        pSet->mSuccessorsLock.aquire();
+        pSet->CompleteTaskSet();
+    }
+}
 
-        for( UINT uSuccessor = 0; uSuccessor < MAX_SUCCESSORS; ++uSuccessor )
-        {
-            TaskSet* pSuccessor = pSet->Successors[ uSuccessor ];
-
-            //
-            //  A signaled successor must be removed from the Successors list 
-            //  before the mSuccessorsLock can be released.
-            //
-            pSet->Successors[ uSuccessor ] = NULL;
-            
-            if( NULL != pSuccessor ) 
-            {
-                UINT uStart;
-
-                uStart = _InterlockedDecrement( (LONG*)&pSuccessor->muStartCount );
-
-                //
-                //  If the start count is 0 the successor has had all its 
-                //  dependencies satisified and can be scheduled.
-                //
-                if( 0 == uStart )
-                {
-                    if (mProcInfo.hybrid)
-                    {
+VOID TaskMgrSS::ScheduleTaskSet( TaskSet* pSet )
+{
+    if (mProcInfo.hybrid)
+    {
 #if CORE_ONLY
-                        mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
+        mCoreTaskScheduler.AddTaskSet(pSet->mhTaskset, pSet->muSize);
 #else
-                        switch (pSuccessor->mCoreType)
-                        {
-                        case CoreTypes::INTEL_ATOM:
-                            mAtomTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                            break;
-                        case CoreTypes::INTEL_CORE:
-                            mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                            break;
-                        case CoreTypes::ANY:
+        switch (pSet->mCoreType)
+        {
+        case CoreTypes::INTEL_ATOM:
+            mAtomTaskScheduler.AddTaskSet(pSet->mhTaskset, pSet->muSize);
+            break;
+        case CoreTypes::INTEL_CORE:
+            mCoreTaskScheduler.AddTaskSet(pSet->mhTaskset, pSet->muSize);
+            break;
+        case CoreTypes::ANY:
 #if RESERVE_ANY
-                            mAnyTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
+            mAnyTaskScheduler.AddTaskSet(pSet->mhTaskset, pSet->muSize);
 #else
-                            mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-#endif
-                            break;
-                        default:
-                            mCoreTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                            break;
-                        }
+            mCoreTaskScheduler.AddTaskSet(pSet->mhTaskset, pSet->muSize);
 #endif
-                    }
-                    else
-                    {
-                        mTaskScheduler.AddTaskSet(pSuccessor->mhTaskset, pSuccessor->muSize);
-                    }
-                }
-            }
+            break;
+        default:
+            mCoreTaskScheduler.AddTaskSet(pSet->mhTaskset, pSet->muSize);
+            break;
         }
-
-        pSet->mSuccessorsLock.release();
-
-        ReleaseHandle( hSet );
+#endif
+    }
+    else
+    {
+        mTaskScheduler.AddTaskSet(pSet->mhTaskset, pSet->muSize);
     }
 }
@@ -17,32 +17,38 @@
 /*!
     \file TaskMgrSS.h
 
-    TaksMgrSS is a class that uses a custom Windows threads schedulers with a
+    TaksMgrSS is a class that uses a custom std::thread based scheduler with a
     C-style handle and callback mechanism for scheduling tasks across any 
-    number of CPU cores.
+    number of CPU cores, on Windows & Linux.
 
     TaskMgrSS is a singleton object and is already instantiated for the app as
-    gTaskMgrSS.  The TaskMgrSS is single threaded, meaning that tasksets can only
-    be created from one thread. With minor changes and some performance loss,
-    multiple threads can create tsk sets (see AllocateTaskSet in TaskMgrSS.cpp).
-    The app can control two knobs in the TaskMgrSS class through MAX_SUCCESSORS
-    and MAX_TASKSETS degined below.
-
-    MAX_SUCCESSORS is the maximum number of tasksets that can be have depended
-    on another taskset.  For example if you have Tasksets A,B,C and both B and 
-    C can run simultaniously and both depend on A to complete (so A->(B,C)) then
-    A has two successors.  There is a small performance hit for large numbers
-    of successors so the value should be set to something reasonably close to 
-    the maximum the app will use. The default value is 5.
-
-    MAX_TASKSETS is the max number of tasksets that can be live at one  time. 
-    A taskset is live if it has a non-zero reference count.  Increasing the 
-    number of tasksets that can be live increases the memory footprint of the 
-    TaskMgrSS object.  The default value is 255.
+    gTaskMgrSS.  Tasksets can be created & released from any thread, including
+    from the tasks of a running taskset, so tasks can spawn child tasksets
+    (see AllocateTaskSet in TaskMgrSS.cpp).  Init, Shutdown, UpdateTopology and
+    WaitForSet are for the main thread only.
+    The app can control the knobs in the TaskMgrSS class through MAX_SUCCESSORS,
+    MAX_TASKSETS, TASKSET_SLAB_SIZE and SUCCESSOR_CHUNK_SIZE in TaskMgrCommon.h.
+
+    MAX_SUCCESSORS is the number of tasksets that can depend on another taskset
+    before a chunk of SUCCESSOR_CHUNK_SIZE more is linked to it.  For example if
+    you have Tasksets A,B,C and both B and C can run simultaniously and both
+    depend on A to complete (so A->(B,C)) then A has two successors.  The value
+    should be set to something reasonably close to what most tasksets use, the
+    chunks are recycled but cost an allocation the first time. The default
+    value is 5.
+
+    A taskset is live if it has a non-zero reference count.  Tasksets are
+    allocated in slabs of TASKSET_SLAB_SIZE and recycled through a free list
+    once released, any number can be live at one time (up to 2^24).
+    MAX_TASKSETS is the number of slots of the work queue of each pool, more
+    ready tasksets wait in an overflow queue.  The default value is 256.
 */
 #pragma once
 
+#ifdef _WIN32
 #include <wtypes.h>
+#endif
+#include <atomic>
 #include "Profile.h"
 #include "TaskMgrCommon.h"
 
@@ -53,7 +59,7 @@
 #ifndef  DYNAMIC_BASE
 #   define DYNAMIC_BASE
 #endif
-#define CACHE_ALIGN __declspec(align(64))
+#define CACHE_ALIGN alignas(64)
 
 #include "spin_mutex.h"
 #include "TaskScheduler.h"
@@ -61,11 +67,12 @@
 #define RESERVE_ANY     0 // Hybrid Only, 1 reserves 2 'Any' threads
 #define CORE_ONLY       0 // Hybrid Only, Run all Tasks in 'Core' threads.
 
-/*! The TaskMgrSS allows the user to schedule tasksets All TaskMgrSS 
-    functions are NOT threadsafe.  TaskMgr is designed to be called 
+/*! The TaskMgrSS allows the user to schedule tasksets.  CreateTaskSet,
+    ReleaseHandle(s) and IsSetComplete are threadsafe and may be called
+    from tasks, the other TaskMgrSS functions are designed to be called
     only from the main thread.  Multi-threading is achieved by 
-    creating TaskSets that execte on threads created by a Windows
-    threads based scheduler.
+    creating TaskSets that execte on threads created by a std::thread
+    based scheduler.
 */
 class TaskMgrSS DYNAMIC_BASE
 {
@@ -85,14 +92,26 @@ public:
     VOID
         Shutdown();
 
+    //  UpdateTopology rebuilds the thread pools for a new PROCESSOR_INFO
+    //  generation (see TopologyWatcher), growing or shrinking them when
+    //  logical processors went offline/online or were parked.  It waits
+    //  for the outstanding tasksets, like Shutdown, so it must be called
+    //  from the main thread between frames.
+    BOOL
+        UpdateTopology(PROCESSOR_INFO& procInfo);
+
     //  Creates a task set and provides a handle to allow the application
-    //  CreateTaskSet can fail if, by adding this task to the successor lists
-    //  of its dependecies the list exceeds MAX_SUCCESSORS.  To fix, increase
-    //  MAX_SUCCESSORS.
+    //  CreateTaskSet only fails on invalid parameters, an ISA no pool
+    //  supports, or when out of memory or taskset handles.  Successors past
+    //  MAX_SUCCESSORS go to chunks allocated on demand.
     //
     //  NOTE: A tasket of size 1 is valid.  The most common case is to have 
     //  tasksets of >> 1 so the default tasking primitive is a taskset rather
     //  than a task.
+    //
+    //  NOTE: Tasks may create tasksets, e.g. to split work further.  A task
+    //  must not wait on them, make a taskset depending on them instead.  The
+    //  creating thread must hold a handle to each taskset in pDepends.
     BOOL  CreateTaskSet(TASKSETFUNC                 pFunc,        //  Function pointer to the 
                                                                   //  Taskset callback function
                         VOID*                       pArg,         //  App data pointer (can be NULL)
@@ -106,7 +125,25 @@ public:
                         OPTIONAL LPCSTR             szSetName,    //  [Optional] name of the taskset
                                                                   //  the name is used for profiling
                         OUT TASKSETHANDLE*          pOutHandle,     //  [Out] Handle to the new taskset
-                        CoreTypes                   coreType);  
+                        CoreTypes                   coreType,
+                        ISALevel                    requiredISA = ISA_SCALAR,   //  ISA the taskset was dispatched
+                                                                  //  for. A taskset is moved to the P-Core
+                                                                  //  pool, or refused, when the logical
+                                                                  //  processors of its pool lack that ISA.
+                        TaskSetSteal                steal = TASKSET_STEAL_STRICT);  //  If idle workers of the other
+                                                                  //  pools may run the taskset.  Its tasks
+                                                                  //  then get the context IDs of those
+                                                                  //  workers, unique across the pools:
+                                                                  //  0 for the main thread, then the
+                                                                  //  workers of each pool in turn.
+
+    //  Ranges & tasks of the other pools' tasksets the workers of the pool
+    //  serving coreType ran since the previous call (see TaskSetSteal).
+    VOID GetCrossPoolSteals( CoreTypes coreType, UINT* puRanges, UINT* puTasks );
+
+    //  ISA common to every logical processor the pool serving coreType runs on.
+    //  Select per pool variants of an ISADispatch with it.
+    ISALevel GetPoolISALevel( CoreTypes coreType ) const;
 
     //  All TASKSETHANDLE must be released when no longer referenced.  
     //  ReleaseHandle will release the Applications reference on the taskset.
@@ -121,7 +158,8 @@ public:
                          UINT uSet );           //  count of taskset handle array
 
     //  WaitForSet will yeild the main thread to the tasking system and return
-    //  only when the taskset specified has completed execution.
+    //  only when the taskset specified has completed execution.  It must not
+    //  be called from a task.
     VOID WaitForSet( TASKSETHANDLE hSet );      // Taskset to wait for completion
     
    // VOID WaitForAll();
@@ -141,13 +179,39 @@ public:
     INT miDemoModeThreadCountOverride;
 private:
 
+    class TaskSet;
+
+      // Successors of a taskset past its MAX_SUCCESSORS
+    struct SuccessorChunk
+    {
+        TaskSet*        mpSets[ SUCCESSOR_CHUNK_SIZE ];
+        SuccessorChunk* mpNext;
+    };
+
     class TaskSet
     {
     public:
         TaskSet();
 
-          // Executes a single task on a thread identified by iContextId
-        void Execute(INT iContextId);
+          // Appends pSuccessor to the successor list, the caller holds
+          // mSuccessorsLock.  Fails when a chunk can't be allocated.
+        BOOL AddSuccessor(TaskSet* pSuccessor);
+
+          // Starts a new incarnation of the set, none of its tasks can be
+          // claimed until PublishTasks
+        void BeginIncarnation();
+
+          // Makes iTaskCount tasks claimable, returns the incarnation to
+          // claim them with (see TASKSLOT)
+        UINT PublishTasks(INT iTaskCount);
+
+          // Claims up to iCount of the tasks not started yet, the task
+          // indices [*piBegin, *piEnd).  Returns FALSE once all are claimed
+          // or the set is no longer in incarnation uIncarnation.
+        BOOL ClaimRange(UINT uIncarnation, INT iCount, INT* piBegin, INT* piEnd);
+
+          // Executes the claimed tasks [iBegin, iEnd) on a thread identified by iContextId
+        void ExecuteRange(INT iContextId, INT iBegin, INT iEnd);
 
           // Marks the TaskSetSS as completed
         void CompleteTaskSet();
@@ -157,44 +221,85 @@ private:
         void*                   mpvArg;
 
           // Interal bookkeeping for for managing the TaskSet
-        BOOL                       mbCompleted;
-        volatile UINT              muRefCount;
-        UINT                       muSize;  
+        std::atomic<BOOL>          mbCompleted;
+        std::atomic<UINT>          muRefCount;
+          // Read by workers holding stale handles of the set, see ClaimTasks
+        std::atomic<UINT>          muSize;
 
           // Lock to keep threads from destroying the successor list
         spin_mutex    mSuccessorsLock;
 
           // 
         TASKSETHANDLE mhTaskset;
-        volatile UINT muStartCount;
+        std::atomic<UINT> muStartCount;
         TaskSet*      Successors[ MAX_SUCCESSORS ];
+        UINT          muSuccessorCount;
+          // Successors past MAX_SUCCESSORS, the last chunk is the partial one
+        SuccessorChunk* mpSuccessorChunks;
+        SuccessorChunk* mpLastSuccessorChunk;
         CHAR          mszSetName[ MAX_TASKSETNAMELENGTH ];
 
-        volatile long  muCompletionCount;
-        volatile long  muTaskId;
+        std::atomic<INT>  muCompletionCount;
+          // Incarnation (32 bits) | tasks not claimed yet (32 bits)
+        std::atomic<uint64_t>  muTaskId;
 
         CoreTypes       mCoreType;
+        std::atomic<ISALevel>       mRequiredISA;
+        std::atomic<TaskSetSteal>   mSteal;
+
+          // Pool the set was added to, its tasks are accounted there
+        TaskScheduler*  mpScheduler;
+          // Next set in the free list, read by threads racing to pop the set
+        std::atomic<TASKSETHANDLE>  mhNext;
     };
 
     friend class TaskScheduler;
     friend class TaskSetSS;
 
     //  INTERNAL:
-    //  Allocate a free slot in the mSets list
+    //  Takes a released taskset from the free list, adding a slab when it
+    //  is empty.  Returns TASKSETHANDLE_INVALID when out of handles/memory.
     TASKSETHANDLE AllocateTaskSet();
+    TASKSETHANDLE PopFreeTaskSet();
+
+    //  INTERNAL:
+    //  Returns the sets hFirst..hLast, linked through mhNext, to the free list.
+    VOID FreeTaskSets( TASKSETHANDLE hFirst, TASKSETHANDLE hLast );
+
+    //  INTERNAL:
+    //  Successor chunks are recycled like the tasksets.
+    SuccessorChunk* AllocateSuccessorChunk();
+    VOID FreeSuccessorChunks( SuccessorChunk* pFirst, SuccessorChunk* pLast );
 
     //  INTERNAL:
     //  Called by the tasking system when a task in a set completes.
     VOID CompleteTaskSet( TASKSETHANDLE hSet );
 
+    //  INTERNAL:
+    //  Adds a set whose dependencies completed to the pool of its core type.
+    VOID ScheduleTaskSet( TaskSet* pSet );
+
     VOID ExecuteTask( TASKSETHANDLE hSet );
 
+    TaskSet* GetTaskSet( TASKSETHANDLE hSet )
+    {
+        return &mpSlabs[ hSet / TASKSET_SLAB_SIZE ][ hSet % TASKSET_SLAB_SIZE ];
+    }
 
-    //  Array containing the SS task parents.
-    TaskSet mSets[ MAX_TASKSETS ];
 
-    //  Helper array index of next free task slot.
-    UINT muNextFreeSet;
+    //  Slabs containing the SS task parents, a handle is the index of the
+    //  set in the slabs.  Slabs are never moved or freed while the TaskMgrSS
+    //  lives so stale handles the pools hold stay readable.
+    TaskSet* mpSlabs[ MAX_TASKSETHANDLES / TASKSET_SLAB_SIZE ];
+    std::atomic<UINT>   muSlabCount;
+    spin_mutex          mSlabLock;
+
+    //  Heads of the free lists.  The set list holds the handle of the head in
+    //  the low & a count of the pops in the high 32 bits, so any thread can pop
+    //  without a lock.  Chunks are popped under mChunkLock.
+    std::atomic<uint64_t>           muFreeSets;
+    std::atomic<SuccessorChunk*>    mpFreeChunks;
+    spin_mutex                      mChunkLock;
 
     //  Pointer to the task scheduler
     TaskScheduler mTaskScheduler;
@@ -207,6 +312,11 @@ private:
 
     PROCESSOR_INFO  mProcInfo;
 
+    //  ISA common denominator of the logical processors of each core type.
+    ISALevel        mAnyISA;
+    ISALevel        mCoreISA;
+    ISALevel        mAtomISA;
+
 };
 
 //
@@ -22,18 +22,22 @@
 
 */
 
+#ifdef _WIN32
 #include <Windows.h>
 
 #include "TaskMgr.h"
+#else
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "TaskMgrSS.h"
+#endif
 #include "TaskScheduler.h"
 
 #include <new>
 
-#pragma warning ( push )
-#pragma warning ( disable : 4995 ) // skip deprecated warning on intrinsics.
-#include <intrin.h>
-#pragma warning ( pop )
-
+#ifdef _MSC_VER
 const DWORD MS_VC_EXCEPTION = 0x406D1388;
 
 #pragma pack(push,8)
@@ -63,48 +67,72 @@ void SetThreadName(DWORD dwThreadID, char* threadName)
 	{
 	}
 }
+#endif
 
-
-  // helper function to get the number of processors on the system
-DWORD get_proc_count()
+void SetThreadName(std::thread& thread, char* threadName)
 {
-    SYSTEM_INFO info;
-    GetSystemInfo(&info);
-    return info.dwNumberOfProcessors;
+#if defined(_MSC_VER)
+	SetThreadName(GetThreadId(thread.native_handle()), threadName);
+#elif defined(__linux__)
+	// Linux thread names are limited to 15 characters
+	char name[16];
+	strncpy(name, threadName, sizeof(name) - 1);
+	name[sizeof(name) - 1] = 0;
+	pthread_setname_np(thread.native_handle(), name);
+#else
+	(void)thread;
+	(void)threadName;
+#endif
 }
 
-DWORD WINAPI TaskScheduler::ThreadMain(VOID* scheduler)
+VOID TaskScheduler::ThreadMain(TaskScheduler* pScheduler)
 {
-	TaskScheduler *pScheduler = reinterpret_cast<TaskScheduler*>(scheduler);
 	pScheduler->ExecuteTasks();
-
-	return 0;
 }
 
 // task_scheduler implementation
 
   // Initializes the scheduler and creates the worker threads
-VOID TaskScheduler::Init(PROCESSOR_INFO& procInfo, CoreTypes coreType, int thread_count)
+VOID TaskScheduler::Init(PROCESSOR_INFO& procInfo, CoreTypes coreType, int thread_count, UINT uContextBase)
+{
+    InitThreads(procInfo, coreType, NULL, thread_count, uContextBase);
+}
+
+  // Initializes a scheduler bound to one shared L2 module
+VOID TaskScheduler::InitModule(PROCESSOR_INFO& procInfo, UINT uModule, int thread_count, UINT uContextBase)
+{
+    if(uModule >= procInfo.modules.size()) return;
+
+    const MODULE_INFO& module = procInfo.modules[uModule];
+    InitThreads(procInfo, module.coreType, &module, thread_count, uContextBase);
+}
+
+VOID TaskScheduler::InitThreads(PROCESSOR_INFO& procInfo, CoreTypes coreType, const MODULE_INFO* pModule, int thread_count, UINT uContextBase)
 {   
 	char buffer[255];
 
       // If the scheduler is still running, ignore this
     if(mbAlive == TRUE) return;
 
-    muContextId = 0;
+    muContextBase = uContextBase;
+    muContextId = uContextBase;
     mbAlive = TRUE;
     miWriter = 0;
     miTaskCount = 0;
+    mOverflowTaskSets.clear();
+    muOverflowRead = 0;
+    miOverflowCount = 0;
 
       // Set the buffer of active tasks to empty by marking all of the slots as
-      // TASKSETHANDLE_INVALID
-    memset(mhActiveTaskSets,-1,sizeof(mhActiveTaskSets));
+      // TASKSLOT_EMPTY
+    for(INT uSlot = 0; uSlot < MAX_TASKSETS; ++uSlot)
+        mhActiveTaskSets[uSlot] = TASKSLOT_EMPTY;
 
       // Get the number of worker threads that will be available
     if(thread_count == MAX_THREADS)
     {
           // Leave one core for the main thread.
-        miThreadCount = procInfo.GetCoreTypeCount(coreType);
+        miThreadCount = pModule ? (INT)pModule->processorMask.Count() : procInfo.GetCoreTypeCount(coreType);
     }
     else
     {
@@ -114,17 +142,23 @@ VOID TaskScheduler::Init(PROCESSOR_INFO& procInfo, CoreTypes coreType, int threa
     if(miThreadCount == 0)
     {
         mpThreadData = 0;
+        mpDeques = 0;
+        mTaskAvailable.Init(0);
         return;
     }
 
-    mhTaskAvailable = CreateSemaphore(0,0,miThreadCount,0);
+    mTaskAvailable.Init(miThreadCount);
+    mpDeques = new TaskDeque[miThreadCount];
 
     // Create and initialize all of the threads
-    mpThreadData = new HANDLE[miThreadCount];
+    mpThreadData = new std::thread[miThreadCount];
     for(INT uThread = 0; uThread < miThreadCount; ++uThread)
     {
-		switch (coreType)
+		switch (pModule ? NONE : coreType)
 		{
+		case NONE:
+			sprintf(buffer, "Module %d Thread %d", (int)(pModule - procInfo.modules.data()), uThread);
+			break;
 		case INTEL_ATOM:
 			sprintf(buffer, "E-Core Thread %d", uThread);
 			break;
@@ -140,34 +174,54 @@ VOID TaskScheduler::Init(PROCESSOR_INFO& procInfo, CoreTypes coreType, int threa
 		}
 
 
-		mpThreadData[uThread] = CreateThread(0, 0, TaskScheduler::ThreadMain, this, 0, 0);
-		SetThreadName(GetThreadId(mpThreadData[uThread]), buffer);
+		mpThreadData[uThread] = std::thread(TaskScheduler::ThreadMain, this);
+		SetThreadName(mpThreadData[uThread], buffer);
 
 #ifdef ENABLE_CPU_SETS
-        RunOn(procInfo, mpThreadData[uThread], coreType, procInfo.cpuSets[CoreTypes::ANY]);
+        if (pModule)
+        {
+            RunOnCPUSet(procInfo, mpThreadData[uThread].native_handle(), pModule->cpuSets, procInfo.cpuSets[CoreTypes::ANY]);
+        }
+        else
+        {
+            RunOn(procInfo, mpThreadData[uThread].native_handle(), coreType, procInfo.cpuSets[CoreTypes::ANY]);
+        }
 #else
-        RunOn(procInfo, mpThreadData[uThread], coreType, procInfo.coreMasks[CoreTypes::ANY]);
+        if (pModule)
+        {
+            RunOnMask(procInfo, mpThreadData[uThread].native_handle(), pModule->processorMask, procInfo.coreMasks[CoreTypes::ANY]);
+        }
+        else
+        {
+            RunOn(procInfo, mpThreadData[uThread].native_handle(), coreType, procInfo.coreMasks[CoreTypes::ANY]);
+        }
 #endif
     }
 }
  
-  // Clean up the worker threads and associated data
-VOID TaskScheduler::Shutdown()
+  // Stops the worker threads, keeping the data the peers' workers read
+VOID TaskScheduler::Stop()
 {
+    if(mbAlive == FALSE) return;
+
       // Tell of of the threads to break out of their loops
     mbAlive = FALSE;
       //Wake up a sleeping threads and wait for them to exit
-    LONG sleep_count = 0;
-    ReleaseSemaphore(mhTaskAvailable,1,&sleep_count);
-    ReleaseSemaphore(mhTaskAvailable,miThreadCount - sleep_count,0);
-    WaitForMultipleObjects(miThreadCount,mpThreadData,TRUE,INFINITE);
-
-      // Clean up the handles
+    mTaskAvailable.Release(miThreadCount);
     for(INT uThread = 0; uThread < miThreadCount; ++uThread)
-        CloseHandle(mpThreadData[uThread]);
+        mpThreadData[uThread].join();
+}
+
+  // Clean up the worker threads and associated data
+VOID TaskScheduler::Shutdown()
+{
+    Stop();
 
+    miPeerCount = 0;
     delete [] mpThreadData;
 	mpThreadData = 0;
+    delete [] mpDeques;
+    mpDeques = 0;
 	miThreadCount = 0;
 }
 
@@ -175,46 +229,254 @@ VOID TaskScheduler::Shutdown()
 VOID TaskScheduler::ExecuteTasks()
 {
       // Get the ID for the thread
-    const UINT iContextId = _InterlockedIncrement((LONG*)&muContextId);
+    const UINT iContextId = ++muContextId;
+    const INT  iDeque = (INT)(iContextId - muContextBase - 1);
+    TaskDeque* pDeque = &mpDeques[iDeque];
       // Start reading from the beginning of the work queue
     INT  iReader = 0;
+      // Seed of the victim selection, different for every worker
+    UINT uSeed = iContextId * 0x9E3779B9u;
+      // Slots of the peers' work queues to read from
+    INT  iPeerReaders[MAX_PEERS] = {};
 
       // Thread keeps recieving and executing tasks until it is terminated
     while(mbAlive == TRUE)
+    {
+        TASKRANGE range;
+        TaskScheduler* pPeer;
+
+          // Run the ranges split off locally first, then claim a chunk of a
+          // taskset from the work queue, then steal from the other workers
+        if(pDeque->Pop(&range) || ClaimTasks(&iReader, &range) || StealTasks(iDeque, &uSeed, &range))
+        {
+            ExecuteRange(iContextId, pDeque, range);
+        }
+          // then help the other pools with the tasksets that allow it, the
+          // range is accounted to the pool owning the set and not split
+        else if(StealFromPeers(iPeerReaders, &uSeed, &pPeer, &range))
+        {
+            pPeer->ExecuteRange(iContextId, NULL, range);
+            ++muCrossPoolRanges;
+            muCrossPoolTasks += TaskRangeEnd(range) - TaskRangeBegin(range);
+        }
+          // or sleep if all of the work has been completed
+        else if(miTaskCount <= 0)
+        {
+            mTaskAvailable.Wait();
+        }
+    }
+}
+
+BOOL TaskScheduler::ClaimTasks( INT* piReader, TASKRANGE* pRange, const TaskScheduler* pThief, ISALevel isa )
+{
+    for(INT iSlot = 0; iSlot < MAX_TASKSETS && miTaskCount > 0; ++iSlot)
     {
           // Get a Handle from the work queue
-        TASKSETHANDLE handle = mhActiveTaskSets[iReader];
+        TASKSLOT slot = mhActiveTaskSets[*piReader];
+        const TASKSETHANDLE handle = TaskSlotSet(slot);
 
-          // If there is a TaskSet in the slot execute a task
-        if(handle != TASKSETHANDLE_INVALID)
+          // Workers of other pools skip the sets that don't let them in, the
+          // main thread those it might lack the ISA for
+        if(handle != TASKSETHANDLE_INVALID && (pThief == NULL || pThief == this || pThief->CanSteal(handle, TASKSET_STEAL_ANY)) &&
+           gTaskMgrSS.GetTaskSet(handle)->mRequiredISA <= isa)
         {
-            TaskMgrSS::TaskSet *pSet = &gTaskMgrSS.mSets[handle];
-            if(pSet->muCompletionCount > 0 && pSet->muTaskId >= 0)
-            {
-                pSet->Execute(iContextId);
-            }
-            else
+            TaskMgrSS::TaskSet *pSet = gTaskMgrSS.GetTaskSet(handle);
+
+              // Claim chunks rather than single tasks so the workers don't all
+              // hit the task counter of the set for every task
+            INT iChunk = (INT)pSet->muSize / (4 * (miThreadCount + 1));
+            INT iBegin;
+            INT iEnd;
+
+            if(pSet->muCompletionCount > 0 && pSet->ClaimRange(TaskSlotIncarnation(slot), iChunk > 1 ? iChunk : 1, &iBegin, &iEnd))
             {
-                _InterlockedCompareExchange((LONG*)&mhActiveTaskSets[iReader],TASKSETHANDLE_INVALID,handle);
-                iReader = (iReader + 1) & (MAX_TASKSETS - 1);
+                *pRange = MakeTaskRange(handle, iBegin, iEnd);
+
+                  // The last tasks are claimed, free the slot before the set can
+                  // complete & be recycled so the slot doesn't hold a stale handle
+                if(iBegin == 0)
+                {
+                    mhActiveTaskSets[*piReader].compare_exchange_strong(slot,TASKSLOT_EMPTY);
+                }
+                return TRUE;
             }
+
+              // Every task is claimed, the rest of the set runs from the deques.
+              // The exchange fails once the handle came back in another set.
+            mhActiveTaskSets[*piReader].compare_exchange_strong(slot,TASKSLOT_EMPTY);
         }
-          // Otherwise keep looking for work
-        else if(miTaskCount > 0)
+        *piReader = (*piReader + 1) & (MAX_TASKSETS - 1);
+    }
+
+      // Sets that didn't fit in the work queue come last, they are left to
+      // the pool's own workers
+    if(miOverflowCount > 0 && (pThief == NULL || pThief == this))
+    {
+        return ClaimOverflow(pRange, isa);
+    }
+    return FALSE;
+}
+
+BOOL TaskScheduler::ClaimOverflow( TASKRANGE* pRange, ISALevel isa )
+{
+    BOOL bClaimed = FALSE;
+
+    mOverflowLock.aquire();
+
+    for(UINT uRead = muOverflowRead; uRead < mOverflowTaskSets.size(); ++uRead)
+    {
+        const TASKSLOT slot = mOverflowTaskSets[uRead];
+        const TASKSETHANDLE handle = TaskSlotSet(slot);
+        TaskMgrSS::TaskSet *pSet = gTaskMgrSS.GetTaskSet(handle);
+
+          // Left to the workers, the queue only moves past claimed sets
+        if(pSet->mRequiredISA > isa) continue;
+
+        INT iChunk = (INT)pSet->muSize / (4 * (miThreadCount + 1));
+        INT iBegin;
+        INT iEnd;
+
+        if(pSet->muCompletionCount > 0 && pSet->ClaimRange(TaskSlotIncarnation(slot), iChunk > 1 ? iChunk : 1, &iBegin, &iEnd))
         {
-            iReader = (iReader + 1) & (MAX_TASKSETS - 1);
+            *pRange = MakeTaskRange(handle, iBegin, iEnd);
+            bClaimed = TRUE;
+            break;
         }
-          // or sleep if all of the work has been completed
 
-		// TODO: Steal any waiting work...
-        else
+          // Every task is claimed, move on to the next set
+        if(uRead == muOverflowRead)
         {
-            if(miTaskCount <= 0)
+            ++muOverflowRead;
+        }
+    }
+
+    if(muOverflowRead == mOverflowTaskSets.size())
+    {
+        mOverflowTaskSets.clear();
+        muOverflowRead = 0;
+    }
+    miOverflowCount = (INT)(mOverflowTaskSets.size() - muOverflowRead);
+
+    mOverflowLock.release();
+
+    return bClaimed;
+}
+
+BOOL TaskScheduler::StealTasks( INT iThief, UINT* puSeed, TASKRANGE* pRange, const TaskScheduler* pThief, ISALevel isa )
+{
+    if(miThreadCount == 0 || miTaskCount <= 0) return FALSE;
+
+      // xorshift, any victim is as good as another
+    UINT uSeed = *puSeed ? *puSeed : 1;
+    uSeed ^= uSeed << 13;
+    uSeed ^= uSeed >> 17;
+    uSeed ^= uSeed << 5;
+    *puSeed = uSeed;
+
+    const INT iFirst = (INT)(uSeed % (UINT)miThreadCount);
+    for(INT iVictim = 0; iVictim < miThreadCount; ++iVictim)
+    {
+        const INT iDeque = (iFirst + iVictim) % miThreadCount;
+        if(iDeque == iThief) continue;
+
+        if(pThief == NULL || pThief == this)
+        {
+            if(isa == ISA_AVX512 ? mpDeques[iDeque].Steal(pRange) :
+               mpDeques[iDeque].StealIf(pRange, [isa](TASKRANGE range) { return gTaskMgrSS.GetTaskSet(TaskRangeSet(range))->mRequiredISA <= isa; }))
             {
-                WaitForSingleObject(mhTaskAvailable,INFINITE);
+                return TRUE;
             }
         }
+        else if(mpDeques[iDeque].StealIf(pRange, [pThief](TASKRANGE range) { return pThief->CanSteal(TaskRangeSet(range), TASKSET_STEAL_PREFER); }))
+        {
+            return TRUE;
+        }
+    }
+    return FALSE;
+}
+
+BOOL TaskScheduler::StealFromPeers( INT* piPeerReaders, UINT* puSeed, TaskScheduler** ppPeer, TASKRANGE* pRange )
+{
+    const INT iPeerCount = miPeerCount;
+    for(INT iPeer = 0; iPeer < iPeerCount; ++iPeer)
+    {
+        TaskScheduler* pPeer = mpPeers[iPeer];
+        if(pPeer->miTaskCount <= 0) continue;
+
+          // The ranges the peer's workers split off first, they are the surplus
+          // of sets already running there, then tasks no one has claimed yet
+        if(pPeer->StealTasks(-1, puSeed, pRange, this) || pPeer->ClaimTasks(&piPeerReaders[iPeer], pRange, this))
+        {
+            *ppPeer = pPeer;
+            return TRUE;
+        }
     }
+    return FALSE;
+}
+
+BOOL TaskScheduler::CanSteal( TASKSETHANDLE hSet, TaskSetSteal steal ) const
+{
+    const TaskMgrSS::TaskSet& set = *gTaskMgrSS.GetTaskSet(hSet);
+    return set.mSteal >= steal && set.mRequiredISA <= mISA;
+}
+
+VOID TaskScheduler::WakePeers()
+{
+    const INT iPeerCount = miPeerCount;
+    for(INT iPeer = 0; iPeer < iPeerCount; ++iPeer)
+        mpPeers[iPeer]->mTaskAvailable.Release(1);
+}
+
+VOID TaskScheduler::AddPeer( TaskScheduler* pPeer, ISALevel isa )
+{
+    const INT iPeer = miPeerCount;
+    if(iPeer >= MAX_PEERS) return;
+
+    mISA = isa;
+    mpPeers[iPeer] = pPeer;
+      // Publishes the peer to the running workers
+    miPeerCount = iPeer + 1;
+}
+
+VOID TaskScheduler::GetCrossPoolSteals( UINT* puRanges, UINT* puTasks )
+{
+    *puRanges = muCrossPoolRanges.exchange(0);
+    *puTasks = muCrossPoolTasks.exchange(0);
+}
+
+VOID TaskScheduler::ExecuteRange( INT iContextId, TaskDeque* pDeque, TASKRANGE range )
+{
+    const TASKSETHANDLE handle = TaskRangeSet(range);
+    const INT iBegin = TaskRangeBegin(range);
+    INT iEnd = TaskRangeEnd(range);
+    TaskMgrSS::TaskSet *pSet = gTaskMgrSS.GetTaskSet(handle);
+
+      // Tasks are accounted to the pool the set was added to.  Work queue slots
+      // are cleared lazily, a worker reading the stale handle of a recycled set
+      // may claim tasks the set now has in another pool; run those unsplit.
+    TaskScheduler* pOwner = pSet->mpScheduler;
+    if(pOwner != this)
+    {
+        pDeque = NULL;
+    }
+
+      // Leave the upper halves to thieves, they get the largest ranges first
+    const INT iSplitEnd = iEnd;
+    while(pDeque && iEnd - iBegin > 1)
+    {
+        const INT iMiddle = iBegin + (iEnd - iBegin) / 2;
+        if(!pDeque->Push(MakeTaskRange(handle, iMiddle, iEnd))) break;
+        iEnd = iMiddle;
+    }
+
+      // The peers' idle workers may take the halves of sets that let them
+    if(iEnd != iSplitEnd && pSet->mSteal != TASKSET_STEAL_STRICT)
+    {
+        WakePeers();
+    }
+
+    pSet->ExecuteRange(iContextId, iBegin, iEnd);
+    pOwner->miTaskCount -= iEnd - iBegin;
 }
 
   // Adds a task set to the work queue
@@ -222,58 +484,77 @@ VOID TaskScheduler::AddTaskSet( TASKSETHANDLE hSet, INT iTaskCount )
 {
       // Increase the Task Count before adding the tasks to keep the
       // workers from going to sleep during this process
-    _InterlockedExchangeAdd((LONG*)&miTaskCount,iTaskCount);
+    miTaskCount += iTaskCount;
+
+    TaskMgrSS::TaskSet *pSet = gTaskMgrSS.GetTaskSet(hSet);
+    pSet->mpScheduler = this;
+      // The set may be done & recycled as soon as its tasks are published
+    const BOOL bWakePeers = pSet->mSteal == TASKSET_STEAL_ANY;
+
+      // Publish the tasks last, workers still holding the handle of the
+      // previous set in this slot must not start the set any earlier
+    const UINT uIncarnation = pSet->PublishTasks(iTaskCount);
+    const TASKSLOT slot = MakeTaskSlot(hSet, uIncarnation);
 
       // Looks for an open slot starting at the end of the queue
     INT iWriter = miWriter;
+    INT iProbes = 0;
+    TASKSLOT empty;
     do
     {
-        while(mhActiveTaskSets[iWriter] != TASKSETHANDLE_INVALID)
+        while(TaskSlotSet(mhActiveTaskSets[iWriter]) != TASKSETHANDLE_INVALID && iProbes < MAX_TASKSETS)
+        {
             iWriter = (iWriter + 1) & (MAX_TASKSETS - 1);
+            ++iProbes;
+        }
 
         // verify that another thread hasn't already written to this slot
-    } while(_InterlockedCompareExchange((LONG*)&mhActiveTaskSets[iWriter],hSet,TASKSETHANDLE_INVALID) != TASKSETHANDLE_INVALID);
+        empty = TASKSLOT_EMPTY;
+    } while(iProbes < MAX_TASKSETS && !mhActiveTaskSets[iWriter].compare_exchange_strong(empty,slot));
+
+      // Every slot is taken, the set waits in the overflow queue
+    if(iProbes == MAX_TASKSETS)
+    {
+        mOverflowLock.aquire();
+        mOverflowTaskSets.push_back(slot);
+        miOverflowCount = (INT)(mOverflowTaskSets.size() - muOverflowRead);
+        mOverflowLock.release();
+    }
 
       // Wake up all suspended threads
-    LONG sleep_count = 0;
-    ReleaseSemaphore(mhTaskAvailable,1,&sleep_count);
+    INT sleep_count = mTaskAvailable.Release(1);
     INT iCountToWake = iTaskCount < (miThreadCount - sleep_count - 1) ? iTaskCount : miThreadCount - sleep_count - 1;
-    ReleaseSemaphore(mhTaskAvailable,iCountToWake,&sleep_count);
+    mTaskAvailable.Release(iCountToWake);
+
+      // Peers may claim tasks of the set right away
+    if(bWakePeers)
+    {
+        WakePeers();
+    }
 
       // reset the end of the queue
     miWriter = iWriter;
 }
 
   // Yields the main thread to the scheduler when it needs to wait for a Task Set to be completed
-VOID TaskScheduler::WaitForFlag( volatile BOOL *pFlag )
+VOID TaskScheduler::WaitForFlag( const std::atomic<BOOL> *pFlag, ISALevel isa )
 {
       // Start at the the end of the work queue
     int iReader = miWriter;
+    UINT uSeed = 0x9E3779B9u;
 
       // The condition for exiting this loop is changed externally to the function,
-      // possibly in another thread.  The loop will break with no more than one task
+      // possibly in another thread.  The loop will break with no more than one chunk
       // being executed, returning the main thread as soon as possible.
     while(*pFlag == FALSE)
     {
-		TASKSETHANDLE handle = mhActiveTaskSets[iReader];
+        TASKRANGE range;
 
-        if(handle != TASKSETHANDLE_INVALID)
-        {
-            TaskMgrSS::TaskSet *pSet = &gTaskMgrSS.mSets[handle];
-            if(pSet->muCompletionCount > 0 && pSet->muTaskId >= 0)
-            {
-                  // The context ID for the main thread is 0.
-                pSet->Execute(0);
-            }
-            else
-            {
-                _InterlockedCompareExchange((LONG*)&mhActiveTaskSets[iReader],TASKSETHANDLE_INVALID,handle);
-                iReader = (iReader + 1) & (MAX_TASKSETS - 1);
-            }
-        }
-        else if(miTaskCount > 0)
+          // The main thread isn't pinned, it may be on any logical processor
+        if(ClaimTasks(&iReader, &range, NULL, isa) || StealTasks(-1, &uSeed, &range, NULL, isa))
         {
-            iReader = (iReader + 1) & (MAX_TASKSETS - 1);
+              // The context ID for the main thread is 0.
+            ExecuteRange(0, NULL, range);
         }
         else
         {
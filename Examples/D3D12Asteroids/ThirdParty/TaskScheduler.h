@@ -24,20 +24,227 @@
 */
 #pragma once
 
+#include <atomic>
+#include <stdint.h>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
 #include "spin_mutex.h"
-#include "..\..\..\HybridDetect.h"
+#include "TaskMgrCommon.h"
+#include "../../../HybridDetect.h"
 using namespace HybridDetect;
 
   // Use to give variable their own cache line to prevent false sharing 
-#define CACHE_ALIGN __declspec(align(64))
+#define CACHE_ALIGN alignas(64)
 
   // Forward Declarations
 class Thread;
 
+#ifdef _MSC_VER
 #pragma warning ( push )
 #pragma warning ( disable : 4324 ) // skip warning on structure padding.
+#endif
+
+  // Counting semaphore the idle worker threads sleep on.  Posts never raise
+  // the count above the maximum (the number of workers), like a Windows
+  // semaphore.  Sleeping uses a futex on Linux and a condition variable on
+  // other platforms; neither is entered while the count is positive.
+class TaskSemaphore
+{
+public:
+    TaskSemaphore() : miCount(0), miMaxCount(0), miWaiters(0) {}
+
+    VOID Init( INT iMaxCount )
+    {
+        miCount = 0;
+        miMaxCount = iMaxCount;
+    }
+
+      // Adds up to iCount posts and wakes as many sleeping threads,
+      // returns the count before the release.
+    INT Release( INT iCount )
+    {
+        INT iPrevCount = miCount.load();
+        INT iNewCount;
+        do
+        {
+            if(iCount <= 0 || iPrevCount >= miMaxCount) return iPrevCount;
+            iNewCount = iPrevCount + iCount < miMaxCount ? iPrevCount + iCount : miMaxCount;
+        } while(!miCount.compare_exchange_weak(iPrevCount, iNewCount));
+
+        if(miWaiters.load() > 0) Wake(iNewCount - iPrevCount);
+        return iPrevCount;
+    }
+
+      // Takes a post, sleeping until one is available
+    VOID Wait()
+    {
+        for(;;)
+        {
+            INT iCount = miCount.load();
+            while(iCount > 0)
+            {
+                if(miCount.compare_exchange_weak(iCount, iCount - 1)) return;
+            }
+
+            ++miWaiters;
+            Block();
+            --miWaiters;
+        }
+    }
+
+private:
+#ifdef __linux__
+    VOID Wake( INT iCount )
+    {
+        syscall(SYS_futex, reinterpret_cast<int*>(&miCount), FUTEX_WAKE_PRIVATE, iCount, nullptr, nullptr, 0);
+    }
+
+      // Returns right away if the count is no longer 0
+    VOID Block()
+    {
+        syscall(SYS_futex, reinterpret_cast<int*>(&miCount), FUTEX_WAIT_PRIVATE, 0, nullptr, nullptr, 0);
+    }
+#else
+    VOID Wake( INT iCount )
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if(iCount == 1) mCondition.notify_one();
+        else mCondition.notify_all();
+    }
+
+    VOID Block()
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mCondition.wait(lock, [this] { return miCount.load() > 0; });
+    }
+
+    std::mutex              mMutex;
+    std::condition_variable mCondition;
+#endif
+
+    std::atomic<INT>        miCount;
+    INT                     miMaxCount;
+    std::atomic<INT>        miWaiters;
+};
+
+  // A range of tasks of a taskset packed in 64 bits for the deques:
+  // handle (24 bits) | first task (20 bits) | end task (20 bits)
+typedef uint64_t TASKRANGE;
+
+static_assert(MAX_TASKSETSIZE <= 0xFFFFF, "The end of a TASKRANGE has 20 bits");
+
+inline TASKRANGE MakeTaskRange( TASKSETHANDLE hSet, INT iBegin, INT iEnd )
+{
+    return ((TASKRANGE)(hSet & 0xFFFFFF) << 40) | ((TASKRANGE)iBegin << 20) | (TASKRANGE)iEnd;
+}
+
+inline TASKSETHANDLE TaskRangeSet( TASKRANGE range ) { return (TASKSETHANDLE)(range >> 40); }
+inline INT TaskRangeBegin( TASKRANGE range ) { return (INT)((range >> 20) & 0xFFFFF); }
+inline INT TaskRangeEnd( TASKRANGE range ) { return (INT)(range & 0xFFFFF); }
+
+  // A taskset in the work queue: incarnation (32 bits) | handle (32 bits).
+  // Handles are recycled, a thread that read a slot before its set completed
+  // can't claim tasks of the next set with the handle, nor clear its slot
+  // (see TaskMgrSS::TaskSet::ClaimRange).
+typedef uint64_t TASKSLOT;
+
+#define TASKSLOT_EMPTY  ((TASKSLOT)TASKSETHANDLE_INVALID)
+
+inline TASKSLOT MakeTaskSlot( TASKSETHANDLE hSet, UINT uIncarnation ) { return ((TASKSLOT)uIncarnation << 32) | hSet; }
+inline TASKSETHANDLE TaskSlotSet( TASKSLOT slot ) { return (TASKSETHANDLE)slot; }
+inline UINT TaskSlotIncarnation( TASKSLOT slot ) { return (UINT)(slot >> 32); }
+
+  // Chase-Lev work-stealing deque of task ranges with a fixed capacity
+  // (Le et al., "Correct and Efficient Work-Stealing for Weak Memory Models").
+  // The owning worker pushes & pops at the bottom, other threads steal from
+  // the top.  Push fails when the deque is full, the caller then runs the
+  // range itself.
+class TaskDeque
+{
+public:
+    static const INT CAPACITY = 256;
 
-  // The custom Windows threads backend scheduler.  The TaskScheduler
+    TaskDeque() : miTop(0), miBottom(0) {}
+
+      // Owner only
+    BOOL Push( TASKRANGE range )
+    {
+        const int64_t iBottom = miBottom.load(std::memory_order_relaxed);
+        const int64_t iTop = miTop.load(std::memory_order_acquire);
+        if(iBottom - iTop >= CAPACITY) return FALSE;
+
+        mRanges[iBottom & (CAPACITY - 1)].store(range, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        miBottom.store(iBottom + 1, std::memory_order_relaxed);
+        return TRUE;
+    }
+
+      // Owner only, takes the most recently pushed range
+    BOOL Pop( TASKRANGE* pRange )
+    {
+        const int64_t iBottom = miBottom.load(std::memory_order_relaxed) - 1;
+        miBottom.store(iBottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t iTop = miTop.load(std::memory_order_relaxed);
+
+        if(iTop > iBottom)
+        {
+            miBottom.store(iBottom + 1, std::memory_order_relaxed);
+            return FALSE;
+        }
+
+        *pRange = mRanges[iBottom & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if(iTop == iBottom)
+        {
+              // Last range, race the thieves for it
+            const BOOL bWon = miTop.compare_exchange_strong(iTop, iTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            miBottom.store(iBottom + 1, std::memory_order_relaxed);
+            return bWon;
+        }
+        return TRUE;
+    }
+
+      // Any thread, takes the oldest (largest) range
+    BOOL Steal( TASKRANGE* pRange )
+    {
+        return StealIf(pRange, [](TASKRANGE) { return TRUE; });
+    }
+
+      // Any thread, takes the oldest range when bAllowed(range) is TRUE and
+      // leaves it to the owner & the other thieves otherwise
+    template<class Allowed>
+    BOOL StealIf( TASKRANGE* pRange, Allowed bAllowed )
+    {
+        int64_t iTop = miTop.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t iBottom = miBottom.load(std::memory_order_acquire);
+        if(iTop >= iBottom) return FALSE;
+
+        *pRange = mRanges[iTop & (CAPACITY - 1)].load(std::memory_order_relaxed);
+        if(!bAllowed(*pRange)) return FALSE;
+        return miTop.compare_exchange_strong(iTop, iTop + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+private:
+      // Padded rather than aligned so arrays of deques can be allocated with new
+      // before C++17, keeping the owner's & the thieves' indices on separate lines.
+    std::atomic<int64_t>    miTop;
+    char                    mPadTop[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<int64_t>    miBottom;
+    char                    mPadBottom[64 - sizeof(std::atomic<int64_t>)];
+    std::atomic<TASKRANGE>  mRanges[CAPACITY];
+};
+
+  // The portable backend scheduler (std::thread & atomics).  The TaskScheduler
   // class manages the Task Sets that the program gives to the TaskMgr
   // API and manages the lifetime of the worker threads.
 class TaskScheduler
@@ -46,46 +253,127 @@ public:
       // Constant to pass to the Init method
     static const int MAX_THREADS = -1;
 
-      // Sets up the threads and events for the scheduler
-	VOID Init(PROCESSOR_INFO& procInfo, CoreTypes coreType, int thread_count = MAX_THREADS);
+      // Sets up the threads and events for the scheduler.  Its workers get
+      // the context IDs uContextBase + 1 to uContextBase + thread count, pools
+      // sharing tasksets (see AddPeer) need bases that keep them apart.
+	VOID Init(PROCESSOR_INFO& procInfo, CoreTypes coreType, int thread_count = MAX_THREADS, UINT uContextBase = 0);
+
+      // Sets up a pool whose threads stay on the logical processors of
+      // procInfo.modules[uModule], sharing its L2. MAX_THREADS creates one
+      // thread per logical processor of the module.
+	VOID InitModule(PROCESSOR_INFO& procInfo, UINT uModule, int thread_count = MAX_THREADS, UINT uContextBase = 0);
 
       // Shuts down the scheduler and closes the threads
 	VOID Shutdown();
 
+      // Stops & joins the worker threads.  The work queue & the deques stay
+      // valid, for the workers of the peer pools, until Shutdown.
+    VOID Stop();
+
+      // Lets the idle workers of this pool, whose logical processors support
+      // isa, run the tasksets of pPeer that permit it (see TaskSetSteal).
+      // Peers are added both ways, a pool wakes its peers for such sets.
+    VOID AddPeer( TaskScheduler* pPeer, ISALevel isa );
+
+      // Ranges & tasks of the peers' tasksets this pool's workers ran since
+      // the previous call
+    VOID GetCrossPoolSteals( UINT* puRanges, UINT* puTasks );
+
     VOID AddTaskSet( TASKSETHANDLE hSet, INT iTaskCount );
-    VOID DecrementTaskCount() { _InterlockedDecrement((LONG*)&miTaskCount); }
+    VOID DecrementTaskCount() { --miTaskCount; }
      
       // Yields the main thread to the scheduler 
-      // when it needs to wait for a Task Set to be completed
-	VOID WaitForFlag( volatile BOOL *pFlag );
+      // when it needs to wait for a Task Set to be completed.  isa is the ISA
+      // common to the logical processors the main thread may run on, it only
+      // helps with the tasksets not requiring more.
+	VOID WaitForFlag( const std::atomic<BOOL> *pFlag, ISALevel isa );
+
+      // Number of worker threads of the pool
+    INT GetThreadCount() const { return miThreadCount; }
 
 private:
-	static DWORD WINAPI ThreadMain(VOID* scheduler);
+	static VOID ThreadMain(TaskScheduler* pScheduler);
+
+      // Creates the threads of a core type pool, or of a module pool when
+      // pModule is not NULL
+    VOID InitThreads(PROCESSOR_INFO& procInfo, CoreTypes coreType, const MODULE_INFO* pModule, int thread_count, UINT uContextBase);
 
 
       // Called by ThreadMain to execute tasks until the scheduler 
       // is shutdown
     VOID ExecuteTasks();
 
+      // Claims a chunk of tasks of the first taskset in the work queue with
+      // unclaimed tasks, starting at slot *piReader.  Only the sets pThief
+      // may run are considered when pThief is another pool, and the sets
+      // requiring no more than isa.
+    BOOL ClaimTasks( INT* piReader, TASKRANGE* pRange, const TaskScheduler* pThief = NULL, ISALevel isa = ISA_AVX512 );
+
+      // Steals a range from the deque of a random worker other than iThief,
+      // of the sets pThief may run when pThief is another pool, and of the
+      // sets requiring no more than isa
+    BOOL StealTasks( INT iThief, UINT* puSeed, TASKRANGE* pRange, const TaskScheduler* pThief = NULL, ISALevel isa = ISA_AVX512 );
+
+      // Claims a chunk of tasks of the first taskset in the overflow queue
+      // with unclaimed tasks requiring no more than isa
+    BOOL ClaimOverflow( TASKRANGE* pRange, ISALevel isa );
+
+      // Takes a range of a peer's taskset that lets this pool run it
+    BOOL StealFromPeers( INT* piPeerReaders, UINT* puSeed, TaskScheduler** ppPeer, TASKRANGE* pRange );
+
+      // If the workers of this pool may run hSet of a peer under steal
+    BOOL CanSteal( TASKSETHANDLE hSet, TaskSetSteal steal ) const;
+
+      // Posts the semaphores of the peers so one of their idle workers looks
+      // for tasks here
+    VOID WakePeers();
+
+      // Executes a range, splitting off halves to pDeque (when not NULL) for
+      // other workers to steal until a single task is left
+    VOID ExecuteRange( INT iContextId, TaskDeque* pDeque, TASKRANGE range );
+
       // Number of worker threads that have been created
     INT             miThreadCount;
       // Per thread data
-    HANDLE*         mpThreadData;
-      // Handle to a Windows Event
-	HANDLE          mhTaskAvailable;
+    std::thread*    mpThreadData;
+      // Per thread deques of claimed tasks, indexed by context ID - muContextBase - 1
+    TaskDeque*      mpDeques;
+      // Context ID of the worker before the first one of this pool
+    UINT            muContextBase;
+      // Posted when tasks are added, idle workers sleep on it
+    TaskSemaphore   mTaskAvailable;
       // If the scheduler is alive, don't re-init
-    BOOL            mbAlive;
+    std::atomic<BOOL> mbAlive;
+
+    static const INT MAX_PEERS = 2;
+      // Pools whose tasksets the idle workers may run, see AddPeer
+    TaskScheduler*      mpPeers[MAX_PEERS];
+    std::atomic<INT>    miPeerCount;
+      // ISA common to the logical processors of the pool
+    ISALevel            mISA;
 
       // These variables are padded to be placed in individual cache lines, preventing
       // false sharing during interlocked operations.
-    CACHE_ALIGN volatile INT    miTaskCount;
-    CACHE_ALIGN volatile LONG   miWriter;
+    CACHE_ALIGN std::atomic<INT>    miTaskCount;
+    CACHE_ALIGN std::atomic<INT>    miWriter;
       // Caches allinged to add space after miWriter to prevent the sharing of both muContexID
       // and mhActiveTaskSets.
-    CACHE_ALIGN UINT            muContextId;
+    CACHE_ALIGN std::atomic<UINT>   muContextId;
 
       // Array that containing all tasks
-    TASKSETHANDLE   mhActiveTaskSets[MAX_TASKSETS];
+    std::atomic<TASKSLOT>       mhActiveTaskSets[MAX_TASKSETS];
+
+      // Tasksets added while every slot of the work queue was taken, in the
+      // order they were added from muOverflowRead on
+    CACHE_ALIGN spin_mutex          mOverflowLock;
+    std::vector<TASKSLOT>           mOverflowTaskSets;
+    UINT                            muOverflowRead;
+    std::atomic<INT>                miOverflowCount;
+      // Cross-pool steals by the workers, see GetCrossPoolSteals
+    CACHE_ALIGN std::atomic<UINT>   muCrossPoolRanges;
+    std::atomic<UINT>               muCrossPoolTasks;
 };
 
+#ifdef _MSC_VER
 #pragma warning ( pop )
+#endif
@@ -14,34 +14,50 @@
 // under the License.
 ////////////////////////////////////////////////////////////////////////////////
 #pragma once
+#ifdef _WIN32
 #include "windows.h"
 #pragma warning ( push )
 #pragma warning ( disable : 4995 ) // skip deprecated warning on intrinsics.
 #include <intrin.h>
 #pragma warning ( pop )
+#endif
+#include <atomic>
+#include <thread>
 
 #include "Profile.h"
 
 class spin_mutex
 {
 public:
-    volatile long flag;
+    std::atomic<long> flag;
+
+      // Failed reads of the flag before aquire yields
+    static const int SPIN_LIMIT = 64;
 
     spin_mutex() : flag(0) {}
 
     void aquire()
     {
-        while(!try_aquire()) { }
+          // Spin on reads, then yield: with more threads than logical
+          // processors the spinners may keep the holder from running.
+        int iSpins = 0;
+        while(!try_aquire())
+        {
+            while(flag.load(std::memory_order_relaxed) != 0)
+            {
+                if(++iSpins > SPIN_LIMIT) std::this_thread::yield();
+            }
+        }
     }
 
     bool try_aquire()
     {
-        return _InterlockedCompareExchange(&flag,1,0) == 0;
+        long expected = 0;
+        return flag.compare_exchange_strong(expected,1,std::memory_order_acquire);
     }
 
     void release()
     {
-        _InterlockedExchange(&flag,0);
+        flag.store(0,std::memory_order_release);
     }
 };
-
@@ -55,6 +55,8 @@ GUIText* gIsHybridControl;
 GUIText* gCoreCountControl;
 GUIText* gHybridCoresControl;
 GUIText* gHybridTasksControl;
+GUIText* gStealControl;
+GUIText* gStealTimeControl;
 
 PROCESSOR_INFO* gProcessorInfo;
 
@@ -197,6 +199,10 @@ LRESULT CALLBACK WindowProc(
                 gSettings.submitRendering = !gSettings.submitRendering;
                 std::cout << "Submit Rendering: " << gSettings.submitRendering << std::endl;
                 return 0;
+            case 'T':
+                gSettings.stealPolicy = (gSettings.stealPolicy + 1) % 3;
+                std::cout << "Cross-Pool Stealing: " << gSettings.stealPolicy << std::endl;
+                return 0;
             /*case '1': gSettings.d3d12 = (gWorkloadD3D11 == nullptr); return 0;
             case '2': gSettings.d3d12 = (gWorkloadD3D12 != nullptr); return 0;*/
 
@@ -270,6 +276,12 @@ int main(int argc, char** argv)
 
     GetProcessorInfo(procInfo);
 
+    // Relative P-Core/E-Core speed, used by the Asymetric scheduler to split the asteroid updates
+    if (procInfo.hybrid)
+    {
+        CalibrateCoreTypes(procInfo);
+    }
+
     gProcessorInfo = &procInfo;
 
 #ifdef ENABLE_CPU_SETS
@@ -334,6 +346,13 @@ int main(int argc, char** argv)
 					 : "Single");
             }
         }
+        else if (_stricmp(argv[a], "-steal") == 0 && a + 1 < argc) {
+            int stealPolicy = atoi(argv[++a]);
+            gSettings.stealPolicy = (stealPolicy < 0 || stealPolicy > 2) ? 0 : (unsigned int)stealPolicy;
+            printf("%s cross-pool stealing\n",
+                gSettings.stealPolicy == 1 ? "Prefer" :
+                gSettings.stealPolicy == 2 ? "Any" : "Strict");
+        }
         else if (_stricmp(argv[a], "-locked_fps") == 0 && a + 1 < argc) {
             gSettings.lockFrameRate = true;
             gSettings.lockedFrameRate = atoi(argv[++a]);
@@ -352,14 +371,22 @@ int main(int argc, char** argv)
             fprintf(stderr, "  -locked_fps [fps]\n");
             fprintf(stderr, "  -perf_output [path]\n");
             fprintf(stderr, "  -scheduler [0|1|2|3] (0 = Single, 1 = Explicit, 2 = Implicit, 3 = Mixed)\n");
+            fprintf(stderr, "  -steal [0|1|2] (0 = Strict, 1 = Prefer, 2 = Any)\n");
             fprintf(stderr, "  -warp\n");
             return -1;
         }
     }
 
+	// Rebuild the thread pools when logical processors go offline/online or get parked/unparked
+	std::atomic<bool> topologyChanged{ false };
+	TopologyWatcher topologyWatcher;
+
 	if (gSettings.scheduler != SingleThreaded)
 	{
 		gTaskMgrSS.Init(procInfo);
+
+		topologyWatcher.AddCallback([&topologyChanged](const TopologyWatcher::Snapshot&) { topologyChanged = true; });
+		topologyWatcher.Start(procInfo);
 	}
 
     if (!d3d12Available) {
@@ -379,6 +406,8 @@ int main(int argc, char** argv)
     gCoreCountControl = gGUI.AddText(5, 150);
     gHybridCoresControl = gGUI.AddText(5, 195);
 	gHybridTasksControl = gGUI.AddText(5, 240);
+	gStealControl = gGUI.AddText(5, 285);
+	gStealTimeControl = gGUI.AddText(5, 330);
 
     ResetCameraView();
     // Camera projection set up in WM_SIZE
@@ -408,13 +437,19 @@ int main(int argc, char** argv)
             }
         }
 
+        // One render/update subset per logical processor the task pools (and the main thread) can use
         if (procInfo.hybrid)
         {
-            gWorkloadD3D12 = new AsteroidsD3D12::Asteroids(&asteroids, &gGUI, procInfo.GetCoreTypeCount(INTEL_CORE), procInfo.GetCoreTypeCount(INTEL_ATOM), adapter, procInfo, gSettings);
+            THREAD_RECOMMENDATION render, update;
+            RecommendThreads(procInfo, WORKLOAD_THROUGHPUT, INTEL_CORE, render);
+            RecommendThreads(procInfo, WORKLOAD_THROUGHPUT, INTEL_ATOM, update, 0, render.threadCount);
+            gWorkloadD3D12 = new AsteroidsD3D12::Asteroids(&asteroids, &gGUI, std::max(1u, render.threadCount), std::max(1u, update.threadCount), adapter, procInfo, gSettings);
         }
         else
         {
-            gWorkloadD3D12 = new AsteroidsD3D12::Asteroids(&asteroids, &gGUI, procInfo.numLogicalCores, procInfo.numLogicalCores, adapter, procInfo, gSettings);
+            THREAD_RECOMMENDATION any;
+            RecommendThreads(procInfo, WORKLOAD_THROUGHPUT, ANY, any);
+            gWorkloadD3D12 = new AsteroidsD3D12::Asteroids(&asteroids, &gGUI, std::max(1u, any.threadCount), std::max(1u, any.threadCount), adapter, procInfo, gSettings);
         }
     }
     gSettings.d3d12 = (gWorkloadD3D12 != nullptr);
@@ -467,13 +502,16 @@ int main(int argc, char** argv)
         if (perfOutputFp == nullptr) {
             fprintf(stderr, "warning: failed to open performance output file '%s'\n", perfOutputPath);
         } else {
-            fprintf(perfOutputFp, "Frame time (ms),\n");
+            fprintf(perfOutputFp, "Frame time (ms),Steal policy,P-Core cross-pool tasks,E-Core cross-pool tasks,\n");
         }
     }
 
     // main loop
     double elapsedTime = 0.0;
     double frameTime = 0.0;
+    double stealFrameTime[3] = {};  // Last frame time under each steal policy
+    UINT coreStealRanges = 0, coreStealTasks = 0;
+    UINT atomStealRanges = 0, atomStealTasks = 0;
     int lastMouseX = 0;
     int lastMouseY = 0;
 
@@ -504,6 +542,14 @@ int main(int argc, char** argv)
             DispatchMessage(&msg);
         }
 
+        // Apply the latest topology generation between frames
+        if (topologyChanged.exchange(false))
+        {
+            procInfo = *topologyWatcher.Current();
+            ResetRunOnCache();
+            gTaskMgrSS.UpdateTopology(procInfo);
+        }
+
         // Get time delta
         UINT64 count;
         QueryPerformanceCounter((LARGE_INTEGER*)&count);
@@ -574,11 +620,27 @@ int main(int argc, char** argv)
 				sprintf(buffer, "Render Tasks / Update Tasks: %d/%d", gWorkloadD3D12->RenderTaskCount(), gWorkloadD3D12->RenderTaskCount());
 			gHybridTasksControl->Text(buffer);
 
+			// Tasks each pool ran for the other during the previous frame
+			gTaskMgrSS.GetCrossPoolSteals(INTEL_CORE, &coreStealRanges, &coreStealTasks);
+			gTaskMgrSS.GetCrossPoolSteals(INTEL_ATOM, &atomStealRanges, &atomStealTasks);
+			stealFrameTime[gSettings.stealPolicy] = frameTime;
+
+			sprintf(buffer, "Cross-Pool Tasks P-Core/E-Core: %u/%u [%s]", coreStealTasks, atomStealTasks,
+				gSettings.stealPolicy == 1 ? "Prefer" :
+				gSettings.stealPolicy == 2 ? "Any" : "Strict");
+			gStealControl->Text(buffer);
+
+			sprintf(buffer, "Strict/Prefer/Any: %4.1f/%4.1f/%4.1f ms",
+				1000.f * stealFrameTime[0], 1000.f * stealFrameTime[1], 1000.f * stealFrameTime[2]);
+			gStealTimeControl->Text(buffer);
+
             gSKUControl->Visible(true);
             gIsHybridControl->Visible(true);
             gCoreCountControl->Visible(true);
             gHybridCoresControl->Visible(true);
 			gHybridTasksControl->Visible(true);
+			gStealControl->Visible(gProcessorInfo->hybrid);
+			gStealTimeControl->Visible(gProcessorInfo->hybrid);
 
             gD3D12Control->Visible(true);
             gD3D11Control->Visible(false);
@@ -587,7 +649,7 @@ int main(int argc, char** argv)
         gWorkloadD3D12->Render((float)frameTime, gCamera, gSettings);
 
         if (perfOutputFp != nullptr) {
-            fprintf(perfOutputFp, "%lf,\n", 1000.0 * frameTime);
+            fprintf(perfOutputFp, "%lf,%u,%u,%u,\n", 1000.0 * frameTime, gSettings.stealPolicy, coreStealTasks, atomStealTasks);
         }
 
         if (gSettings.lockFrameRate) {
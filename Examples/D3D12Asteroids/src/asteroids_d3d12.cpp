@@ -555,7 +555,15 @@ void Asteroids::CreateSubsets(UINT numRenderTasks, UINT numUpdateTasks, const Se
     ReleaseSubsets();
 
     mDrawsPerSubset = (NUM_ASTEROIDS + numRenderTasks - 1) / numRenderTasks;
-	mUpdatesPerSubset = (NUM_ASTEROIDS + numUpdateTasks - 1) / numUpdateTasks;
+
+	// Update subsets only touch the simulation data, size them so each stays resident in the L2 of the
+	// E-Cores simulating it (at least numUpdateTasks subsets). Render subsets own command lists & are kept
+	// at one per render task.
+	CACHE_PARTITIONING updatePartitioning;
+	PartitionForCache(mProcInfo, NUM_ASTEROIDS, sizeof(AsteroidStatic) + sizeof(AsteroidDynamic), 2, updatePartitioning,
+		numUpdateTasks, mProcInfo.hybrid ? CoreTypes::INTEL_ATOM : CoreTypes::ANY);
+	numUpdateTasks = (UINT)updatePartitioning.chunkCount;
+	mUpdatesPerSubset = (UINT)updatePartitioning.elementsPerChunk;
 
 	mRenderTaskCount = numRenderTasks;
 	mUpdateTaskCount = numUpdateTasks;
@@ -627,6 +635,27 @@ void Asteroids::CreateSubsets(UINT numRenderTasks, UINT numUpdateTasks, const Se
 
 		mAsteroidRenderTaskSets = new TASKSETHANDLE[mRenderTaskCount];
 		mAsteroidUpdateTaskSets = new TASKSETHANDLE[mUpdateTaskCount];
+
+		// The P-Cores would idle while the E-Cores update, so once calibrated they take a share of the update
+		// subsets proportional to their measured FP32 SIMD throughput & both pools finish together.
+		mAsteroidUpdateCoreTaskSet = TASKSETHANDLE_INVALID;
+		const double coreScore = mProcInfo.GetCoreTypeScore(INTEL_CORE, CALIBRATION_SIMD_FP32);
+		const double atomScore = mProcInfo.GetCoreTypeScore(INTEL_ATOM, CALIBRATION_SIMD_FP32);
+
+		if (mProcInfo.hybrid && coreScore > 0.0 && atomScore > 0.0 && mUpdateTaskCount > 1)
+		{
+			THREAD_RECOMMENDATION core, atom;
+			RecommendThreads(mProcInfo, WORKLOAD_THROUGHPUT, INTEL_CORE, core);
+			RecommendThreads(mProcInfo, WORKLOAD_THROUGHPUT, INTEL_ATOM, atom, 0, core.threadCount);
+
+			const double coreRate = coreScore * core.threadCount;
+			const double atomRate = atomScore * atom.threadCount;
+			if (coreRate + atomRate > 0.0)
+			{
+				const UINT coreSubsets = (UINT)(mUpdateTaskCount * coreRate / (coreRate + atomRate) + 0.5);
+				mUpdateCoreSubsetCount = std::min(coreSubsets, mUpdateTaskCount - 1);
+			}
+		}
 	}
 	else
 	{
@@ -666,6 +695,7 @@ void Asteroids::ReleaseSubsets()
 	mRenderTaskCount = 0;
     mDrawsPerSubset = 0;
 	mUpdatesPerSubset = 0;
+	mUpdateCoreSubsetCount = 0;
 
     if (mRenderTaskData)      delete mRenderTaskData;
     if (mSimulateTaskData)    delete mSimulateTaskData;
@@ -954,7 +984,7 @@ void Asteroids::Update(float frameTime, const OrbitCamera& camera, const Setting
 			}
 
 			gTaskMgrSS.CreateTaskSet(&Asteroids::SimulateSubsetTask, mSimulateTaskData, mRenderTaskCount, NULL, 0, 
-				"Asteroids::SimulateSubsetTask", &mAsteroidUpdateTaskSet, CoreTypes::INTEL_ATOM);
+				"Asteroids::SimulateSubsetTask", &mAsteroidUpdateTaskSet, CoreTypes::INTEL_ATOM, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
 		}
 		else if (settings.scheduler == OneToOne)
 		{
@@ -982,10 +1012,10 @@ void Asteroids::Update(float frameTime, const OrbitCamera& camera, const Setting
 				mRenderTaskData[subsetIdx].subset = frame->mSubsets[subsetIdx];
 
 				gTaskMgrSS.CreateTaskSet(&Asteroids::SimulateTask, &mSimulateTaskData[subsetIdx], 1, NULL, 0, 
-					"Asteroids::SimulateTask", &mAsteroidUpdateTaskSets[subsetIdx], CoreTypes::INTEL_ATOM);
+					"Asteroids::SimulateTask", &mAsteroidUpdateTaskSets[subsetIdx], CoreTypes::INTEL_ATOM, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
 
 				gTaskMgrSS.CreateTaskSet(&Asteroids::RenderTask, &mRenderTaskData[subsetIdx], 1, &mAsteroidUpdateTaskSets[subsetIdx], 1, 
-					"Asteroids::RenderTask", &mAsteroidRenderTaskSets[subsetIdx], CoreTypes::INTEL_CORE);
+					"Asteroids::RenderTask", &mAsteroidRenderTaskSets[subsetIdx], CoreTypes::INTEL_CORE, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
 			}
 		}
 		else if (settings.scheduler == Batched)
@@ -1015,10 +1045,10 @@ void Asteroids::Update(float frameTime, const OrbitCamera& camera, const Setting
 			}
 
 			gTaskMgrSS.CreateTaskSet(&Asteroids::SimulateSubsetTask, mSimulateTaskData, mRenderTaskCount, NULL,	0, 
-				"Asteroids::SimulateSubsetTask", &mAsteroidUpdateTaskSet, CoreTypes::INTEL_ATOM);
+				"Asteroids::SimulateSubsetTask", &mAsteroidUpdateTaskSet, CoreTypes::INTEL_ATOM, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
 
 			gTaskMgrSS.CreateTaskSet(&Asteroids::RenderSubsetTask, mRenderTaskData, mRenderTaskCount, &mAsteroidUpdateTaskSet, 1, 
-				"Asteroids::RenderSubsetTask", &mAsteroidRenderTaskSet, CoreTypes::INTEL_CORE);
+				"Asteroids::RenderSubsetTask", &mAsteroidRenderTaskSet, CoreTypes::INTEL_CORE, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
 		}
 
 		else if (settings.scheduler == Asymetric)
@@ -1053,11 +1083,23 @@ void Asteroids::Update(float frameTime, const OrbitCamera& camera, const Setting
 				mRenderTaskData[subsetIdx].subset = frame->mSubsets[subsetIdx];
 			}	
 
-			gTaskMgrSS.CreateTaskSet(&Asteroids::SimulateSubsetTask, mSimulateTaskData, mUpdateTaskCount, NULL, 0,
-				"Asteroids::SimulateSubsetTask", &mAsteroidUpdateTaskSet, CoreTypes::INTEL_ATOM);
+			// The P-Core share of the update subsets comes first, the E-Cores take the rest
+			TASKSETHANDLE updateTaskSets[2];
+			UINT updateTaskSetCount = 0;
+
+			if (mUpdateCoreSubsetCount > 0)
+			{
+				gTaskMgrSS.CreateTaskSet(&Asteroids::SimulateSubsetTask, mSimulateTaskData, mUpdateCoreSubsetCount, NULL, 0,
+					"Asteroids::SimulateSubsetTask", &mAsteroidUpdateCoreTaskSet, CoreTypes::INTEL_CORE, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
+				updateTaskSets[updateTaskSetCount++] = mAsteroidUpdateCoreTaskSet;
+			}
+
+			gTaskMgrSS.CreateTaskSet(&Asteroids::SimulateSubsetTask, mSimulateTaskData + mUpdateCoreSubsetCount, mUpdateTaskCount - mUpdateCoreSubsetCount, NULL, 0,
+				"Asteroids::SimulateSubsetTask", &mAsteroidUpdateTaskSet, CoreTypes::INTEL_ATOM, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
+			updateTaskSets[updateTaskSetCount++] = mAsteroidUpdateTaskSet;
 
-			gTaskMgrSS.CreateTaskSet(&Asteroids::RenderSubsetTask, mRenderTaskData, mRenderTaskCount, &mAsteroidUpdateTaskSet, 1,
-				"Asteroids::RenderSubsetTask", &mAsteroidRenderTaskSet, CoreTypes::INTEL_CORE);
+			gTaskMgrSS.CreateTaskSet(&Asteroids::RenderSubsetTask, mRenderTaskData, mRenderTaskCount, updateTaskSets, updateTaskSetCount,
+				"Asteroids::RenderSubsetTask", &mAsteroidRenderTaskSet, CoreTypes::INTEL_CORE, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
 		}
 	}
 	else
@@ -1102,7 +1144,7 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
 			}
 
 			gTaskMgrSS.CreateTaskSet(&Asteroids::RenderSubsetTask, mRenderTaskData, mRenderTaskCount, NULL, 0, 
-				"Asteroids::RenderSubsetTask", &mAsteroidRenderTaskSet, CoreTypes::INTEL_CORE);
+				"Asteroids::RenderSubsetTask", &mAsteroidRenderTaskSet, CoreTypes::INTEL_CORE, ISA_SCALAR, (TaskSetSteal)settings.stealPolicy);
 
 			if (!gTaskMgrSS.IsSetComplete(mAsteroidRenderTaskSet)) {
 				gTaskMgrSS.WaitForSet(mAsteroidRenderTaskSet);
@@ -1143,6 +1185,9 @@ void Asteroids::Render(float frameTime, const OrbitCamera& camera, const Setting
 				gTaskMgrSS.WaitForSet(mAsteroidRenderTaskSet);
 			}
 
+			if (mUpdateCoreSubsetCount > 0) {
+				gTaskMgrSS.ReleaseHandle(mAsteroidUpdateCoreTaskSet);
+			}
 			gTaskMgrSS.ReleaseHandle(mAsteroidUpdateTaskSet);
 			gTaskMgrSS.ReleaseHandle(mAsteroidRenderTaskSet);
 		}
@@ -214,6 +214,7 @@ private:
     UINT							mRenderTaskCount = 0;
     UINT							mDrawsPerSubset = 0;
 	UINT							mUpdatesPerSubset = 0;
+	UINT							mUpdateCoreSubsetCount = 0;	// Asymetric: leading update subsets run on P-Cores
 
     HWND							mWindow;
     PROCESSOR_INFO&					mProcInfo;
@@ -222,6 +223,7 @@ private:
     SimulateTaskData*				mSimulateTaskData = nullptr;
 
 	TASKSETHANDLE					mAsteroidUpdateTaskSet;
+	TASKSETHANDLE					mAsteroidUpdateCoreTaskSet;
 	TASKSETHANDLE					mAsteroidRenderTaskSet;
 
 	TASKSETHANDLE*					mAsteroidUpdateTaskSets;
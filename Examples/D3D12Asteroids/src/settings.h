@@ -87,4 +87,5 @@ struct Settings
     bool executeIndirect = true;            // Draw asteroids using ExecuteIndirect
 
     SchedulerType scheduler	= Batched;
+    unsigned int stealPolicy = 0;           // TaskSetSteal of the update/render tasksets (0 = Strict, 1 = Prefer, 2 = Any)
 };
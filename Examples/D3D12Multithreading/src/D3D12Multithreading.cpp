@@ -42,6 +42,8 @@ D3D12Multithreading::D3D12Multithreading(UINT width, UINT height, std::wstring n
 
 	// Read Processor Info at Startup
 	GetProcessorInfo(m_procInfo);
+	// Sample logical processor frequencies in the background instead of polling them every frame
+	m_frequencySampler.Start(m_procInfo);
     BOOL disablePriority = false;
 
     HANDLE process = GetCurrentProcess();
@@ -878,7 +880,7 @@ void D3D12Multithreading::OnUpdate()
         static int coreTypes[] = { ANY, NONE, RESERVED0, INTEL_ATOM, RESERVED1, INTEL_CORE };
         char* items[6] = { "Any", "None", "Reserved 0", "E-Core", "Reserved 1", "P-Core" };
 
-        UpdateProcessorInfo(m_procInfo);
+        m_frequencySampler.Update(m_procInfo);
 
         v = ImVec2(300, 0);
 
@@ -901,7 +903,7 @@ void D3D12Multithreading::OnUpdate()
             std::vector<ULONG> set = m_procInfo.cpuSets[coreTypes[selectedSet]];
             if (std::find(set.begin(), set.end(), core.id) == set.end()) continue;
 #else
-            if (!(core.processorMask.to_ulong() & m_procInfo.coreMasks[coreTypes[selectedSet]])) continue;
+            if ((core.processorMask & m_procInfo.coreMasks[coreTypes[selectedSet]]).None()) continue;
 #endif
 
             ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "%s  | %4d |  %2d |  %2d |   %2d | %2.2fgHz |",
@@ -929,7 +931,7 @@ void D3D12Multithreading::OnUpdate()
                 std::vector<ULONG> set = m_procInfo.cpuSets[coreTypes[selectedSet]];
                 if (std::find(set.begin(), set.end(), m_procInfo.cores[i].id) == set.end()) continue;
 #else
-                if (!(m_procInfo.cores[i].processorMask.to_ulong() & m_procInfo.coreMasks[coreTypes[selectedSet]])) continue;
+                if ((m_procInfo.cores[i].processorMask & m_procInfo.coreMasks[coreTypes[selectedSet]]).None()) continue;
 #endif
                 static std::vector<float> arr = samples[i];
                 arr.push_back(float(m_procInfo.cores[i].currentFrequency) / 1000.0f);
@@ -1002,12 +1004,12 @@ void D3D12Multithreading::OnUpdate()
         ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "System      | %s", std::bitset<64>(systemAffinityMask).to_string().c_str());
         ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Process     | %s", std::bitset<64>(processAffinityMask).to_string().c_str());
         ImGui::Separator();
-        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "None        | %s", std::bitset<64>(m_procInfo.coreMasks[CoreTypes::NONE]).to_string().c_str());
-        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Any         | %s", std::bitset<64>(m_procInfo.coreMasks[CoreTypes::ANY]).to_string().c_str());
-        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "P-Core      | %s", std::bitset<64>(m_procInfo.coreMasks[CoreTypes::INTEL_CORE]).to_string().c_str());
-        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "E-Core      | %s", std::bitset<64>(m_procInfo.coreMasks[CoreTypes::INTEL_ATOM]).to_string().c_str());
-        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Reserved 0  | %s", std::bitset<64>(m_procInfo.coreMasks[CoreTypes::RESERVED0]).to_string().c_str());
-        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Reserved 1  | %s", std::bitset<64>(m_procInfo.coreMasks[CoreTypes::RESERVED1]).to_string().c_str());
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "None        | %s", m_procInfo.coreMasks[CoreTypes::NONE].ToString().c_str());
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Any         | %s", m_procInfo.coreMasks[CoreTypes::ANY].ToString().c_str());
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "P-Core      | %s", m_procInfo.coreMasks[CoreTypes::INTEL_CORE].ToString().c_str());
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "E-Core      | %s", m_procInfo.coreMasks[CoreTypes::INTEL_ATOM].ToString().c_str());
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Reserved 0  | %s", m_procInfo.coreMasks[CoreTypes::RESERVED0].ToString().c_str());
+        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Reserved 1  | %s", m_procInfo.coreMasks[CoreTypes::RESERVED1].ToString().c_str());
         ImGui::Separator();
 
         for (int i = 0; i < m_procInfo.groups.size(); i++)
@@ -1022,8 +1024,8 @@ void D3D12Multithreading::OnUpdate()
             char buf[3] = "";
             if (m_procInfo.nodes[i].group)  sprintf(buf, "%2d", m_procInfo.nodes[i].group);
             else                            sprintf(buf, " 0");
-            if (i == 0) ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Node (%s/ 0)| %s", buf, std::bitset<64>(m_procInfo.nodes[i].mask).to_string().c_str());
-            else        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Node (%s/%2.0d)| %s", buf, m_procInfo.nodes[i].nodeNumber, std::bitset<64>(m_procInfo.groups[i].activeProcessorMask).to_string().c_str());
+            if (i == 0) ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Node (%s/ 0)| %s", buf, m_procInfo.nodes[i].mask.ToString().c_str());
+            else        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Node (%s/%2.0d)| %s", buf, m_procInfo.nodes[i].nodeNumber, m_procInfo.nodes[i].mask.ToString().c_str());
         }
 
         ImGui::Separator();
@@ -1032,8 +1034,8 @@ void D3D12Multithreading::OnUpdate()
             char buf[3] = "";
             if (m_procInfo.cores[i].group)  sprintf(buf, "%2d", m_procInfo.nodes[i].group);
             else                            sprintf(buf, " 0");
-            if (i == 0) ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Core (%s/ 0)| %s", buf, std::bitset<64>(m_procInfo.cores[i].processorMask).to_string().c_str());
-            else        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Core (%s/%2.0d)| %s", buf, m_procInfo.cores[i].logicalProcessorIndex, std::bitset<64>(m_procInfo.cores[i].processorMask).to_string().c_str());
+            if (i == 0) ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Core (%s/ 0)| %s", buf, m_procInfo.cores[i].processorMask.ToString().c_str());
+            else        ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Core (%s/%2.0d)| %s", buf, m_procInfo.cores[i].logicalProcessorIndex, m_procInfo.cores[i].processorMask.ToString().c_str());
         }
 
         ImGui::Separator();
@@ -1042,8 +1044,8 @@ void D3D12Multithreading::OnUpdate()
             char buf[3] = "";
             if (m_procInfo.caches[i].group) sprintf(buf, "%2d", m_procInfo.caches[i].group);
             else                            sprintf(buf, " 0");
-            if(i == 0) ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Cache(%s/ 0)| %s", buf, std::bitset<64>(m_procInfo.caches[i].processorMask).to_string().c_str());
-            else       ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Cache(%s/%2.0d)| %s", buf, i, std::bitset<64>(m_procInfo.caches[i].processorMask).to_string().c_str());
+            if(i == 0) ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Cache(%s/ 0)| %s", buf, m_procInfo.caches[i].processorMask.ToString().c_str());
+            else       ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "Cache(%s/%2.0d)| %s", buf, i, m_procInfo.caches[i].processorMask.ToString().c_str());
         }
 
         ImGui::End();
@@ -1129,7 +1131,7 @@ void D3D12Multithreading::OnUpdate()
         {
             if (core.group == m_procInfo.caches[i].group)
             {
-                if ((core.processorMask.to_ulong() & m_procInfo.caches[i].processorMask.to_ulong()))
+                if ((core.processorMask & m_procInfo.caches[i].processorMask).Any())
                 {
                     ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "%2d | %-11.11s |  %d  | %5d kb | %2d b",
                         i, CacheTypeString(m_procInfo.caches[i].type),
@@ -1176,7 +1178,7 @@ void D3D12Multithreading::OnUpdate()
         {
             if ((cache.group == m_procInfo.cores[i].group))
             {
-                if ((cache.processorMask.to_ulong() & m_procInfo.cores[i].processorMask.to_ulong()))
+                if ((cache.processorMask & m_procInfo.cores[i].processorMask).Any())
                 {
                     ImGui::TextColored(ImVec4(1.0f, 1.0f, 1.0f, 1.0f), "%2d | %-10.10s | %2.2f gHz | %2.2f gHz",
                         i, CoreTypeString(m_procInfo.cores[i].coreType),
@@ -153,6 +153,7 @@ private:
 
     // Special Sauce
 	PROCESSOR_INFO m_procInfo;
+	FrequencySampler m_frequencySampler;
     std::list<GPU_DEVICE_INFO*> gpuList;
     void LoadImGui();
     bool m_showMasks = true;
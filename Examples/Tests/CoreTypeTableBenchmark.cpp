@@ -0,0 +1,116 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Times CoreTypeTable::Current (processor number -> core type table) against reading the core type with CPUID leaf
+// 0x1A, which traps in virtual machines. Checks that both agree on every logical processor of the process affinity.
+//
+//   CoreTypeTableBenchmark [queries]
+
+#include <stdlib.h>
+#include <sched.h>
+#include <pthread.h>
+#include "HybridDetect.h"
+#include "TestCheck.h"
+#include "TestTiming.h"
+
+using namespace HybridDetect;
+
+#define REPETITIONS		9
+
+#if HYBRIDDETECT_CPU_X86_64
+// Core type reported by CPUID leaf 0x1A on the calling thread, NONE on parts without it
+static CoreTypes ProbeCoreType()
+{
+	std::array<unsigned, 4> cpuInfo{};
+	CallCPUID(LEAF_HYBRID_INFORMATION, cpuInfo);
+	return (CoreTypes)(cpuInfo[CPUID_EAX] >> 24);
+}
+#endif
+
+static bool PinTo(unsigned cpu)
+{
+	cpu_set_t pinned;
+	CPU_ZERO(&pinned);
+	CPU_SET(cpu, &pinned);
+	return pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) == 0;
+}
+
+// Current() & Lookup on every logical processor the thread can be pinned to, CPUID 0x1A when it reports a type
+static void CheckAgreement(const PROCESSOR_INFO& procInfo, const CoreTypeTable& table)
+{
+	cpu_set_t affinity;
+	CPU_ZERO(&affinity);
+	pthread_getaffinity_np(pthread_self(), sizeof(affinity), &affinity);
+
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		if (!CPU_ISSET(logicalCore.id, &affinity) || !PinTo(logicalCore.id)) continue;
+
+		CHECK_EQUAL(table.CurrentProcessorNumber(), logicalCore.id);
+		CHECK_EQUAL(table.Current(), logicalCore.coreType);
+#if HYBRIDDETECT_CPU_X86_64
+		const CoreTypes leafType = ProbeCoreType();
+		if (leafType != CoreTypes::NONE) CHECK_EQUAL(table.Current(), leafType);
+#endif
+	}
+
+	pthread_setaffinity_np(pthread_self(), sizeof(affinity), &affinity);
+	CHECK_EQUAL(table.Lookup(CoreTypeTable::UNKNOWN_PROCESSOR), CoreTypes::NONE);
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned queries = argc > 1 ? (unsigned)atoi(argv[1]) : 1000000;
+	if (0 == queries)
+	{
+		printf("usage: %s [queries]\n", argv[0]);
+		return 1;
+	}
+
+	PROCESSOR_INFO procInfo;
+	GetProcessorInfo(procInfo);
+
+	CoreTypeTable table;
+	table.Build(procInfo);
+	CheckAgreement(procInfo, table);
+
+	// Summed so the queries aren't optimized away
+	unsigned sum = 0;
+	const double tableNs = MedianOf(REPETITIONS, [&]()
+	{
+		const Clock::time_point start = Clock::now();
+		for (unsigned query = 0; query < queries; query++) sum += (unsigned)table.Current();
+		return NanosecondsSince(start) / queries;
+	});
+	printf("\n%u queries, median of %u runs, %u logical processors\n", queries, REPETITIONS, (unsigned)procInfo.cores.size());
+	printf("CoreTypeTable::Current  %10.1f ns/query\n", tableNs);
+
+#if HYBRIDDETECT_CPU_X86_64
+	// CPUID exits to the hypervisor in virtual machines, fewer queries keep the run short
+	const unsigned cpuidQueries = queries / 100 ? queries / 100 : 1;
+	const double cpuidNs = MedianOf(REPETITIONS, [&]()
+	{
+		const Clock::time_point start = Clock::now();
+		for (unsigned query = 0; query < cpuidQueries; query++) sum += (unsigned)ProbeCoreType();
+		return NanosecondsSince(start) / cpuidQueries;
+	});
+	printf("CPUID leaf 0x1A         %10.1f ns/query\n", cpuidNs);
+	printf("speedup                 %10.2fx\n", cpuidNs / tableNs);
+#endif
+	printf("(checksum %u)\n", sum);
+
+	printf("\nCoreTypeTableBenchmark: %s\n", gFailures ? "FAILED" : "passed");
+	return gFailures ? 1 : 0;
+}
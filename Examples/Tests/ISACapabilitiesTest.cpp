@@ -0,0 +1,105 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Checks the ISA common denominators (GetCoreTypeISA, GetClusterISA) against synthetic topologies mapped onto the
+// host: only logical processors this process may run on, whose CPUID leaves were read, lower them.
+
+#include "TestCheck.h"
+#include "TestTopology.h"
+
+using namespace HybridDetect;
+
+static void CheckSameISA(int line, const ISA_CAPABILITIES& actual, const ISA_CAPABILITIES& expected)
+{
+	CheckEqual(line, "level", actual.level, expected.level);
+	CheckEqual(line, "features", (long)actual.features, (long)expected.features);
+	CheckEqual(line, "count", actual.count, expected.count);
+}
+
+// First logical processor index outside of mask
+static unsigned OutsideOf(const ProcessorMask& mask)
+{
+	unsigned index = 0;
+	while (mask.Test(index)) index++;
+	return index;
+}
+
+static void TestUnprobed()
+{
+	PROCESSOR_INFO procInfo;
+	MakeHostTopology(procInfo, "4P+8E");
+	const ISA_CAPABILITIES any = GetCoreTypeISA(procInfo, CoreTypes::ANY);
+	const ISA_CAPABILITIES core = GetCoreTypeISA(procInfo, CoreTypes::INTEL_CORE);
+	const ISA_CAPABILITIES cluster = GetClusterISA(procInfo, procInfo.cores[0].processorMask);
+	CHECK_EQUAL(any.count, 16);
+
+	// An entry the probe could not pin to, e.g. sched_setaffinity failing: its bit-fields are zero, not probed
+	LOGICAL_PROCESSOR_INFO unprobed;
+	CHECK_EQUAL(unprobed.probed, 0);
+	CHECK_EQUAL(unprobed.parked, 0);
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+	CHECK_EQUAL(unprobed.AVX2, 0);
+	CHECK_EQUAL(unprobed.AVX512F, 0);
+#endif
+
+	unprobed.coreType = CoreTypes::INTEL_CORE;
+	unprobed.processorMask = procInfo.cores[0].processorMask;
+	procInfo.cores.push_back(unprobed);
+
+	CheckSameISA(__LINE__, GetCoreTypeISA(procInfo, CoreTypes::ANY), any);
+	CheckSameISA(__LINE__, GetCoreTypeISA(procInfo, CoreTypes::INTEL_CORE), core);
+	CheckSameISA(__LINE__, GetClusterISA(procInfo, unprobed.processorMask), cluster);
+}
+
+static void TestDisallowed()
+{
+	PROCESSOR_INFO procInfo;
+	MakeHostTopology(procInfo, "4P+8E");
+
+	// A cpuset limited to the logical processors of the topology, plus a probed E-Core outside of it without AVX2
+	procInfo.allowedMask = ProcessorMask();
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores) procInfo.allowedMask |= logicalCore.processorMask;
+	const ISA_CAPABILITIES any = GetCoreTypeISA(procInfo, CoreTypes::ANY);
+	const ISA_CAPABILITIES atom = GetCoreTypeISA(procInfo, CoreTypes::INTEL_ATOM);
+
+	LOGICAL_PROCESSOR_INFO outside = procInfo.cores.back();
+	outside.processorMask = IndexToProcessorMask(OutsideOf(procInfo.allowedMask));
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+	outside.AVX2 = 0;
+	outside.AVX512F = 0;
+#endif
+	procInfo.cores.push_back(outside);
+
+	CheckSameISA(__LINE__, GetCoreTypeISA(procInfo, CoreTypes::ANY), any);
+	CheckSameISA(__LINE__, GetCoreTypeISA(procInfo, CoreTypes::INTEL_ATOM), atom);
+	CheckSameISA(__LINE__, GetClusterISA(procInfo, outside.processorMask), ISA_CAPABILITIES());
+
+	// Without a known cpuset every logical processor counts
+	procInfo.allowedMask = ProcessorMask();
+	const ISA_CAPABILITIES all = GetCoreTypeISA(procInfo, CoreTypes::ANY);
+	CHECK_EQUAL(all.count, any.count + 1);
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+	CHECK_EQUAL(all.level, any.level >= ISA_AVX2 ? ISA_SSE4 : any.level);
+#endif
+}
+
+int main()
+{
+	TestUnprobed();
+	TestDisallowed();
+
+	printf("ISACapabilitiesTest: %s\n", gFailures ? "FAILED" : "passed");
+	return gFailures ? 1 : 0;
+}
@@ -0,0 +1,271 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// TaskMgrSS on a synthetic hybrid part whose E-Cores lack AVX-512 (InjectTopology, AVX512F cleared on the E-Cores).
+// Checks that no task of a taskset dispatched for an ISA runs on a thread whose pool lacks it, whatever core type &
+// TaskSetSteal it asks for, then times a kernel with the variant of each pool (AVX-512 on the P-Cores, AVX2 on the
+// E-Cores) against the variant every logical processor supports.
+//
+//   ISAPlacementBenchmark [frames] [tasks per taskset] [floats per task]
+
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <pthread.h>
+#include "TaskMgrSS.h"
+#include "TestTopology.h"
+#if HYBRIDDETECT_CPU_X86_64
+#include <immintrin.h>
+#endif
+
+using namespace HybridDetect;
+
+typedef void (*SAXPYFUNC)(float a, const float* x, float* y, unsigned count);
+
+static void SaxpyScalar(float a, const float* x, float* y, unsigned count)
+{
+	for (unsigned i = 0; i < count; i++) y[i] += a * x[i];
+}
+
+#if HYBRIDDETECT_CPU_X86_64
+HYBRIDDETECT_TARGET_AVX2 static void SaxpyAVX2(float a, const float* x, float* y, unsigned count)
+{
+	const __m256 va = _mm256_set1_ps(a);
+	unsigned i = 0;
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_ps(y + i, _mm256_fmadd_ps(va, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+	}
+	for (; i < count; i++) y[i] += a * x[i];
+}
+
+HYBRIDDETECT_TARGET_AVX512 static void SaxpyAVX512(float a, const float* x, float* y, unsigned count)
+{
+	const __m512 va = _mm512_set1_ps(a);
+	unsigned i = 0;
+	for (; i + 16 <= count; i += 16)
+	{
+		_mm512_storeu_ps(y + i, _mm512_fmadd_ps(va, _mm512_loadu_ps(x + i), _mm512_loadu_ps(y + i)));
+	}
+	for (; i < count; i++) y[i] += a * x[i];
+}
+#endif
+
+static ISADispatch<SAXPYFUNC> gSaxpy(SaxpyScalar);
+
+// ISA every logical processor supports: the main thread may run on any of them
+static ISALevel gCommonISA = ISA_SCALAR;
+static std::thread::id gMainThread;
+
+// ISA of the logical processors the calling thread may run on.  The workers of each pool are told apart by the names
+// TaskScheduler::Init gives them.
+static ISALevel GetThreadISALevel()
+{
+	static thread_local int level = -1;
+	if (level < 0)
+	{
+		char name[16] = {};
+		pthread_getname_np(pthread_self(), name, sizeof(name));
+
+		level = gCommonISA;
+		if (std::this_thread::get_id() != gMainThread)
+		{
+			if (0 == strncmp(name, "P-Core", 6)) level = gTaskMgrSS.GetPoolISALevel(CoreTypes::INTEL_CORE);
+			else if (0 == strncmp(name, "E-Core", 6) || 0 == strncmp(name, "Module", 6)) level = gTaskMgrSS.GetPoolISALevel(CoreTypes::INTEL_ATOM);
+		}
+	}
+	return (ISALevel)level;
+}
+
+struct SAXPY_TASKSET
+{
+	SAXPYFUNC			kernel = SaxpyScalar;
+	ISALevel			requiredISA = ISA_SCALAR;
+	std::vector<float>	x;
+	std::vector<float>	y;
+	unsigned			floatsPerTask = 0;
+	std::atomic<unsigned> misplaced{ 0 };
+	std::atomic<unsigned> tasksRun{ 0 };
+};
+
+static void SaxpyTask(void* pvArg, int, unsigned uTaskId, unsigned)
+{
+	SAXPY_TASKSET& set = *(SAXPY_TASKSET*)pvArg;
+	if (GetThreadISALevel() < set.requiredISA)
+	{
+		// Reaching an AVX-512 kernel here would be an illegal instruction on a real hybrid part
+		set.misplaced++;
+		return;
+	}
+
+	const size_t offset = (size_t)uTaskId * set.floatsPerTask;
+	set.kernel(0.5f, set.x.data() + offset, set.y.data() + offset, set.floatsPerTask);
+	set.tasksRun++;
+}
+
+struct BENCHMARK_PARAMETERS
+{
+	unsigned frames = 100;
+	unsigned tasksPerSet = 64;
+	unsigned floatsPerTask = 16384;
+};
+
+static void PrepareTaskSet(SAXPY_TASKSET& set, ISALevel level, const BENCHMARK_PARAMETERS& params)
+{
+	set.kernel = gSaxpy.Select(level);
+	set.requiredISA = level;
+	set.floatsPerTask = params.floatsPerTask;
+	set.x.assign((size_t)params.tasksPerSet * params.floatsPerTask, 1.0f);
+	set.y.assign((size_t)params.tasksPerSet * params.floatsPerTask, 0.0f);
+	set.misplaced = 0;
+	set.tasksRun = 0;
+}
+
+// AVX-512 tasksets asking for each core type & TaskSetSteal: CreateTaskSet moves them to a pool with AVX-512, or
+// refuses them when there is none.
+static bool CheckPlacement(const BENCHMARK_PARAMETERS& params)
+{
+	const CoreTypes coreTypes[] = { CoreTypes::INTEL_CORE, CoreTypes::INTEL_ATOM, CoreTypes::ANY };
+	const TaskSetSteal steals[] = { TASKSET_STEAL_STRICT, TASKSET_STEAL_PREFER, TASKSET_STEAL_ANY };
+
+	std::vector<SAXPY_TASKSET> sets(9);
+	std::vector<TASKSETHANDLE> handles;
+	unsigned refused = 0;
+	for (unsigned i = 0; i < 9; i++)
+	{
+		PrepareTaskSet(sets[i], ISA_AVX512, params);
+
+		TASKSETHANDLE hSet;
+		if (gTaskMgrSS.CreateTaskSet(SaxpyTask, &sets[i], params.tasksPerSet, NULL, 0, "AVX-512", &hSet,
+			coreTypes[i % 3], ISA_AVX512, steals[i / 3]))
+		{
+			handles.push_back(hSet);
+		}
+		else
+		{
+			sets[i].tasksRun = params.tasksPerSet;
+			refused++;
+		}
+	}
+	for (TASKSETHANDLE hSet : handles) gTaskMgrSS.WaitForSet(hSet);
+	gTaskMgrSS.ReleaseHandles(handles.data(), (unsigned)handles.size());
+
+	const bool anyAVX512 = gTaskMgrSS.GetPoolISALevel(CoreTypes::INTEL_CORE) >= ISA_AVX512 ||
+		gTaskMgrSS.GetPoolISALevel(CoreTypes::INTEL_ATOM) >= ISA_AVX512;
+	unsigned misplaced = 0;
+	unsigned tasksRun = 0;
+	for (const SAXPY_TASKSET& set : sets)
+	{
+		misplaced += set.misplaced;
+		tasksRun += set.tasksRun;
+	}
+
+	printf("AVX-512 tasksets: %u created, %u refused, %u tasks on threads without AVX-512\n",
+		(unsigned)handles.size(), refused, misplaced);
+	if (misplaced || tasksRun != 9 * params.tasksPerSet || (refused != 0) == anyAVX512)
+	{
+		printf("ISA placement FAILED\n");
+		return false;
+	}
+	return true;
+}
+
+typedef std::chrono::steady_clock Clock;
+
+// One taskset per core type and frame, each running the kernel variant for coreISA/atomISA
+static bool TimeKernels(ISALevel coreISA, ISALevel atomISA, const BENCHMARK_PARAMETERS& params, double& nsPerTask)
+{
+	SAXPY_TASKSET core;
+	SAXPY_TASKSET atom;
+	PrepareTaskSet(core, coreISA, params);
+	PrepareTaskSet(atom, atomISA, params);
+
+	const Clock::time_point start = Clock::now();
+	for (unsigned frame = 0; frame < params.frames; frame++)
+	{
+		TASKSETHANDLE hSets[2];
+		if (!gTaskMgrSS.CreateTaskSet(SaxpyTask, &core, params.tasksPerSet, NULL, 0, "P-Core Saxpy", &hSets[0],
+				CoreTypes::INTEL_CORE, coreISA) ||
+			!gTaskMgrSS.CreateTaskSet(SaxpyTask, &atom, params.tasksPerSet, NULL, 0, "E-Core Saxpy", &hSets[1],
+				CoreTypes::INTEL_ATOM, atomISA))
+		{
+			printf("CreateTaskSet failed\n");
+			return false;
+		}
+		gTaskMgrSS.WaitForSet(hSets[0]);
+		gTaskMgrSS.WaitForSet(hSets[1]);
+		gTaskMgrSS.ReleaseHandles(hSets, 2);
+	}
+	const double ns = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+	nsPerTask = ns / (2.0 * params.frames * params.tasksPerSet);
+
+	if (core.misplaced || atom.misplaced || core.tasksRun + atom.tasksRun != 2 * params.frames * params.tasksPerSet)
+	{
+		printf("ISA placement FAILED\n");
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	BENCHMARK_PARAMETERS params;
+	if (argc > 1) params.frames = (unsigned)atoi(argv[1]);
+	if (argc > 2) params.tasksPerSet = (unsigned)atoi(argv[2]);
+	if (argc > 3) params.floatsPerTask = (unsigned)atoi(argv[3]);
+	if (params.frames == 0 || params.tasksPerSet == 0 || params.tasksPerSet > MAX_TASKSETSIZE || params.floatsPerTask == 0)
+	{
+		printf("usage: %s [frames] [tasks per taskset] [floats per task]\n", argv[0]);
+		return 1;
+	}
+
+#if HYBRIDDETECT_CPU_X86_64
+	gSaxpy.Register(ISA_AVX2, SaxpyAVX2).Register(ISA_AVX512, SaxpyAVX512);
+#endif
+	gMainThread = std::this_thread::get_id();
+
+	// 4 P-Cores with AVX-512 (when the host has it) & 8 E-Cores without
+	PROCESSOR_INFO procInfo;
+	MakeHostTopology(procInfo, "4P+8E");
+	for (LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		if (logicalCore.coreType == CoreTypes::INTEL_ATOM) logicalCore.AVX512F = 0;
+	}
+
+	gTaskMgrSS.Init(procInfo);
+
+	const ISALevel coreISA = gTaskMgrSS.GetPoolISALevel(CoreTypes::INTEL_CORE);
+	const ISALevel atomISA = gTaskMgrSS.GetPoolISALevel(CoreTypes::INTEL_ATOM);
+	gCommonISA = GetCoreTypeISA(procInfo, CoreTypes::ANY).level;
+	printf("\nPool ISA: P-Core %s, E-Core %s, common %s\n", ISALevelString(coreISA), ISALevelString(atomISA),
+		ISALevelString(gCommonISA));
+
+	double perPool = 0.0;
+	double common = 0.0;
+	const bool passed = CheckPlacement(params) &&
+		TimeKernels(coreISA, atomISA, params, perPool) &&
+		TimeKernels(gCommonISA, gCommonISA, params, common);
+	gTaskMgrSS.Shutdown();
+	if (!passed) return 1;
+
+	printf("%u frames of 2 tasksets of %u tasks of %u floats, %u logical processors\n", params.frames,
+		params.tasksPerSet, params.floatsPerTask, std::thread::hardware_concurrency());
+	printf("kernel variant per pool     %8.1f ns/task\n", perPool);
+	printf("common kernel variant       %8.1f ns/task\n", common);
+	printf("speedup                     %8.2fx\n", common / perPool);
+	return 0;
+}
@@ -0,0 +1,179 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Stress test of CreateTaskSet & ReleaseHandle(s) from inside running tasks: every worker of every pool spawns nested
+// tasksets, each a hub with a chain of children depending on it (more successors than MAX_SUCCESSORS), for each core
+// type & TaskSetSteal, on a hybrid then a homogeneous synthetic topology (InjectTopology, switched by UpdateTopology).
+// Also checks that no two threads run tasks with the same context ID.
+//
+//   NestedTaskSetTest [frames per topology] [root tasks]
+
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include "TaskMgrSS.h"
+#include "TestTopology.h"
+
+using namespace HybridDetect;
+
+#define CHILD_COUNT		24
+#define MAX_DEPTH		3
+#define MAX_CONTEXTS	64
+
+static std::atomic<unsigned> gTasksRun(0);
+static std::atomic<unsigned> gCreateFailures(0);
+
+// Thread (hash) running with each context ID, tasks of PREFER/ANY sets run on every pool
+static std::atomic<size_t> gContextThreads[MAX_CONTEXTS];
+static std::atomic<unsigned> gContextClashes(0);
+
+static void CheckContext(int iContextId)
+{
+	const size_t thread = std::hash<std::thread::id>()(std::this_thread::get_id()) | 1;
+	size_t owner = 0;
+	if (iContextId < 0 || iContextId >= MAX_CONTEXTS ||
+		(!gContextThreads[iContextId].compare_exchange_strong(owner, thread) && owner != thread))
+	{
+		gContextClashes++;
+	}
+}
+
+static void ResetContexts()
+{
+	for (auto& context : gContextThreads) context = 0;
+}
+
+static const CoreTypes gCoreTypes[] = { CoreTypes::INTEL_ATOM, CoreTypes::INTEL_CORE, CoreTypes::ANY };
+
+static void Leaf(void*, int iContextId, unsigned uTaskId, unsigned)
+{
+	CheckContext(iContextId);
+	volatile unsigned sum = 0;
+	for (unsigned i = 0; i < uTaskId % 50; i++) sum += i;
+	gTasksRun++;
+}
+
+// Task of a taskset at depth (pvArg) > 0: spawns a hub & CHILD_COUNT children, every 4th a taskset at depth - 1,
+// and doesn't wait for them (tasks must not call WaitForSet).
+static void Node(void* pvArg, int iContextId, unsigned uTaskId, unsigned)
+{
+	CheckContext(iContextId);
+	const size_t depth = (size_t)pvArg;
+	gTasksRun++;
+	if (0 == depth) return;
+
+	TASKSETHANDLE hHub;
+	if (!gTaskMgrSS.CreateTaskSet(Leaf, NULL, 2, NULL, 0, "Hub", &hHub, gCoreTypes[uTaskId % 3], ISA_SCALAR,
+		(TaskSetSteal)(uTaskId % 3)))
+	{
+		gCreateFailures++;
+		return;
+	}
+
+	TASKSETHANDLE hChildren[CHILD_COUNT];
+	for (unsigned child = 0; child < CHILD_COUNT; child++)
+	{
+		TASKSETHANDLE hDepends[2] = { hHub, child ? hChildren[child - 1] : hHub };
+		if (!gTaskMgrSS.CreateTaskSet(child % 4 ? Leaf : Node, (void*)(depth - 1), 1 + child % 3, hDepends, 2, "Child",
+			&hChildren[child], gCoreTypes[(uTaskId + child) % 3], ISA_SCALAR, (TaskSetSteal)(child % 3)))
+		{
+			gCreateFailures++;
+			gTaskMgrSS.ReleaseHandle(hHub);
+			gTaskMgrSS.ReleaseHandles(hChildren, child);
+			return;
+		}
+	}
+
+	gTaskMgrSS.ReleaseHandle(hHub);
+	gTaskMgrSS.ReleaseHandles(hChildren, CHILD_COUNT);
+}
+
+// Tasks run for one Node task at depth, counting everything it spawns
+static unsigned ExpectedTasks(unsigned depth)
+{
+	if (0 == depth) return 1;
+
+	unsigned tasks = 1 + 2;
+	for (unsigned child = 0; child < CHILD_COUNT; child++)
+	{
+		tasks += (1 + child % 3) * (child % 4 ? 1 : ExpectedTasks(depth - 1));
+	}
+	return tasks;
+}
+
+static bool RunFrames(unsigned firstFrame, unsigned frames, unsigned rootTasks)
+{
+	for (unsigned frame = firstFrame; frame < firstFrame + frames; frame++)
+	{
+		const unsigned depth = frame % 2 ? MAX_DEPTH : MAX_DEPTH - 1;
+		const unsigned expected = rootTasks * ExpectedTasks(depth);
+		gTasksRun = 0;
+
+		TASKSETHANDLE hRoot;
+		if (!gTaskMgrSS.CreateTaskSet(Node, (void*)(size_t)depth, rootTasks, NULL, 0, "Root", &hRoot,
+			gCoreTypes[frame % 3]))
+		{
+			printf("frame %u: CreateTaskSet failed\n", frame);
+			return false;
+		}
+		gTaskMgrSS.WaitForSet(hRoot);
+		gTaskMgrSS.ReleaseHandle(hRoot);
+
+		// The root doesn't wait for its descendants, the workers run them while the main thread waits
+		const auto timeout = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+		while (gTasksRun < expected && 0 == gCreateFailures && std::chrono::steady_clock::now() < timeout)
+		{
+			std::this_thread::yield();
+		}
+
+		if (gTasksRun != expected || gCreateFailures || gContextClashes)
+		{
+			printf("frame %u: %u of %u tasks run, %u CreateTaskSet failures, %u context ID clashes\n", frame,
+				gTasksRun.load(), expected, gCreateFailures.load(), gContextClashes.load());
+			return false;
+		}
+	}
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned frames = argc > 1 ? (unsigned)atoi(argv[1]) : 4;
+	const unsigned rootTasks = argc > 2 ? (unsigned)atoi(argv[2]) : 64;
+	if (0 == frames || 0 == rootTasks || rootTasks > MAX_TASKSETSIZE)
+	{
+		printf("usage: %s [frames per topology] [root tasks]\n", argv[0]);
+		return 1;
+	}
+
+	PROCESSOR_INFO procInfo;
+	MakeHostTopology(procInfo, "4P+8E");
+	ResetContexts();
+	gTaskMgrSS.Init(procInfo);
+	bool passed = RunFrames(0, frames, rootTasks);
+
+	// UpdateTopology from a hybrid to a homogeneous part, INTEL_ATOM & INTEL_CORE tasksets then share one pool
+	if (passed)
+	{
+		MakeHostTopology(procInfo, "8P, no SMT");
+		gTaskMgrSS.UpdateTopology(procInfo);
+		ResetContexts();
+		passed = RunFrames(frames, frames, rootTasks);
+	}
+	gTaskMgrSS.Shutdown();
+
+	printf("\nNestedTaskSetTest: %s\n", passed ? "passed" : "FAILED");
+	return passed ? 0 : 1;
+}
@@ -0,0 +1,126 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Checks that GetProcessorInfo leaves the affinity of its callers alone: it probes every logical processor from
+// helper threads, also when called concurrently from threads pinned to one logical processor each.
+
+#include <sched.h>
+#include <pthread.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "HybridDetect.h"
+#include "TestCheck.h"
+
+using namespace HybridDetect;
+
+#define CALLER_COUNT	4
+#define CALL_COUNT		3
+
+static std::atomic<unsigned> gReady(0);
+
+// Logical processors of the process affinity
+static std::vector<unsigned> AllowedCPUs()
+{
+	std::vector<unsigned> cpus;
+	cpu_set_t affinity;
+	CPU_ZERO(&affinity);
+	if (sched_getaffinity(0, sizeof(affinity), &affinity) == 0)
+	{
+		for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++)
+		{
+			if (CPU_ISSET(cpu, &affinity)) cpus.push_back(cpu);
+		}
+	}
+	return cpus;
+}
+
+// Runs GetProcessorInfo CALL_COUNT times once callerCount callers are ready, returns the logical processor count
+static unsigned CallGetProcessorInfo(unsigned callerCount)
+{
+	gReady++;
+	while (gReady < callerCount) std::this_thread::yield();
+
+	unsigned logicalCores = 0;
+	for (unsigned call = 0; call < CALL_COUNT; call++)
+	{
+		PROCESSOR_INFO procInfo;
+		GetProcessorInfo(procInfo);
+		logicalCores = (unsigned)procInfo.cores.size();
+	}
+	return logicalCores;
+}
+
+static void TestPinnedCallers(const std::vector<unsigned>& cpus)
+{
+	std::vector<std::thread> callers;
+	std::vector<int> unchanged(CALLER_COUNT, 0);
+	std::vector<unsigned> logicalCores(CALLER_COUNT, 0);
+	gReady = 0;
+
+	for (unsigned caller = 0; caller < CALLER_COUNT; caller++)
+	{
+		callers.emplace_back([&, caller]()
+		{
+			cpu_set_t pinned;
+			CPU_ZERO(&pinned);
+			CPU_SET(cpus[caller % cpus.size()], &pinned);
+			if (pthread_setaffinity_np(pthread_self(), sizeof(pinned), &pinned) != 0)
+			{
+				gReady++;
+				return;
+			}
+
+			logicalCores[caller] = CallGetProcessorInfo(CALLER_COUNT);
+
+			cpu_set_t after;
+			CPU_ZERO(&after);
+			unchanged[caller] = pthread_getaffinity_np(pthread_self(), sizeof(after), &after) == 0 && CPU_EQUAL(&pinned, &after);
+		});
+	}
+
+	for (std::thread& caller : callers) caller.join();
+
+	for (unsigned caller = 0; caller < CALLER_COUNT; caller++)
+	{
+		CHECK_EQUAL(unchanged[caller], 1);
+		CHECK_EQUAL(logicalCores[caller], logicalCores[0]);
+	}
+	CHECK_EQUAL(logicalCores[0] > 0, 1);
+}
+
+// The main thread, left with the process affinity
+static void TestUnpinnedCaller(const std::vector<unsigned>& cpus)
+{
+	gReady = 0;
+	CallGetProcessorInfo(1);
+	CHECK_EQUAL(AllowedCPUs() == cpus, 1);
+}
+
+int main()
+{
+	const std::vector<unsigned> cpus = AllowedCPUs();
+	if (cpus.empty())
+	{
+		printf("ProcessorInfoAffinityTest: sched_getaffinity failed\n");
+		return 1;
+	}
+
+	TestPinnedCallers(cpus);
+	TestUnpinnedCaller(cpus);
+
+	printf("ProcessorInfoAffinityTest: %s\n", gFailures ? "FAILED" : "passed");
+	return gFailures ? 1 : 0;
+}
@@ -0,0 +1,177 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Checks RecommendThreads against synthetic topologies (InjectTopology), independent of the machine it runs on.
+
+#include "TestCheck.h"
+#include "TestTopology.h"
+
+using namespace HybridDetect;
+
+static unsigned Recommend(const PROCESSOR_INFO& procInfo, WorkloadClass workload, CoreTypes coreType,
+	unsigned reservedThreads = 0, unsigned quotaUsed = 0)
+{
+	THREAD_RECOMMENDATION recommendation;
+	RecommendThreads(procInfo, workload, coreType, recommendation, reservedThreads, quotaUsed);
+	return recommendation.threadCount;
+}
+
+static void TestWorkloadClasses()
+{
+	// 8 P-Cores with 2 threads each & 16 E-Cores
+	PROCESSOR_INFO procInfo;
+	MakeSyntheticTopology(procInfo, "8P+16E");
+
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::ANY), 32);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE), 16);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_ATOM), 16);
+
+	// SMT siblings are left idle
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::ANY), 24);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::INTEL_CORE), 8);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::INTEL_ATOM), 16);
+
+	// Background work goes to every other E-Core when any core type may be used
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_BACKGROUND, CoreTypes::ANY), 8);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_BACKGROUND, CoreTypes::INTEL_CORE), 4);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_BACKGROUND, CoreTypes::INTEL_ATOM), 8);
+
+	// The main thread takes one of the P-Core threads
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE, 1), 15);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::INTEL_CORE, 8), 0);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::INTEL_CORE, 9), 0);
+}
+
+static void TestSMT()
+{
+	PROCESSOR_INFO procInfo;
+
+	MakeSyntheticTopology(procInfo, "8P, no SMT");
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::ANY), 8);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::ANY), 8);
+
+	MakeSyntheticTopology(procInfo, "8P, SMT4");
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::ANY), 32);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::ANY), 8);
+
+	// Homogeneous parts have no more efficient core type to send background work to
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_BACKGROUND, CoreTypes::ANY), 4);
+}
+
+static void TestParkedCores()
+{
+	PROCESSOR_INFO procInfo;
+	MakeSyntheticTopology(procInfo, "4P+8E");
+
+	// Both threads of P-Core 0, the first thread of P-Core 1 & two E-Cores
+	procInfo.cores[0].parked = 1;
+	procInfo.cores[1].parked = 1;
+	procInfo.cores[2].parked = 1;
+	procInfo.cores[8].parked = 1;
+	procInfo.cores[9].parked = 1;
+
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE), 5);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::INTEL_CORE), 3);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_ATOM), 6);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::ANY), 11);
+
+	THREAD_RECOMMENDATION recommendation;
+	RecommendThreads(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE, recommendation);
+	CHECK_EQUAL(recommendation.processorMask.Count(), 5);
+	CHECK_EQUAL(recommendation.processorMask.Test(2), 0);
+	CHECK_EQUAL(recommendation.processorMask.Test(3), 1);
+#ifdef ENABLE_CPU_SETS
+	CHECK_EQUAL(recommendation.cpuSets.size(), 5);
+	CHECK_EQUAL(recommendation.cpuSets.front(), 3);
+#endif
+}
+
+static void TestAllowedProcessors()
+{
+	PROCESSOR_INFO procInfo;
+	MakeSyntheticTopology(procInfo, "4P+8E");
+
+	// Affinity/cpuset of the first two P-Cores and the first E-Core module
+	for (unsigned cpu = 0; cpu < 4; cpu++) procInfo.allowedMask.Set(cpu);
+	for (unsigned cpu = 8; cpu < 12; cpu++) procInfo.allowedMask.Set(cpu);
+
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE), 4);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::INTEL_CORE), 2);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_ATOM), 4);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_BACKGROUND, CoreTypes::ANY), 2);
+}
+
+static void TestQuota()
+{
+	PROCESSOR_INFO procInfo;
+	MakeSyntheticTopology(procInfo, "4P+8E");
+
+	// cgroup cpu.max / job object of 5.5 logical processors, rounded up
+	procInfo.cpuQuota = 5.5;
+
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::ANY), 6);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE, 1), 5);
+
+	// The E-Core pool gets what the P-Core pool & the main thread leave, like TaskMgrSS::Init
+	const unsigned core = Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_CORE, 1);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_ATOM, 0, core + 1), 0);
+
+	procInfo.cpuQuota = 12.0;
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::INTEL_ATOM, 0, 7 + 1), 4);
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_LATENCY_CRITICAL, CoreTypes::ANY), 12);
+
+	// Quotas below the core count still leave one thread
+	procInfo.cpuQuota = 0.5;
+	CHECK_EQUAL(Recommend(procInfo, WORKLOAD_THROUGHPUT, CoreTypes::ANY), 1);
+}
+
+static void TestDeterminism()
+{
+	PROCESSOR_INFO procInfo;
+	MakeSyntheticTopology(procInfo, "6P+8E, 2 NUMA nodes, L2 per 4 E-cores");
+	procInfo.cores[5].parked = 1;
+	procInfo.cpuQuota = 9.0;
+
+	for (int workload = WORKLOAD_LATENCY_CRITICAL; workload <= WORKLOAD_BACKGROUND; workload++)
+	{
+		const CoreTypes coreTypes[] = { CoreTypes::ANY, CoreTypes::INTEL_CORE, CoreTypes::INTEL_ATOM };
+		for (CoreTypes coreType : coreTypes)
+		{
+			THREAD_RECOMMENDATION first;
+			THREAD_RECOMMENDATION second;
+			RecommendThreads(procInfo, (WorkloadClass)workload, coreType, first, 1, 2);
+			RecommendThreads(procInfo, (WorkloadClass)workload, coreType, second, 1, 2);
+
+			CHECK_EQUAL(first.threadCount, second.threadCount);
+			CHECK_EQUAL(first.processorMask == second.processorMask, 1);
+#ifdef ENABLE_CPU_SETS
+			CHECK_EQUAL(first.cpuSets == second.cpuSets, 1);
+#endif
+		}
+	}
+}
+
+int main()
+{
+	TestWorkloadClasses();
+	TestSMT();
+	TestParkedCores();
+	TestAllowedProcessors();
+	TestQuota();
+	TestDeterminism();
+
+	printf("RecommendThreadsTest: %s\n", gFailures ? "FAILED" : "passed");
+	return gFailures ? 1 : 0;
+}
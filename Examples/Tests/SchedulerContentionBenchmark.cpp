@@ -0,0 +1,321 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Times TaskMgrSS (per thread deques of task ranges) against the ring scan TaskScheduler it replaced, with many
+// threads contending for a few tasksets of small tasks, at 8, 16, 32 & 64 threads (main thread included).
+//
+//   SchedulerContentionBenchmark [frames] [tasksets per frame] [tasks per taskset] [work per task] [repetitions]
+
+#include <stdlib.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include "TaskMgrSS.h"
+#include "TestTiming.h"
+#include "TestTopology.h"
+
+using namespace HybridDetect;
+
+static std::atomic<unsigned> gTasksRun(0);
+
+static void Work(void* pvArg, int, unsigned, unsigned)
+{
+	const unsigned work = (unsigned)(size_t)pvArg;
+	volatile unsigned sum = 0;
+	for (unsigned i = 0; i < work; i++) sum += i;
+	gTasksRun.fetch_add(1, std::memory_order_relaxed);
+}
+
+// The scheduler before the deques: all tasksets in one ring of handles that every thread scans, claiming one task at
+// a time with an atomic decrement of the taskset's task id, idle workers sleeping on a semaphore (TaskSemaphore in
+// place of the Win32 one) woken as the original AddTaskSet did.  Unlike the original, executed tasks decrement the
+// task count (DecrementTaskCount was commented out, so its workers never went back to sleep) and AddTaskSet reuses
+// the slots of completed tasksets, so the ring can't fill up with them while the workers sleep.
+class RingScanScheduler
+{
+public:
+	void Init(int threadCount, unsigned maxTaskSets)
+	{
+		mbAlive = true;
+		miTaskCount = 0;
+		miWriter = 0;
+		miThreadCount = threadCount;
+		for (auto& slot : mhActiveTaskSets) slot = TASKSETHANDLE_INVALID;
+		mTaskAvailable.Init(threadCount);
+
+		// Handles aren't recycled, so a slot can't be cleared for a taskset that took over its handle
+		mSets.reset(new TaskSet[maxTaskSets]);
+		muSetCount = 0;
+
+		for (int thread = 0; thread < threadCount; thread++)
+		{
+			mThreads.emplace_back(&RingScanScheduler::ExecuteTasks, this, thread + 1);
+		}
+	}
+
+	void Shutdown()
+	{
+		// Wake up the sleeping threads and wait for them to exit
+		mbAlive = false;
+		const int iSleepCount = mTaskAvailable.Release(1);
+		mTaskAvailable.Release(miThreadCount - iSleepCount);
+		for (auto& thread : mThreads) thread.join();
+		mThreads.clear();
+	}
+
+	TASKSETHANDLE CreateTaskSet(TASKSETFUNC pFunc, void* pvArg, unsigned taskCount)
+	{
+		const TASKSETHANDLE hSet = muSetCount++;
+		TaskSet& set = mSets[hSet];
+		set.mpFunc = pFunc;
+		set.mpvArg = pvArg;
+		set.muSize = taskCount;
+		set.miCompletionCount = (int)taskCount;
+		set.miTaskId = (int)taskCount;
+		AddTaskSet(hSet, (int)taskCount);
+		return hSet;
+	}
+
+	// Like TaskScheduler::WaitForFlag, the main thread runs tasks of any taskset until the one it waits for completed
+	void WaitForSet(TASKSETHANDLE hSet)
+	{
+		int iReader = miWriter;
+		while (mSets[hSet].miCompletionCount > 0)
+		{
+			if (!ScanSlot(iReader, 0) && 0 == miTaskCount)
+			{
+				while (0 == miTaskCount && mSets[hSet].miCompletionCount > 0);
+			}
+		}
+	}
+
+private:
+	struct TaskSet
+	{
+		TASKSETFUNC				mpFunc = NULL;
+		void*					mpvArg = NULL;
+		unsigned				muSize = 0;
+		std::atomic<int>		miCompletionCount{ 0 };
+		std::atomic<int>		miTaskId{ 0 };
+	};
+
+	static const int RING_SIZE = MAX_TASKSETS;
+
+	bool Active(TASKSETHANDLE hSet) const
+	{
+		return mSets[hSet].miCompletionCount > 0 && mSets[hSet].miTaskId > 0;
+	}
+
+	// Runs one task of the taskset in the slot, or moves on to the next slot; returns false on an empty slot
+	bool ScanSlot(int& iReader, int iContextId)
+	{
+		TASKSETHANDLE hSet = mhActiveTaskSets[iReader];
+		if (TASKSETHANDLE_INVALID == hSet)
+		{
+			iReader = (iReader + 1) & (RING_SIZE - 1);
+			return false;
+		}
+
+		TaskSet& set = mSets[hSet];
+		const int iTask = Active(hSet) ? set.miTaskId.fetch_sub(1) - 1 : -1;
+		if (iTask >= 0)
+		{
+			set.mpFunc(set.mpvArg, iContextId, (unsigned)iTask, set.muSize);
+			miTaskCount--;
+			set.miCompletionCount--;
+		}
+		else
+		{
+			mhActiveTaskSets[iReader].compare_exchange_strong(hSet, TASKSETHANDLE_INVALID);
+			iReader = (iReader + 1) & (RING_SIZE - 1);
+		}
+		return true;
+	}
+
+	void ExecuteTasks(int iContextId)
+	{
+		int iReader = 0;
+		while (mbAlive)
+		{
+			if (!ScanSlot(iReader, iContextId) && miTaskCount <= 0)
+			{
+				mTaskAvailable.Wait();
+			}
+		}
+	}
+
+	void AddTaskSet(TASKSETHANDLE hSet, int iTaskCount)
+	{
+		// The task count goes up before the taskset is in the ring, keeping the workers from going to sleep
+		miTaskCount += iTaskCount;
+
+		int iWriter = miWriter;
+		for (;;)
+		{
+			TASKSETHANDLE hSlot = mhActiveTaskSets[iWriter];
+			if ((TASKSETHANDLE_INVALID == hSlot || !Active(hSlot)) &&
+				mhActiveTaskSets[iWriter].compare_exchange_strong(hSlot, hSet))
+			{
+				break;
+			}
+			iWriter = (iWriter + 1) & (RING_SIZE - 1);
+		}
+
+		// Wake up as many suspended threads as there are tasks
+		const int iSleepCount = mTaskAvailable.Release(1);
+		const int iCountToWake = iTaskCount < miThreadCount - iSleepCount - 1 ? iTaskCount : miThreadCount - iSleepCount - 1;
+		mTaskAvailable.Release(iCountToWake);
+
+		miWriter = iWriter;
+	}
+
+	std::atomic<bool>					mbAlive{ false };
+	std::atomic<int>					miTaskCount{ 0 };
+	std::atomic<int>					miWriter{ 0 };
+	int									miThreadCount = 0;
+	std::atomic<TASKSETHANDLE>			mhActiveTaskSets[RING_SIZE];
+	std::unique_ptr<TaskSet[]>			mSets;
+	unsigned							muSetCount = 0;
+	std::vector<std::thread>			mThreads;
+	TaskSemaphore						mTaskAvailable;
+};
+
+struct BENCHMARK_PARAMETERS
+{
+	unsigned frames = 50;
+	unsigned setsPerFrame = 8;
+	unsigned tasksPerSet = 256;
+	unsigned workPerTask = 200;
+	unsigned repetitions = 5;
+};
+
+static unsigned TasksPerRun(const BENCHMARK_PARAMETERS& params)
+{
+	return params.frames * params.setsPerFrame * params.tasksPerSet;
+}
+
+// Every run, warm-up included, must have run all of its tasks
+static bool CheckTasksRun(const char* scheduler, const BENCHMARK_PARAMETERS& params)
+{
+	const unsigned expected = TasksPerRun(params) * (params.repetitions + 1);
+	if (gTasksRun != expected)
+	{
+		printf("%s ran %u tasks, expected %u\n", scheduler, gTasksRun.load(), expected);
+		return false;
+	}
+	return true;
+}
+
+static bool RunRingScan(unsigned threadCount, const BENCHMARK_PARAMETERS& params, double& nsPerTask)
+{
+	RingScanScheduler scheduler;
+	scheduler.Init((int)threadCount - 1, params.frames * params.setsPerFrame * (params.repetitions + 1));
+	gTasksRun = 0;
+
+	void* pvWork = (void*)(size_t)params.workPerTask;
+	std::vector<TASKSETHANDLE> sets(params.setsPerFrame);
+	nsPerTask = MedianOf(params.repetitions, [&]()
+	{
+		const Clock::time_point start = Clock::now();
+		for (unsigned frame = 0; frame < params.frames; frame++)
+		{
+			for (auto& hSet : sets) hSet = scheduler.CreateTaskSet(Work, pvWork, params.tasksPerSet);
+			for (auto& hSet : sets) scheduler.WaitForSet(hSet);
+		}
+		return NanosecondsSince(start) / TasksPerRun(params);
+	});
+
+	scheduler.Shutdown();
+	return CheckTasksRun("ring scan", params);
+}
+
+static bool RunTaskMgrSS(unsigned threadCount, const BENCHMARK_PARAMETERS& params, double& nsPerTask)
+{
+	// A homogeneous part with one core per thread: TaskMgrSS keeps one for the main thread
+	PROCESSOR_INFO procInfo;
+	MakeHostTopology(procInfo, (std::to_string(threadCount) + "P, no SMT").c_str());
+
+	gTaskMgrSS.Init(procInfo);
+	gTasksRun = 0;
+
+	void* pvWork = (void*)(size_t)params.workPerTask;
+	std::vector<TASKSETHANDLE> sets(params.setsPerFrame);
+	bool created = true;
+	nsPerTask = MedianOf(params.repetitions, [&]()
+	{
+		const Clock::time_point start = Clock::now();
+		for (unsigned frame = 0; frame < params.frames && created; frame++)
+		{
+			unsigned setCount = 0;
+			while (setCount < sets.size() && gTaskMgrSS.CreateTaskSet(Work, pvWork, params.tasksPerSet, NULL, 0,
+				"Contention", &sets[setCount], CoreTypes::ANY))
+			{
+				setCount++;
+			}
+			created = setCount == sets.size();
+
+			for (unsigned set = 0; set < setCount; set++) gTaskMgrSS.WaitForSet(sets[set]);
+			gTaskMgrSS.ReleaseHandles(sets.data(), setCount);
+		}
+		return NanosecondsSince(start) / TasksPerRun(params);
+	});
+
+	gTaskMgrSS.Shutdown();
+	if (!created)
+	{
+		printf("CreateTaskSet failed\n");
+		return false;
+	}
+	return CheckTasksRun("TaskMgrSS", params);
+}
+
+int main(int argc, char* argv[])
+{
+	BENCHMARK_PARAMETERS params;
+	if (argc > 1) params.frames = (unsigned)atoi(argv[1]);
+	if (argc > 2) params.setsPerFrame = (unsigned)atoi(argv[2]);
+	if (argc > 3) params.tasksPerSet = (unsigned)atoi(argv[3]);
+	if (argc > 4) params.workPerTask = (unsigned)atoi(argv[4]);
+	if (argc > 5) params.repetitions = (unsigned)atoi(argv[5]);
+	if (params.frames == 0 || params.setsPerFrame == 0 || params.setsPerFrame > MAX_TASKSETS / 2 ||
+		params.tasksPerSet == 0 || params.tasksPerSet > MAX_TASKSETSIZE || params.repetitions == 0)
+	{
+		printf("usage: %s [frames] [tasksets per frame (up to %d)] [tasks per taskset] [work per task] [repetitions]\n",
+			argv[0], MAX_TASKSETS / 2);
+		return 1;
+	}
+
+	const unsigned threadCounts[] = { 8, 16, 32, 64 };
+	double results[4][2] = {};
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (!RunRingScan(threadCounts[i], params, results[i][0]) ||
+			!RunTaskMgrSS(threadCounts[i], params, results[i][1]))
+		{
+			return 1;
+		}
+	}
+
+	printf("\n%u frames of %u tasksets of %u tasks, median of %u runs after a warm-up, %u logical processors\n",
+		params.frames, params.setsPerFrame, params.tasksPerSet, params.repetitions, std::thread::hardware_concurrency());
+	printf("threads   ring scan ns/task   TaskMgrSS ns/task   speedup\n");
+	for (unsigned i = 0; i < 4; i++)
+	{
+		printf("%7u   %17.1f   %17.1f   %6.2fx\n", threadCounts[i], results[i][0], results[i][1],
+			results[i][0] / results[i][1]);
+	}
+	return 0;
+}
@@ -0,0 +1,43 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Timing helpers shared by the benchmarks: each measurement is repeated after a warm-up, the median is reported.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double NanosecondsSince(Clock::time_point start)
+{
+	return (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+}
+
+// Median of measure() over repetitions runs, after one run discarded as a warm-up
+template<typename F>
+static double MedianOf(unsigned repetitions, F measure)
+{
+	measure();
+
+	std::vector<double> results;
+	for (unsigned repetition = 0; repetition < repetitions; repetition++) results.push_back(measure());
+
+	std::sort(results.begin(), results.end());
+	const size_t middle = results.size() / 2;
+	return results.size() % 2 ? results[middle] : (results[middle - 1] + results[middle]) / 2;
+}
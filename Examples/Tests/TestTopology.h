@@ -0,0 +1,56 @@
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+// Copyright (c) 2021-2024, Intel Corporation
+// Permission is hereby granted, free of charge, to any person obtaining a   copy of this software and associated
+// documentation files (the "Software"), to deal in the Software without restriction, including without limitation
+// the rights to use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of the Software, and to
+// permit persons to whom the Software is    furnished to do so, subject to the following conditions:
+// The above copyright notice and this permission notice shall be included in all copies or substantial portions of
+// the Software.
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT NOT LIMITED TO
+// THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A    PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT,
+// TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+
+// Synthetic topologies (InjectTopology) shared by the tests & benchmarks, so they behave the same on any machine.
+// Both exit on an invalid description.
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "HybridDetect.h"
+
+// Topology mapped onto the host's logical processors (round robin), with no CPU quota: threads pinned to it (RunOn,
+// the TaskMgrSS pools) land on real CPUs, and every pool gets workers even on a host with a single logical processor.
+inline void MakeHostTopology(HybridDetect::PROCESSOR_INFO& procInfo, const char* description)
+{
+	HybridDetect::GetProcessorInfo(procInfo);
+	if (!HybridDetect::InjectTopology(procInfo, description))
+	{
+		printf("invalid topology %s\n", description);
+		exit(1);
+	}
+	procInfo.cpuQuota = 0.0;
+}
+
+// Topology with one processor mask bit per logical processor, every one allowed & no CPU quota, so nothing of the
+// host (affinity, cgroup, ISA) leaks into the results. For queries only, its processors don't exist.
+inline void MakeSyntheticTopology(HybridDetect::PROCESSOR_INFO& procInfo, const char* description)
+{
+	procInfo = HybridDetect::PROCESSOR_INFO();
+	if (!HybridDetect::InjectTopology(procInfo, description))
+	{
+		printf("invalid topology %s\n", description);
+		exit(1);
+	}
+
+	for (unsigned cpu = 0; cpu < procInfo.cores.size(); cpu++)
+	{
+		procInfo.cores[cpu].processorMask = HybridDetect::IndexToProcessorMask(cpu);
+		procInfo.cores[cpu].id = cpu;
+	}
+	procInfo.allowedMask = HybridDetect::ProcessorMask();
+	procInfo.cpuQuota = 0.0;
+}
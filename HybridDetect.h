@@ -24,6 +24,19 @@
 #include <map>
 #include <thread>
 #include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <math.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
 
 #ifndef HYBRIDDETECT_DEBUG_REQUIRE
     #include <assert.h>
@@ -47,6 +60,9 @@
             #define HYBRIDDETECT_CPU_X86_64 0
         #endif
     #else
+        #if __linux__
+            #define HYBRIDDETECT_OS_LINUX 1
+        #endif
         #if __x86_64__
             #define HYBRIDDETECT_CPU_X86_64 1
         #else
@@ -79,8 +95,32 @@ typedef unsigned long ULONG;
 typedef unsigned long long ULONG64;
 typedef size_t SIZE_T;
 typedef unsigned char BYTE;
+
+// Mirrors PROCESSOR_CACHE_TYPE from winnt.h so CACHE_INFO::type has the same meaning on every OS
+typedef enum _PROCESSOR_CACHE_TYPE {
+	CacheUnified,
+	CacheInstruction,
+	CacheData,
+	CacheTrace
+} PROCESSOR_CACHE_TYPE;
+
+#ifdef HYBRIDDETECT_OS_LINUX
+#include <sched.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <set>
+
+// Threads are identified by pthread_t on Linux: pthread_self() or std::thread::native_handle()
+typedef pthread_t HANDLE;
+#else
 typedef void* HANDLE;
 #endif
+#endif
 
 #ifndef HYBRID_DETECT_TRACE_ENABLED_VOLUME
 #define HYBRID_DETECT_TRACE_ENABLED_VOLUME 0 // Scale of 1-10, 10 being most verbose
@@ -159,13 +199,20 @@ inline std::uint64_t xgetbv_asm(int xcrReg)
 // Enables CPU-Sets and Disables ThreadAffinityMasks
 #define ENABLE_CPU_SETS
 
+// Thread priority, memory priority & power throttling hints are only available on Windows
+#ifndef HYBRIDDETECT_OS_WIN
+#undef ENABLE_RUNON_PRIORITY
+#undef ENABLE_RUNON_MEMORY_PRIORITY
+#undef ENABLE_RUNON_EXECUTION_SPEED
+#endif
+
 // No current CPUs have ISA support that varies between cores
 #ifndef ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
 #define ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION 1 // Default to enabled for backward compatibility
 #endif
 
-// Simple conversion from an ordinal, n, to a set bit at position n
-#define IndexToMask(n)  (1UL << n)
+// Simple conversion from an ordinal, n, to a set bit at position n of a 64-bit (group relative) mask
+#define IndexToMask(n)  (1ULL << (n))
 
 // Macros to store values for CPUID register ordinals
 #define CPUID_EAX								0
@@ -188,6 +235,7 @@ inline std::uint64_t xgetbv_asm(int xcrReg)
 #define LEAF_EXTENDED_INFORMATION_6				0x80000006  // Extended Function CPUID Information
 #define LEAF_EXTENDED_INFORMATION_7				0x80000007  // Extended Function CPUID Information
 #define LEAF_EXTENDED_INFORMATION_8				0x80000008  // Extended Function CPUID Information
+#define LEAF_EXTENDED_CPU_TOPOLOGY				0x80000026  // AMD Extended CPU Topology (Output depends on ECX input value)
 
 enum CoreTypes
 {
@@ -204,11 +252,137 @@ enum CoreTypes
 #endif
 };
 
+// Dynamically sized logical processor mask, no upper limit on the number of logical processors.
+// Bit n represents logical processor n: the OS CPU number on Linux, the group offset plus the
+// group relative processor index on Windows (see GetProcessorNumber).
+class ProcessorMask
+{
+public:
+	ProcessorMask() {}
+
+	// 64-bit masks are treated as the first 64 logical processors (group 0 on Windows).
+	ProcessorMask(ULONG64 mask)
+	{
+		if (mask) words.push_back(mask);
+	}
+
+	void Set(unsigned index)
+	{
+		if (index / 64 >= words.size()) words.resize(index / 64 + 1, 0);
+		words[index / 64] |= IndexToMask(index % 64);
+	}
+
+	void Reset(unsigned index)
+	{
+		if (index / 64 < words.size()) words[index / 64] &= ~IndexToMask(index % 64);
+		Trim();
+	}
+
+	bool Test(unsigned index) const
+	{
+		return index / 64 < words.size() && (words[index / 64] & IndexToMask(index % 64)) != 0;
+	}
+
+	size_t Count() const
+	{
+		size_t count = 0;
+		for (ULONG64 word : words) count += std::bitset<64>(word).count();
+		return count;
+	}
+
+	bool Any() const { return !words.empty(); }
+	bool None() const { return words.empty(); }
+
+	// Same as (*this & other).Any() without building the intersection.
+	bool Intersects(const ProcessorMask& other) const
+	{
+		const size_t count = words.size() < other.words.size() ? words.size() : other.words.size();
+		for (size_t i = 0; i < count; i++)
+		{
+			if (words[i] & other.words[i]) return true;
+		}
+		return false;
+	}
+
+	// Number of 64-bit words backing the mask, the highest set bit is below WordCount() * 64.
+	unsigned WordCount() const { return (unsigned)words.size(); }
+	ULONG64 Word(unsigned index) const { return index < words.size() ? words[index] : 0; }
+
+	// Index of the first set bit at or after 'from', -1 if there is none.
+	int Next(unsigned from = 0) const
+	{
+		for (unsigned word = from / 64; word < words.size(); word++)
+		{
+			ULONG64 bits = words[word];
+			if (word == from / 64) bits &= ~0ULL << (from % 64);
+
+			for (unsigned bit = 0; bits && bit < 64; bit++)
+			{
+				if (bits & IndexToMask(bit)) return (int)(word * 64 + bit);
+			}
+		}
+		return -1;
+	}
+
+	template<typename F>
+	void ForEach(F f) const
+	{
+		for (int index = Next(); index >= 0; index = Next(index + 1)) f((unsigned)index);
+	}
+
+	ProcessorMask& operator|=(const ProcessorMask& other)
+	{
+		if (other.words.size() > words.size()) words.resize(other.words.size(), 0);
+		for (size_t i = 0; i < other.words.size(); i++) words[i] |= other.words[i];
+		return *this;
+	}
+
+	ProcessorMask& operator&=(const ProcessorMask& other)
+	{
+		if (words.size() > other.words.size()) words.resize(other.words.size());
+		for (size_t i = 0; i < words.size(); i++) words[i] &= other.words[i];
+		Trim();
+		return *this;
+	}
+
+	ProcessorMask operator|(const ProcessorMask& other) const { ProcessorMask mask = *this; return mask |= other; }
+	ProcessorMask operator&(const ProcessorMask& other) const { ProcessorMask mask = *this; return mask &= other; }
+	bool operator==(const ProcessorMask& other) const { return words == other.words; }
+	bool operator!=(const ProcessorMask& other) const { return words != other.words; }
+
+	// Binary string, most significant bit first, padded to a multiple of 64 bits like std::bitset<64>::to_string.
+	std::string ToString() const
+	{
+		std::string str;
+		for (unsigned word = (WordCount() > 0 ? WordCount() : 1); word-- > 0; )
+		{
+			str += std::bitset<64>(Word(word)).to_string();
+		}
+		return str;
+	}
+
+private:
+	// Keep the representation canonical (no trailing zero words) so == and Any() are cheap.
+	void Trim()
+	{
+		while (!words.empty() && words.back() == 0) words.pop_back();
+	}
+
+	std::vector<ULONG64> words;
+};
+
+inline ProcessorMask IndexToProcessorMask(unsigned index)
+{
+	ProcessorMask mask;
+	mask.Set(index);
+	return mask;
+}
+
 // Struct to store information for each Cache.
 typedef struct _CACHE_INFO
 {
 	unsigned                            group = 0;
-	std::bitset<64>						processorMask = 0;
+	ProcessorMask						processorMask;
 	unsigned							level = 0;
 	unsigned							size = 0;
 	unsigned							lineSize = 0;
@@ -216,6 +390,18 @@ typedef struct _CACHE_INFO
 	unsigned							associativity = 0;
 } CACHE_INFO, * PCACHE_INFO;
 
+// Logical processors sharing one L2, e.g. a quad of E-Cores or the hyper-threads of a P-Core.
+// Keeping producer/consumer tasks within a module keeps their data in its L2.
+typedef struct _MODULE_INFO
+{
+	unsigned							cacheIndex = 0;		// The shared L2 in procInfo.caches
+	CoreTypes							coreType = CoreTypes::NONE;
+	ProcessorMask						processorMask;
+#ifdef ENABLE_CPU_SETS
+	std::vector<ULONG>					cpuSets;			// CPU Set IDs (Windows) / OS CPU numbers (Linux)
+#endif
+} MODULE_INFO, * PMODULE_INFO;
+
 // Struct to store Power information for a logical processor.
 typedef struct _LOGICAL_PROCESSOR_POWER_INFORMATION {
 	ULONG								number = 0;
@@ -234,7 +420,7 @@ typedef struct _LOGICAL_PROCESSOR_INFO
 	unsigned							node = 0;
 	unsigned							coreIndex = 0;
 	unsigned							logicalProcessorIndex = 0;
-	std::bitset<64>						processorMask = 0;
+	ProcessorMask						processorMask;
 	unsigned							baseFrequency = 0;
 	unsigned							currentFrequency = 0;
 	unsigned							maximumFrequency = 0;
@@ -267,11 +453,23 @@ typedef struct _LOGICAL_PROCESSOR_INFO
 	unsigned							allocated : 1;
 	unsigned							allocatedToTargetProcess : 1;
 	unsigned							realTime : 1;
+	unsigned							probed : 1;			// CPUID leaves read on this logical processor, see ProbeLogicalProcessors
 	ULONG64								allocationTag = 0;
 	unsigned							efficiencyClass = 0;
 	unsigned							schedulingClass = 0;
 	CoreTypes							coreType = CoreTypes::NONE;
 	LOGICAL_PROCESSOR_POWER_INFORMATION powerInformation;
+
+	// Bit-fields take no default member initializers before C++20
+	_LOGICAL_PROCESSOR_INFO()
+	{
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+		SSE = AVX = AVX2 = AVX512 = AVX512F = AVX512DQ = AVX512PF = AVX512ER = AVX512CD = AVX512BW = AVX512VL = 0;
+		AVX512_IFMA = AVX512_VBMI = AVX512_VBMI2 = AVX512_VNNI = AVX512_BITALG = AVX512_VPOPCNTDQ = 0;
+		AVX512_4VNNIW = AVX512_4FMAPS = AVX512_VP2INTERSECT = SGX = SHA = 0;
+#endif
+		parked = allocated = allocatedToTargetProcess = realTime = probed = 0;
+	}
 } LOGICAL_PROCESSOR_INFO, * PLOGICAL_PROCESSOR_INFO;
 
 typedef struct _GROUP_INFO
@@ -287,7 +485,7 @@ typedef struct _NUMA_NODE_INFO
 {
 	unsigned							nodeNumber = 0;
 	unsigned							group = 0;
-	ULONG64								mask = 0;
+	ProcessorMask						mask;
 }	NUMA_NODE_INFO, * PNUMA_NODE_INFO;
 
 // Feature flags
@@ -346,6 +544,22 @@ struct FeatureFlags
 
 };
 
+// Kernels run by CalibrateCoreTypes, one per instruction mix.
+enum CalibrationKernel
+{
+	CALIBRATION_SCALAR_INT,			// Dependent integer multiply/shift/xor chains
+	CALIBRATION_SIMD_FP32,			// FP32 multiply-add over an L1 resident array
+	CALIBRATION_MEMORY,				// Streaming reads from a buffer larger than the caches
+	CALIBRATION_KERNEL_COUNT
+};
+
+// Measured single thread throughput of one core type, work items per microsecond for each CalibrationKernel.
+typedef struct _CORE_TYPE_SCORE
+{
+	CoreTypes							coreType = CoreTypes::NONE;
+	double								score[CALIBRATION_KERNEL_COUNT] = {};
+} CORE_TYPE_SCORE, * PCORE_TYPE_SCORE;
+
 // Struct to store Processor information
 typedef struct _PROCESSOR_INFO
 {
@@ -367,9 +581,12 @@ typedef struct _PROCESSOR_INFO
 	std::vector<CACHE_INFO>				caches;
 	std::vector<LOGICAL_PROCESSOR_INFO>	cores;
 
+	// One module per L2 data/unified cache, derived from caches & cores by UpdateModules.
+	std::vector<MODULE_INFO>			modules;
+
 	// Store map of logical processors returned from GLPI. 
-	// short = Core Type, ULONG64 = 64-bit processor mask 
-	std::map<short, ULONG64>			coreMasks;
+	// short = Core Type, ProcessorMask = mask of every logical processor of that type
+	std::map<short, ProcessorMask>		coreMasks;
 #ifdef ENABLE_CPU_SETS
 
 	// Store map of logical processors returned from GetSystemCPUSetInformation. 
@@ -378,6 +595,15 @@ typedef struct _PROCESSOR_INFO
 	std::map<unsigned, std::vector<ULONG>>	cpuSets;
 
 #endif
+
+	// Logical processors this process may run on: process/group affinity on Windows, sched_getaffinity and the
+	// cgroup cpuset on Linux. Empty when unknown. Process specific, refreshed by UpdateAllowedProcessors.
+	ProcessorMask						allowedMask;
+
+	// CPU time this process may use, in logical processors (cgroup cpu.max/CFS quota on Linux, job object
+	// hard cap on Windows), e.g. 1.5 for "150000 100000". 0 when unlimited.
+	double								cpuQuota = 0.0;
+
 	bool IsIntel()    const { return !strcmp("GenuineIntel", vendorID); }
 	bool IsAMD()      const { return !strcmp("AuthenticAMD", vendorID); }
 
@@ -386,12 +612,51 @@ typedef struct _PROCESSOR_INFO
 #ifdef ENABLE_CPU_SETS
 		return (int)cpuSets[(ULONG)coreType].size();
 #else
-		std::bitset<64> bits = coreMasks[coreType];
-
-		return (int)bits.count();
+		return (int)coreMasks[coreType].Count();
 #endif
 	}
 
+	// Logical processors of coreType (ANY for all) this process may run on.
+	inline int GetAllowedCoreTypeCount(CoreTypes coreType) const
+	{
+		int count = 0;
+
+		for (const LOGICAL_PROCESSOR_INFO& logicalCore : cores)
+		{
+			if (coreType != CoreTypes::ANY && logicalCore.coreType != coreType) continue;
+			if (allowedMask.Any() && !logicalCore.processorMask.Intersects(allowedMask)) continue;
+			count++;
+		}
+		return count;
+	}
+
+	// Threads of coreType (ANY for all) that can make progress at the same time: the allowed logical processors,
+	// limited by the CPU quota (rounded up). Use to size thread pools instead of numLogicalCores.
+	inline int GetEffectiveCoreTypeCount(CoreTypes coreType) const
+	{
+		const int count = GetAllowedCoreTypeCount(coreType);
+
+		if (cpuQuota > 0.0)
+		{
+			const int quota = static_cast<int>(ceil(cpuQuota));
+			return quota < count ? quota : count;
+		}
+		return count;
+	}
+
+	// Per core type scores measured by CalibrateCoreTypes, empty until calibrated. Persisted in snapshots.
+	std::vector<CORE_TYPE_SCORE>		scores;
+
+	// Score of coreType for a kernel, 0 when not calibrated. Ratios between core types give their relative speed.
+	inline double GetCoreTypeScore(CoreTypes coreType, CalibrationKernel kernel) const
+	{
+		for (const CORE_TYPE_SCORE& score : scores)
+		{
+			if (score.coreType == coreType) return score.score[kernel];
+		}
+		return 0.0;
+	}
+
 	unsigned cpuid_1_eax = 0; // Basic CPU family/model/stepping
 
 	union
@@ -402,6 +667,37 @@ typedef struct _PROCESSOR_INFO
 
 } PROCESSOR_INFO, * PPROCESSOR_INFO;
 
+// Offset of the first logical processor of a processor group in the ProcessorMask numbering.
+inline unsigned GetGroupOffset(const PROCESSOR_INFO& procInfo, unsigned group)
+{
+	unsigned offset = 0;
+
+	for (unsigned i = 0; i < group && i < procInfo.groups.size(); i++)
+	{
+		offset += procInfo.groups[i].activeProcessorCount;
+	}
+	return offset;
+}
+
+// ProcessorMask bit index (system wide logical processor number) of a logical processor.
+inline unsigned GetProcessorNumber(const PROCESSOR_INFO& procInfo, const LOGICAL_PROCESSOR_INFO& logicalCore)
+{
+	return GetGroupOffset(procInfo, logicalCore.group) + logicalCore.logicalProcessorIndex;
+}
+
+// Converts a group relative 64-bit mask (KAFFINITY) into a system wide ProcessorMask.
+inline ProcessorMask GroupMaskToProcessorMask(const PROCESSOR_INFO& procInfo, unsigned group, ULONG64 groupMask)
+{
+	ProcessorMask mask;
+	const unsigned offset = GetGroupOffset(procInfo, group);
+
+	for (unsigned bit = 0; bit < 64; bit++)
+	{
+		if (groupMask & IndexToMask(bit)) mask.Set(offset + bit);
+	}
+	return mask;
+}
+
 // Type to String Conversion Helper Function
 inline const char* CoreTypeString(CoreTypes type)
 {
@@ -429,7 +725,6 @@ inline const char* CoreTypeString(CoreTypes type)
 	}
 }
 
-#ifdef HYBRIDDETECT_OS_WIN
 // Cache to String Conversion Helper Function
 inline const char* CacheTypeString(int type)
 {
@@ -446,7 +741,6 @@ inline const char* CacheTypeString(int type)
 	}
 	return "Any";
 }
-#endif
 
 // Helper function to Call the CPUID intrinsic
 inline bool CallCPUID(unsigned function, std::array<unsigned, 4>& registers, unsigned extFunction = 0, unsigned CPUIDFunctionMax = LEAF_EXTENDED_INFORMATION_8)
@@ -675,6 +969,102 @@ inline bool GetLogicalProcessors(PROCESSOR_INFO& procInfo)
 }
 #endif // HYBRIDDETECT_OS_WIN
 
+#ifdef HYBRIDDETECT_OS_LINUX
+// Reads the first line of a sysfs/procfs file, without the trailing newline.
+inline bool ReadSysfsString(const std::string& path, std::string& value)
+{
+	FILE* file = fopen(path.c_str(), "r");
+	if (!file) return false;
+
+	char buffer[4096];
+	bool succeeded = fgets(buffer, sizeof(buffer), file) != nullptr;
+	fclose(file);
+
+	if (!succeeded) return false;
+
+	value = buffer;
+	while (!value.empty() && (value.back() == '\n' || value.back() == '\r' || value.back() == ' '))
+	{
+		value.pop_back();
+	}
+	return true;
+}
+
+inline bool ReadSysfsUnsigned(const std::string& path, unsigned& value)
+{
+	std::string str;
+	if (!ReadSysfsString(path, str) || str.empty()) return false;
+
+	value = (unsigned)strtoul(str.c_str(), nullptr, 10);
+	return true;
+}
+
+// Parses a kernel cpulist, e.g. "0-3,8,10-11", into an ascending list of CPU numbers.
+inline bool ParseCPUList(const std::string& list, std::vector<unsigned>& cpus)
+{
+	const char* p = list.c_str();
+
+	while (*p)
+	{
+		char* end;
+		unsigned first = (unsigned)strtoul(p, &end, 10);
+		if (end == p) return false;
+
+		unsigned last = first;
+		p = end;
+
+		if (*p == '-')
+		{
+			++p;
+			last = (unsigned)strtoul(p, &end, 10);
+			if (end == p) return false;
+			p = end;
+		}
+
+		for (unsigned cpu = first; cpu <= last; cpu++)
+		{
+			cpus.push_back(cpu);
+		}
+
+		if (*p == ',') ++p;
+	}
+
+	return true;
+}
+
+inline bool ReadSysfsCPUList(const std::string& path, std::vector<unsigned>& cpus)
+{
+	std::string list;
+	return ReadSysfsString(path, list) && ParseCPUList(list, cpus);
+}
+
+// Converts a sysfs cache size, e.g. "48K" or "30M", into bytes.
+inline unsigned ParseSysfsSize(const std::string& str)
+{
+	char* end;
+	unsigned size = (unsigned)strtoul(str.c_str(), &end, 10);
+
+	switch (*end)
+	{
+	case 'K': return size * 1024;
+	case 'M': return size * 1024 * 1024;
+	case 'G': return size * 1024 * 1024 * 1024;
+	}
+	return size;
+}
+
+inline ProcessorMask CPUListToMask(const std::vector<unsigned>& cpus)
+{
+	ProcessorMask mask;
+
+	for (unsigned cpu : cpus)
+	{
+		mask.Set(cpu);
+	}
+	return mask;
+}
+#endif // HYBRIDDETECT_OS_LINUX
+
 // Calls CPUID & GetLogicalProcessors to fill in PROCESSOR_INFO Caches & Cores
 inline bool GetLogicalProcessorsEx(PROCESSOR_INFO& procInfo)
 {
@@ -689,7 +1079,7 @@ inline bool GetLogicalProcessorsEx(PROCESSOR_INFO& procInfo)
 		group.maximumGroupCount = pinfo->Group.MaximumGroupCount;
 		group.activeProcessorCount = pinfo->Group.GroupInfo->ActiveProcessorCount;
 		group.maximumProcessorCount = pinfo->Group.GroupInfo->MaximumProcessorCount;
-		group.activeProcessorMask = (ULONG)pinfo->Group.GroupInfo->ActiveProcessorMask;
+		group.activeProcessorMask = (ULONG64)pinfo->Group.GroupInfo->ActiveProcessorMask;
 		HYBRID_DETECT_TRACE(5, "=== group %d: ActiveProcessorCount = %d, MaximumProcessorCount = %d", procInfo.numGroups - 1, pinfo->Group.GroupInfo->ActiveProcessorCount, pinfo->Group.GroupInfo->MaximumProcessorCount);
 		procInfo.groups.push_back(group);
 	}
@@ -700,7 +1090,7 @@ inline bool GetLogicalProcessorsEx(PROCESSOR_INFO& procInfo)
 		procInfo.numNUMANodes++;
 		node.nodeNumber = pinfo->NumaNode.NodeNumber;
 		node.group = pinfo->NumaNode.GroupMask.Group;
-		node.mask = (ULONG)pinfo->NumaNode.GroupMask.Mask;
+		node.mask = GroupMaskToProcessorMask(procInfo, node.group, pinfo->NumaNode.GroupMask.Mask);
 		procInfo.nodes.push_back(node);
 	}
 
@@ -725,7 +1115,7 @@ inline bool GetLogicalProcessorsEx(PROCESSOR_INFO& procInfo)
 		}
 
 		cacheInfo.group = pinfo->Cache.GroupMask.Group;
-		cacheInfo.processorMask = pinfo->Cache.GroupMask.Mask;
+		cacheInfo.processorMask = GroupMaskToProcessorMask(procInfo, cacheInfo.group, pinfo->Cache.GroupMask.Mask);
 		cacheInfo.level = pinfo->Cache.Level;
 		cacheInfo.size = pinfo->Cache.CacheSize;
 		cacheInfo.lineSize = pinfo->Cache.LineSize;
@@ -780,6 +1170,158 @@ inline bool GetLogicalProcessorsEx(PROCESSOR_INFO& procInfo)
         sysctlbyname("hw.cachesize", tempStr.data(), &len, NULL, 0);
     }
 #endif
+	return true;
+#elif defined(HYBRIDDETECT_OS_LINUX)
+	// Based On: https://www.kernel.org/doc/Documentation/ABI/stable/sysfs-devices-system-cpu
+	const std::string cpuRoot = "/sys/devices/system/cpu/";
+	const std::string nodeRoot = "/sys/devices/system/node/";
+
+	std::vector<unsigned> online;
+	if (!ReadSysfsCPUList(cpuRoot + "online", online) || online.empty())
+	{
+		return false;
+	}
+
+	// NUMA nodes, non-NUMA kernels do not expose the node directory so fall back to a single node.
+	std::map<unsigned, unsigned> cpuToNode;
+	if (DIR* dir = opendir(nodeRoot.c_str()))
+	{
+		while (dirent* entry = readdir(dir))
+		{
+			unsigned nodeNumber;
+			if (sscanf(entry->d_name, "node%u", &nodeNumber) != 1) continue;
+
+			std::vector<unsigned> nodeCPUs;
+			if (!ReadSysfsCPUList(nodeRoot + entry->d_name + "/cpulist", nodeCPUs) || nodeCPUs.empty()) continue;
+
+			NUMA_NODE_INFO node;
+			node.nodeNumber = nodeNumber;
+			node.mask = CPUListToMask(nodeCPUs);
+			procInfo.nodes.push_back(node);
+			procInfo.numNUMANodes++;
+
+			for (unsigned cpu : nodeCPUs)
+			{
+				cpuToNode[cpu] = nodeNumber;
+			}
+		}
+		closedir(dir);
+	}
+
+	if (procInfo.nodes.empty())
+	{
+		NUMA_NODE_INFO node;
+		node.mask = CPUListToMask(online);
+		procInfo.nodes.push_back(node);
+		procInfo.numNUMANodes++;
+	}
+
+	// Hybrid parts register one perf PMU per core type, e.g. /sys/devices/cpu_core & /sys/devices/cpu_atom
+	std::vector<unsigned> coreCPUs;
+	std::vector<unsigned> atomCPUs;
+	ReadSysfsCPUList("/sys/devices/cpu_core/cpus", coreCPUs);
+	ReadSysfsCPUList("/sys/devices/cpu_atom/cpus", atomCPUs);
+
+	std::set<std::pair<unsigned, unsigned>> physicalCores;
+	std::set<unsigned> packages;
+	std::set<std::string> caches;
+
+	for (unsigned cpu : online)
+	{
+		const std::string cpuPath = cpuRoot + "cpu" + std::to_string(cpu) + "/";
+
+		LOGICAL_PROCESSOR_INFO core;
+		core.id = cpu;
+		core.logicalProcessorIndex = cpu;
+		core.node = cpuToNode.count(cpu) ? cpuToNode[cpu] : 0;
+		core.processorMask = IndexToProcessorMask(cpu);
+
+		unsigned packageID = 0;
+		unsigned coreID = cpu;
+		ReadSysfsUnsigned(cpuPath + "topology/physical_package_id", packageID);
+		ReadSysfsUnsigned(cpuPath + "topology/core_id", coreID);
+		packages.insert(packageID);
+		physicalCores.insert(std::make_pair(packageID, coreID));
+
+		// Windows reports the first logical processor of the physical core as its CoreIndex.
+		std::vector<unsigned> siblings;
+		core.coreIndex = (ReadSysfsCPUList(cpuPath + "topology/thread_siblings_list", siblings) && !siblings.empty()) ? siblings[0] : cpu;
+
+		// cpufreq reports kHz, PROCESSOR_INFO stores MHz.
+		unsigned frequency;
+		if (ReadSysfsUnsigned(cpuPath + "cpufreq/base_frequency", frequency)) core.baseFrequency = frequency / 1000;
+		if (ReadSysfsUnsigned(cpuPath + "cpufreq/cpuinfo_max_freq", frequency)) core.maximumFrequency = frequency / 1000;
+		if (ReadSysfsUnsigned(cpuPath + "cpufreq/scaling_cur_freq", frequency)) core.currentFrequency = frequency / 1000;
+		core.powerInformation.number = cpu;
+		core.powerInformation.maxMhz = core.maximumFrequency;
+		core.powerInformation.currentMhz = core.currentFrequency;
+
+		if (std::find(coreCPUs.begin(), coreCPUs.end(), cpu) != coreCPUs.end())
+		{
+			core.coreType = CoreTypes::INTEL_CORE;
+			core.efficiencyClass = 1;
+		}
+		else if (std::find(atomCPUs.begin(), atomCPUs.end(), cpu) != atomCPUs.end())
+		{
+			core.coreType = CoreTypes::INTEL_ATOM;
+			core.efficiencyClass = 0;
+		}
+
+		procInfo.cores.push_back(core);
+		procInfo.numLogicalCores++;
+
+		// Every logical processor lists the caches it can see, shared caches are only recorded once.
+		for (unsigned index = 0; ; index++)
+		{
+			const std::string cachePath = cpuPath + "cache/index" + std::to_string(index) + "/";
+
+			CACHE_INFO cacheInfo;
+			std::string type;
+			std::string size;
+			std::string sharedList;
+			if (!ReadSysfsUnsigned(cachePath + "level", cacheInfo.level)) break;
+			ReadSysfsString(cachePath + "type", type);
+			ReadSysfsString(cachePath + "shared_cpu_list", sharedList);
+
+			if (!caches.insert(std::to_string(cacheInfo.level) + type + sharedList).second) continue;
+
+			if (ReadSysfsString(cachePath + "size", size)) cacheInfo.size = ParseSysfsSize(size);
+			ReadSysfsUnsigned(cachePath + "coherency_line_size", cacheInfo.lineSize);
+			ReadSysfsUnsigned(cachePath + "ways_of_associativity", cacheInfo.associativity);
+
+			if (type == "Data") cacheInfo.type = CacheData;
+			else if (type == "Instruction") cacheInfo.type = CacheInstruction;
+			else cacheInfo.type = CacheUnified;
+
+			std::vector<unsigned> sharedCPUs;
+			ParseCPUList(sharedList, sharedCPUs);
+			cacheInfo.processorMask = CPUListToMask(sharedCPUs);
+
+			switch (cacheInfo.level) {
+			case 1: procInfo.numL1Caches++; break;
+			case 2: procInfo.numL2Caches++; break;
+			case 3: procInfo.numL3Caches++; break;
+			}
+
+			procInfo.caches.push_back(cacheInfo);
+		}
+	}
+
+	procInfo.numPhysicalCores = (unsigned)physicalCores.size();
+	procInfo.numProcessorPackages = (unsigned)packages.size();
+
+	// Linux has no processor groups, report all online processors as a single group.
+	GROUP_INFO group;
+	group.activeGroupCount = 1;
+	group.maximumGroupCount = 1;
+	group.activeProcessorCount = procInfo.numLogicalCores;
+	group.maximumProcessorCount = procInfo.numLogicalCores;
+	group.activeProcessorMask = CPUListToMask(online).Word(0);
+	procInfo.groups.push_back(group);
+	procInfo.numGroups = 1;
+
+	HYBRID_DETECT_TRACE(7, "<<<");
+
 	return true;
 #else
 	return false;
@@ -801,345 +1343,2948 @@ inline void UpdateProcessorInfo(PROCESSOR_INFO& procInfo)
 		procInfo.cores[i].currentFrequency = pwrInfo[i].currentMhz;
 		procInfo.cores[i].powerInformation = pwrInfo[i];
 	}
+#elif defined(HYBRIDDETECT_OS_LINUX)
+	for (LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		unsigned khz = 0;
+
+		if (ReadSysfsUnsigned("/sys/devices/system/cpu/cpu" + std::to_string(logicalCore.logicalProcessorIndex) + "/cpufreq/scaling_cur_freq", khz))
+		{
+			logicalCore.currentFrequency = khz / 1000;
+			logicalCore.powerInformation.currentMhz = khz / 1000;
+		}
+	}
 #endif
 }
 
-// Calls CPUID & GetLogicalProcessors & CallNTPowerInformation to fill in PROCESSOR_INFO
-inline void GetProcessorInfo(PROCESSOR_INFO& procInfo)
+#ifdef HYBRIDDETECT_OS_LINUX
+// Path of the calling process in a cgroup hierarchy, from /proc/self/cgroup: the v2 unified hierarchy ("0::/path")
+// when controller is empty, otherwise the v1 hierarchy listing controller ("4:cpu,cpuacct:/path").
+inline bool GetCgroupPath(const char* controller, std::string& path)
 {
-	HYBRID_DETECT_TRACE(7, ">>>");
-#ifdef ENABLE_HYBRID_DETECT
-	// https://software.intel.com/content/www/us/en/develop/download/intel-architecture-instruction-set-extensions-programming-reference.html
+	FILE* file = fopen("/proc/self/cgroup", "r");
+	if (!file) return false;
 
-		// Store registers from CPUID
-	std::array<unsigned, 4>  cpuInfo{}; // zero-init
+	char line[4096];
+	bool found = false;
 
-	// Maximum leaf ordinal Reported by CPUID
-	unsigned            CPUIDFunctionMax;
+	while (!found && fgets(line, sizeof(line), file))
+	{
+		std::string entry(line);
+		while (!entry.empty() && (entry.back() == '\n' || entry.back() == '\r')) entry.pop_back();
 
-	std::bitset<32>     bits;
+		const size_t first = entry.find(':');
+		const size_t second = first == std::string::npos ? std::string::npos : entry.find(':', first + 1);
+		if (second == std::string::npos) continue;
 
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::ANY, ULONG64(0)));
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::NONE, ULONG64(0)));
-#if HYBRIDDETECT_CPU_X86_64
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::RESERVED0, ULONG64(0)));
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::INTEL_ATOM, ULONG64(0)));
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::RESERVED1, ULONG64(0)));
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::INTEL_CORE, ULONG64(0)));
-#else
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::PERFLEVEL0, ULONG64(0)));
-	procInfo.coreMasks.emplace(std::make_pair<short, ULONG64>(CoreTypes::PERFLEVEL1, ULONG64(0)));
-#endif
+		const std::string controllers = entry.substr(first + 1, second - first - 1);
 
-#ifdef ENABLE_CPU_SETS
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::ANY, std::vector<ULONG>()));
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::NONE, std::vector<ULONG>()));
-#if HYBRIDDETECT_CPU_X86_64
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::RESERVED0, std::vector<ULONG>()));
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::INTEL_ATOM, std::vector<ULONG>()));
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::RESERVED1, std::vector<ULONG>()));
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::INTEL_CORE, std::vector<ULONG>()));
-#else
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::PERFLEVEL0, std::vector<ULONG>()));
-	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::PERFLEVEL1, std::vector<ULONG>()));
-#endif
-#endif
+		if (!*controller)
+		{
+			found = entry.compare(0, first, "0") == 0 && controllers.empty();
+		}
+		else
+		{
+			found = ("," + controllers + ",").find(std::string(",") + controller + ",") != std::string::npos;
+		}
 
-	//Basic CPUID Information
-	CallCPUID(LEAF_CPUID_BASIC, cpuInfo);
+		if (found) path = entry.substr(second + 1);
+	}
+	fclose(file);
+	return found;
+}
 
-	// Store highest function number.
-	CPUIDFunctionMax = cpuInfo[CPUID_EAX];
+// Reads name from the cgroup directory of the process under mount, or from its closest ancestor holding it.
+// Inside a cgroup namespace (containers) the process path is "/" and the files are at the mount point itself.
+inline bool ReadCgroupString(const std::string& mount, std::string path, const char* name, std::string& value)
+{
+	for (;;)
+	{
+		if (ReadSysfsString(mount + path + (path.empty() || path.back() != '/' ? "/" : "") + name, value)) return true;
+		if (path.empty() || path == "/") return false;
 
-#if HYBRIDDETECT_CPU_X86_64
-	// Read Vendor ID from CPUID
-	memcpy(procInfo.vendorID + 0, &cpuInfo[CPUID_EBX], sizeof(cpuInfo[CPUID_EBX]));
-	memcpy(procInfo.vendorID + 4, &cpuInfo[CPUID_EDX], sizeof(cpuInfo[CPUID_EDX]));
-	memcpy(procInfo.vendorID + 8, &cpuInfo[CPUID_ECX], sizeof(cpuInfo[CPUID_ECX]));
-	procInfo.vendorID[12] = '\0';
-#else
-	static const char kVendorApple[] = "Apple";
-	strcpy(procInfo.vendorID, kVendorApple);
-	procInfo.brandString[0] = 0;
-#endif
+		const size_t slash = path.find_last_of('/');
+		path = slash == std::string::npos ? "" : path.substr(0, slash);
+	}
+}
 
-	CallCPUID(1, cpuInfo);
-	procInfo.cpuid_1_eax = cpuInfo[CPUID_EAX];
-	bits = cpuInfo[CPUID_ECX];
-	procInfo.flags.SSE3 = bits[0];
-	procInfo.flags.PCLMULQDQ = bits[1];
-	procInfo.flags.SSSE3 = bits[9];
-	procInfo.flags.FMA = bits[12];
-	procInfo.flags.SSE4_1 = bits[19];
-	procInfo.flags.SSE4_2 = bits[20];
-	procInfo.flags.AES = bits[25];
-	procInfo.flags.XSAVE = bits[26];
-	procInfo.flags.OSXSAVE = bits[27];
-	procInfo.flags.AVX = bits[28];
-	procInfo.flags.F16C = bits[29];
-	procInfo.flags.RDRAND = bits[30];
+// Lowest CPU quota (in logical processors) along the cgroup hierarchy of the process, 0 when unlimited.
+inline double GetCgroupCPUQuota()
+{
+	double quota = 0.0;
+	std::string path;
+	std::string value;
 
-	if (procInfo.flags.OSXSAVE)
+	auto limit = [&quota](double candidate)
 	{
-		uint64_t xcr0 = XGETBV(0);
-		if (xcr0 & 0x6)
+		if (candidate > 0.0 && (quota == 0.0 || candidate < quota)) quota = candidate;
+	};
+
+	// cgroup v2: cpu.max = "$MAX $PERIOD" or "max $PERIOD", every ancestor can limit the process.
+	if (GetCgroupPath("", path))
+	{
+		for (;;)
 		{
-			procInfo.flags.OS_Supports_YMM = 1;
-			if (xcr0 & 0xe0)
+			if (ReadSysfsString("/sys/fs/cgroup" + path + (path.empty() || path.back() != '/' ? "/" : "") + "cpu.max", value))
 			{
-				procInfo.flags.OS_Supports_ZMM = 1;
+				double max = 0.0;
+				double period = 0.0;
+
+				if (sscanf(value.c_str(), "%lf %lf", &max, &period) == 2 && period > 0.0) limit(max / period);
 			}
+			if (path == "/" || path.empty()) break;
+
+			const size_t slash = path.find_last_of('/');
+			path = slash == 0 ? "/" : path.substr(0, slash);
 		}
 	}
 
-	CallCPUID(LEAF_EXTENDED_FEATURE_FLAGS, cpuInfo, 0, CPUIDFunctionMax);
+	// cgroup v1: cpu.cfs_quota_us (-1 = unlimited) / cpu.cfs_period_us
+	if (GetCgroupPath("cpu", path))
 	{
-		bits = cpuInfo[CPUID_EBX];
-		procInfo.flags.AVX2 = bits[5];
-		procInfo.flags.AVX512F = bits[16];
-		procInfo.flags.AVX512DQ = bits[17];
-		procInfo.flags.AVX512_IFMA = bits[21];
-		procInfo.flags.AVX512CD = bits[28];
-		procInfo.flags.AVX512BW = bits[30];
-		procInfo.flags.AVX512VL = bits[31];
+		for (const char* mount : { "/sys/fs/cgroup/cpu,cpuacct", "/sys/fs/cgroup/cpu" })
+		{
+			std::string quotaValue;
+			std::string periodValue;
+
+			if (ReadCgroupString(mount, path, "cpu.cfs_quota_us", quotaValue) &&
+				ReadCgroupString(mount, path, "cpu.cfs_period_us", periodValue))
+			{
+				const double cfsQuota = atof(quotaValue.c_str());
+				const double cfsPeriod = atof(periodValue.c_str());
+
+				if (cfsQuota > 0.0 && cfsPeriod > 0.0) limit(cfsQuota / cfsPeriod);
+				break;
+			}
+		}
 	}
 
-#if HYBRIDDETECT_CPU_X86_64
-	// Read Brand String from Extended CPUID information
-	CallCPUID(LEAF_EXTENDED_BRAND_STRING_1, cpuInfo);
-	memcpy(procInfo.brandString + 00, cpuInfo.data(), sizeof(cpuInfo));
-	CallCPUID(LEAF_EXTENDED_BRAND_STRING_2, cpuInfo);
-	memcpy(procInfo.brandString + 16, cpuInfo.data(), sizeof(cpuInfo));
-	CallCPUID(LEAF_EXTENDED_BRAND_STRING_3, cpuInfo);
-	memcpy(procInfo.brandString + 32, cpuInfo.data(), sizeof(cpuInfo));
-#elif defined(__APPLE__)
+	return quota;
+}
+
+// CPUs of the cgroup cpuset of the process (v2 cpuset.cpus.effective, v1 cpuset.effective_cpus/cpuset.cpus).
+inline bool GetCgroupCPUSet(std::vector<unsigned>& cpus)
+{
+	std::string path;
+	std::string value;
+
+	if (GetCgroupPath("", path) && ReadCgroupString("/sys/fs/cgroup", path, "cpuset.cpus.effective", value) && !value.empty())
 	{
-		size_t len = sizeof(procInfo.brandString);
-		sysctlbyname("machdep.cpu.brand_string", &procInfo.brandString, &len, NULL, 0);
+		return ParseCPUList(value, cpus);
 	}
-#endif
 
-	// Structured Extended Feature Flags Enumeration Leaf 
-	// (Output depends on ECX input value)
-	CallCPUID(LEAF_EXTENDED_FEATURE_FLAGS, cpuInfo);
+	if (GetCgroupPath("cpuset", path) &&
+		(ReadCgroupString("/sys/fs/cgroup/cpuset", path, "cpuset.effective_cpus", value) ||
+		 ReadCgroupString("/sys/fs/cgroup/cpuset", path, "cpuset.cpus", value)) && !value.empty())
 	{
-		bits = cpuInfo[CPUID_EDX];
-#ifndef ENABLE_SOFTWARE_PROXY
-		procInfo.hybrid = bits[15];
-#else
-		procInfo.hybrid = true;
-#endif
+		return ParseCPUList(value, cpus);
 	}
 
-	// Thermal and Power Management Leaf
-	CallCPUID(LEAF_THERMAL_POWER, cpuInfo);
+	return false;
+}
+#endif
+
+// Rebuilds procInfo.coreMasks & procInfo.cpuSets from the coreType of procInfo.cores.
+inline void UpdateCoreTypeSets(PROCESSOR_INFO& procInfo)
+{
+	for (auto& coreMask : procInfo.coreMasks) coreMask.second = ProcessorMask();
+#ifdef ENABLE_CPU_SETS
+	for (auto& cpuSet : procInfo.cpuSets) cpuSet.second.clear();
+#endif
+
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
 	{
-		bits = cpuInfo[CPUID_EAX];
-		procInfo.turboBoost = bits[1];
-		procInfo.turboBoost3_0 = bits[14];
-	}
+		// Heterogeneous processor clusters
+		procInfo.coreMasks[static_cast<short>(CoreTypes::ANY)] |= logicalCore.processorMask;
 
-#ifdef HYBRIDDETECT_OS_WIN
-	DWORD_PTR           affinityMask;
-	DWORD_PTR           processAffinityMask;
-	DWORD_PTR           sysAffinityMask;
+		// Homogeneous processor clusters
+		procInfo.coreMasks[static_cast<short>(logicalCore.coreType)] |= logicalCore.processorMask;
 
-	// What does the process & system allow
-	GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &sysAffinityMask);
+#ifdef ENABLE_CPU_SETS
+		procInfo.cpuSets[static_cast<unsigned int>(CoreTypes::ANY)].push_back(logicalCore.id);
+		procInfo.cpuSets[static_cast<unsigned int>(logicalCore.coreType)].push_back(logicalCore.id);
 #endif
+	}
+}
 
-	GetLogicalProcessorsEx(procInfo);
+// Minimum difference, in percent, between the maximum frequencies (or L2 per logical processor) of two groups
+// of logical processors for ClassifyCoreTypes to tell them apart. Keeps favored cores (Turbo Boost Max 3.0,
+// preferred cores) a few hundred MHz faster than their neighbours in one group.
+#ifndef HYBRIDDETECT_CLASSIFY_GAP
+#define HYBRIDDETECT_CLASSIFY_GAP				15
+#endif
 
-#ifdef HYBRIDDETECT_OS_WIN
-	// Fill in Logical Processors, short circuit if error.
-	if (GetLogicalProcessors(procInfo))
+// Vendor neutral heterogeneity classifier, for parts whose core types CPUID leaf 0x1A does not report
+// (AMD Zen 4c/Zen 5c mixes without leaf 0x80000026, other vendors, virtual machines). Logical processors
+// are split by the first measured capability that separates them: efficiency class (Windows CPU sets), maximum
+// frequency (leaf 0x16, cpufreq or power information), then L2 size per logical processor. The most capable
+// group maps onto INTEL_CORE, the others onto INTEL_ATOM, so the split pools & RunOn(INTEL_*) work unchanged.
+// Also sets procInfo.hybrid when core types already differ (leaf 0x80000026). Returns procInfo.hybrid.
+inline bool ClassifyCoreTypes(PROCESSOR_INFO& procInfo)
+{
+	HYBRID_DETECT_TRACE(5, ">>>");
+	if (procInfo.hybrid || procInfo.cores.size() < 2) return procInfo.hybrid;
+
+	bool typed = false;
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
 	{
-		HYBRID_DETECT_TRACE(5, "=== procInfo.numLogicalCores = %d, procInfo.numGroups = %d", procInfo.numLogicalCores, procInfo.numGroups);
+		if (logicalCore.coreType != procInfo.cores[0].coreType) typed = true;
+	}
 
-		// Query Current Frequency for each Logical Processor using CallNTPowerInformation
-		// https://docs.microsoft.com/en-us/windows/win32/api/powerbase/nf-powerbase-callntpowerinformation
-		std::vector<LOGICAL_PROCESSOR_POWER_INFORMATION> pwrInfo(procInfo.numLogicalCores);
-		DWORD size = sizeof(LOGICAL_PROCESSOR_POWER_INFORMATION) * procInfo.numLogicalCores;
-		CallNtPowerInformation(ProcessorInformation, nullptr, 0, &pwrInfo[0], size);
+	if (!typed)
+	{
+		const size_t coreCount = procInfo.cores.size();
+		std::vector<unsigned> efficiency(coreCount), frequency(coreCount), l2(coreCount);
 
-		for (unsigned group = 0; group < procInfo.numGroups; group++)
+		for (size_t i = 0; i < coreCount; i++)
 		{
-			// TODO Use Thread Group Affinity https://docs.microsoft.com/en-us/windows/win32/api/processtopologyapi/nf-processtopologyapi-setthreadgroupaffinity
-			GROUP_AFFINITY nextGroup;
-			GROUP_AFFINITY prevGroup;
-			nextGroup.Group = static_cast<WORD>(group);
-			nextGroup.Mask = 0xffffffff;
+			const LOGICAL_PROCESSOR_INFO& logicalCore = procInfo.cores[i];
+			efficiency[i] = logicalCore.efficiencyClass;
+			frequency[i] = logicalCore.maximumFrequency > logicalCore.powerInformation.maxMhz ? logicalCore.maximumFrequency : logicalCore.powerInformation.maxMhz;
 
-			SetThreadGroupAffinity(GetCurrentThread(), &nextGroup, &prevGroup);
+			for (const CACHE_INFO& cache : procInfo.caches)
+			{
+				if (cache.level != 2 || cache.type == CacheInstruction || !cache.processorMask.Intersects(logicalCore.processorMask)) continue;
 
-			HYBRID_DETECT_TRACE(5, "=== group = %d, procInfo.groups[group].maximumProcessorCount = %d, procInfo.groups[group].activeProcessorCount = %d", group,
-				procInfo.groups[group].maximumProcessorCount, procInfo.groups[group].activeProcessorCount);
+				const unsigned sharing = (unsigned)cache.processorMask.Count();
+				l2[i] = cache.size / (sharing ? sharing : 1);
+				break;
+			}
+		}
 
-			// Enumerate each logical core. Need active or maximum processor count?
-			for (unsigned core = 0; core < procInfo.groups[group].activeProcessorCount; core++)
+		// Cores within gap percent of the most capable one form the performance group, capability 0 is unknown
+		auto split = [&](const std::vector<unsigned>& capability, unsigned gap)
+		{
+			const unsigned best = *std::max_element(capability.begin(), capability.end());
+			const double threshold = best * (100.0 - gap) / 100.0;
+			bool performance = false, efficient = false;
+
+			for (unsigned value : capability)
+			{
+				if (value == 0) return false;
+				if (value >= threshold) performance = true; else efficient = true;
+			}
+			if (!performance || !efficient) return false;
+
+			for (size_t i = 0; i < coreCount; i++)
 			{
-				HYBRID_DETECT_TRACE(5, "=== core = %d", core);
+				procInfo.cores[i].coreType = capability[i] >= threshold ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM;
+			}
+			return true;
+		};
 
-				// Logical Processor Info struct for storage.
+		// Efficiency classes are ranks, any difference counts
+		std::vector<unsigned> efficiencyRank(efficiency);
+		for (unsigned& rank : efficiencyRank) rank++;
+
+		typed = split(efficiencyRank, 0) || split(frequency, HYBRIDDETECT_CLASSIFY_GAP) || split(l2, HYBRIDDETECT_CLASSIFY_GAP);
+	}
+
+	if (typed)
+	{
+		procInfo.hybrid = true;
+		UpdateCoreTypeSets(procInfo);
+	}
+
+	HYBRID_DETECT_TRACE(5, "<<< hybrid = %d", (int)procInfo.hybrid);
+	return procInfo.hybrid;
+}
+
+// Derives procInfo.modules from the L2 sharing masks of procInfo.caches. Called by GetProcessorInfo &
+// LoadProcessorInfo.
+inline void UpdateModules(PROCESSOR_INFO& procInfo)
+{
+	procInfo.modules.clear();
+
+	for (unsigned i = 0; i < procInfo.caches.size(); i++)
+	{
+		const CACHE_INFO& cache = procInfo.caches[i];
+		if (cache.level != 2 || cache.type == CacheInstruction) continue;
+
+		MODULE_INFO module;
+		module.cacheIndex = i;
+
+		for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+		{
+			if (!logicalCore.processorMask.Intersects(cache.processorMask)) continue;
+
+			if (module.processorMask.None()) module.coreType = logicalCore.coreType;
+			module.processorMask |= logicalCore.processorMask;
 #ifdef ENABLE_CPU_SETS
-				LOGICAL_PROCESSOR_INFO& logicalCore = procInfo.cores[core];
-#else
-				LOGICAL_PROCESSOR_INFO					logicalCore;
-				logicalCore.logicalProcessorIndex = core;
+			module.cpuSets.push_back(logicalCore.id);
 #endif
-				// Get the ID of the current processor;
-				//int                                     prevProcessor = GetCurrentProcessorNumber();
+		}
+
+		if (module.processorMask.Any())
+		{
+			procInfo.modules.push_back(module);
+		}
+	}
+	HYBRID_DETECT_TRACE(5, "=== %d modules", (int)procInfo.modules.size());
+}
+
+// Refreshes the process specific limits of procInfo: allowedMask & cpuQuota.
+// Called by GetProcessorInfo/GetProcessorInfoCached, call again after changing the process affinity.
+inline void UpdateAllowedProcessors(PROCESSOR_INFO& procInfo)
+{
+	HYBRID_DETECT_TRACE(7, ">>>");
+	procInfo.allowedMask = ProcessorMask();
+	procInfo.cpuQuota = 0.0;
+
+#if defined(HYBRIDDETECT_OS_WIN)
+	USHORT groupCount = 0;
+	GetProcessGroupAffinity(GetCurrentProcess(), &groupCount, nullptr);
+
+	std::vector<USHORT> processGroups(groupCount ? groupCount : 1);
+	groupCount = static_cast<USHORT>(processGroups.size());
+
+	DWORD_PTR processAffinityMask = 0;
+	DWORD_PTR systemAffinityMask = 0;
+
+	if (GetProcessGroupAffinity(GetCurrentProcess(), &groupCount, processGroups.data()) && groupCount == 1 &&
+		GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &systemAffinityMask))
+	{
+		procInfo.allowedMask = GroupMaskToProcessorMask(procInfo, processGroups[0], processAffinityMask);
+	}
+	else
+	{
+		// Processes spanning several groups may run on every active processor of those groups.
+		for (USHORT i = 0; i < groupCount; i++)
+		{
+			if (processGroups[i] < procInfo.groups.size())
+			{
+				procInfo.allowedMask |= GroupMaskToProcessorMask(procInfo, processGroups[i], procInfo.groups[processGroups[i]].activeProcessorMask);
+			}
+		}
+	}
+
+	// Job object hard cap (e.g. Windows containers): CpuRate is in 1/100 percent of all processors.
+	JOBOBJECT_CPU_RATE_CONTROL_INFORMATION rateControl = {};
+
+	if (QueryInformationJobObject(nullptr, JobObjectCpuRateControlInformation, &rateControl, sizeof(rateControl), nullptr) &&
+		(rateControl.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_ENABLE) &&
+		(rateControl.ControlFlags & JOB_OBJECT_CPU_RATE_CONTROL_HARD_CAP) &&
+		!(rateControl.ControlFlags & (JOB_OBJECT_CPU_RATE_CONTROL_WEIGHT_BASED | JOB_OBJECT_CPU_RATE_CONTROL_MIN_MAX_RATE)))
+	{
+		procInfo.cpuQuota = rateControl.CpuRate / 10000.0 * procInfo.numLogicalCores;
+	}
+#elif defined(HYBRIDDETECT_OS_LINUX)
+	unsigned maxCPU = CPU_SETSIZE - 1;
+
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		maxCPU = std::max(maxCPU, logicalCore.logicalProcessorIndex);
+	}
+
+	cpu_set_t* affinity = CPU_ALLOC(maxCPU + 1);
+	const size_t affinitySize = CPU_ALLOC_SIZE(maxCPU + 1);
+
+	if (affinity)
+	{
+		CPU_ZERO_S(affinitySize, affinity);
+
+		if (sched_getaffinity(0, affinitySize, affinity) == 0)
+		{
+			for (unsigned cpu = 0; cpu <= maxCPU; cpu++)
+			{
+				if (CPU_ISSET_S(cpu, affinitySize, affinity)) procInfo.allowedMask.Set(cpu);
+			}
+		}
+		CPU_FREE(affinity);
+	}
+
+	// sched_getaffinity already reflects the cpuset of the cgroup the process started in, intersecting with
+	// the cgroup files also covers a cpuset narrowed later.
+	std::vector<unsigned> cgroupCPUs;
 
-				// Convert the oridinal position to an affinity mask.
-				affinityMask = (DWORD)IndexToMask(core);
+	if (GetCgroupCPUSet(cgroupCPUs))
+	{
+		const ProcessorMask cgroupMask = CPUListToMask(cgroupCPUs);
+		procInfo.allowedMask = procInfo.allowedMask.Any() ? (procInfo.allowedMask & cgroupMask) : cgroupMask;
+	}
 
-				// Thread Affinity Mask is enough to switch to current thread immediatlely. 
-				SetThreadAffinityMask(GetCurrentThread(), processAffinityMask & affinityMask);
+	procInfo.cpuQuota = GetCgroupCPUQuota();
+#endif
+	HYBRID_DETECT_TRACE(5, "=== allowed %d logical processors, quota %f", (int)procInfo.allowedMask.Count(), procInfo.cpuQuota);
+	HYBRID_DETECT_TRACE(7, "<<< ");
+}
 
-				logicalCore.processorMask = std::bitset<64>(affinityMask);
+// Reads the per logical processor CPUID leaves (ISA, frequency & hybrid core type).
+// The calling thread must already be running on the logical processor described by logicalCore.
+inline void ProbeLogicalProcessor(const PROCESSOR_INFO& procInfo, LOGICAL_PROCESSOR_INFO& logicalCore, unsigned core, unsigned CPUIDFunctionMax)
+{
+	std::array<unsigned, 4>  cpuInfo{}; // zero-init
+	std::bitset<32>     bits;
 
 #if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
-				// Processor Extended State Enumeration Main Leaf (EAX = 0DH, ECX = 0)
-				CallCPUID(LEAF_EXTENDED_STATE, cpuInfo);
-				{
-					bits = cpuInfo[CPUID_EAX];
-					logicalCore.SSE = bits[1];
-					logicalCore.AVX = bits[2];
-					logicalCore.AVX512 = bits[5];
-				}
+	// Processor Extended State Enumeration Main Leaf (EAX = 0DH, ECX = 0)
+	CallCPUID(LEAF_EXTENDED_STATE, cpuInfo);
+	{
+		bits = cpuInfo[CPUID_EAX];
+		logicalCore.SSE = bits[1];
+		logicalCore.AVX = bits[2];
+		logicalCore.AVX512 = bits[5];
+	}
 
-				// Structured Extended Feature Flags Enumeration Leaf (Output depends on ECX input value)
-				CallCPUID(LEAF_EXTENDED_FEATURE_FLAGS, cpuInfo);
-				{
-					bits = cpuInfo[CPUID_EBX];
-					logicalCore.AVX2 = bits[5];
-					logicalCore.AVX512F = bits[16];
-					logicalCore.AVX512DQ = bits[17];
-					logicalCore.AVX512_IFMA = bits[21];
-					logicalCore.AVX512PF = bits[26];
-					logicalCore.AVX512ER = bits[27];
-					logicalCore.AVX512CD = bits[28];
-					logicalCore.SHA = bits[29];
-					logicalCore.SGX = bits[2];
-					logicalCore.AVX512BW = bits[30];
-					logicalCore.AVX512VL = bits[31];
-
-					bits = cpuInfo[CPUID_ECX];
-					logicalCore.AVX512_VBMI = bits[1];
-					logicalCore.AVX512_VBMI2 = bits[6];
-					logicalCore.AVX512_VNNI = bits[11];
-					logicalCore.AVX512_BITALG = bits[12];
-					logicalCore.AVX512_VPOPCNTDQ = bits[14];
-
-					bits = cpuInfo[CPUID_EDX];
-					logicalCore.AVX512_4VNNIW = bits[2];
-					logicalCore.AVX512_4FMAPS = bits[3];
-					logicalCore.AVX512_VP2INTERSECT = bits[8];
-				}
+	// Structured Extended Feature Flags Enumeration Leaf (Output depends on ECX input value)
+	CallCPUID(LEAF_EXTENDED_FEATURE_FLAGS, cpuInfo);
+	{
+		bits = cpuInfo[CPUID_EBX];
+		logicalCore.AVX2 = bits[5];
+		logicalCore.AVX512F = bits[16];
+		logicalCore.AVX512DQ = bits[17];
+		logicalCore.AVX512_IFMA = bits[21];
+		logicalCore.AVX512PF = bits[26];
+		logicalCore.AVX512ER = bits[27];
+		logicalCore.AVX512CD = bits[28];
+		logicalCore.SHA = bits[29];
+		logicalCore.SGX = bits[2];
+		logicalCore.AVX512BW = bits[30];
+		logicalCore.AVX512VL = bits[31];
+
+		bits = cpuInfo[CPUID_ECX];
+		logicalCore.AVX512_VBMI = bits[1];
+		logicalCore.AVX512_VBMI2 = bits[6];
+		logicalCore.AVX512_VNNI = bits[11];
+		logicalCore.AVX512_BITALG = bits[12];
+		logicalCore.AVX512_VPOPCNTDQ = bits[14];
+
+		bits = cpuInfo[CPUID_EDX];
+		logicalCore.AVX512_4VNNIW = bits[2];
+		logicalCore.AVX512_4FMAPS = bits[3];
+		logicalCore.AVX512_VP2INTERSECT = bits[8];
+	}
 #endif // ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
 
-				// Processor Frequency Information Leaf  function 0x16 only works on Sky-lake or newer.
-				CallCPUID(LEAF_FREQUENCY_INFORMATION, cpuInfo);
-				{
-					logicalCore.baseFrequency = cpuInfo[CPUID_EAX];
-					logicalCore.maximumFrequency = cpuInfo[CPUID_EBX];
-					logicalCore.busFrequency = cpuInfo[CPUID_ECX];
+	// Processor Frequency Information Leaf  function 0x16 only works on Sky-lake or newer.
+	// Older CPUs report zero, keep whatever frequencies the OS reported for them.
+	if (CallCPUID(LEAF_FREQUENCY_INFORMATION, cpuInfo, 0, CPUIDFunctionMax) && cpuInfo[CPUID_EAX] != 0)
+	{
+		logicalCore.baseFrequency = cpuInfo[CPUID_EAX];
+		logicalCore.maximumFrequency = cpuInfo[CPUID_EBX];
+		logicalCore.busFrequency = cpuInfo[CPUID_ECX];
+	}
 
-					// Fall-back to ProcessorPowerInfo for older CPUs
-					if (logicalCore.baseFrequency == 0)
-					{
-						// Not accurate enough, not always mapped to correct core?
-						//logicalCore.baseFrequency = pwrInfo[core].mhzLimit;
-						//logicalCore.maximumFrequency = pwrInfo[core].maxMhz;
-					}
+	// Hybrid Information Sub - leaf(EAX = 1AH, ECX = 0)
+#ifndef ENABLE_SOFTWARE_PROXY
+	(void)core;
 
-					logicalCore.currentFrequency = pwrInfo[core].currentMhz;
-					logicalCore.powerInformation = pwrInfo[core];
-				}
+	if (CallCPUID(LEAF_HYBRID_INFORMATION, cpuInfo, 0, CPUIDFunctionMax))
+	{
+		std::bitset<8> coreTypeBits;    // Bits 31 - 24: Core type
+		bits = cpuInfo[CPUID_EAX];
+		coreTypeBits[0] = bits[24];
+		coreTypeBits[1] = bits[25];
+		coreTypeBits[2] = bits[26];
+		coreTypeBits[3] = bits[27];
+		coreTypeBits[4] = bits[28];
+		coreTypeBits[5] = bits[29];
+		coreTypeBits[6] = bits[30];
+		coreTypeBits[7] = bits[31];
+
+		// Non-hybrid parts report zero, keep the OS provided core type (if any).
+		if (coreTypeBits.any())
+		{
+			logicalCore.coreType = (CoreTypes)coreTypeBits.to_ulong();
+		}
+	}
 
-				// Hybrid Information Sub - leaf(EAX = 1AH, ECX = 0)
-				CallCPUID(LEAF_HYBRID_INFORMATION, cpuInfo);
-				{
-#ifndef ENABLE_SOFTWARE_PROXY
-					std::bitset<8> coreTypeBits;    // Bits 31 - 24: Core type
-					bits = cpuInfo[CPUID_EAX];
-					coreTypeBits[0] = bits[24];
-					coreTypeBits[1] = bits[25];
-					coreTypeBits[2] = bits[26];
-					coreTypeBits[3] = bits[27];
-					coreTypeBits[4] = bits[28];
-					coreTypeBits[5] = bits[29];
-					coreTypeBits[6] = bits[30];
-					coreTypeBits[7] = bits[31];
-					logicalCore.coreType = (CoreTypes)coreTypeBits.to_ulong();
+	// AMD heterogeneous parts (e.g. Zen 4c/Zen 5c mixes): CPUID.80000026H:EAX[30] HeterogeneousCores,
+	// EBX[31:28] CoreType of this logical processor, 0 = performance, mapped onto the Intel bins.
+	if (procInfo.IsAMD() && CallCPUID(LEAF_EXTENDED_INFORMATION_0, cpuInfo))
+	{
+		const unsigned extendedFunctionMax = cpuInfo[CPUID_EAX];
+
+		if (CallCPUID(LEAF_EXTENDED_CPU_TOPOLOGY, cpuInfo, 0, extendedFunctionMax) && (cpuInfo[CPUID_EAX] & (1u << 30)))
+		{
+			logicalCore.coreType = (cpuInfo[CPUID_EBX] >> 28) == 0 ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM;
+		}
+	}
 #else
-					std::string s(procInfo.brandString);
+	{
+		std::string s(procInfo.brandString);
 
-					if (s.find("Platinum 8268") != std::string::npos)
-					{
-						logicalCore.coreType = (core < 12) ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM;
-					}
-					else if (s.find("i9-9980XE") != std::string::npos)
-					{
-						logicalCore.coreType = (core < 16) ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM;
-					}
-					else
-					{
-						// Split homogeneous cores into logical heterogeneous 50/50 clusters
-						logicalCore.coreType = (core < (procInfo.numLogicalCores / 2) ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM);
+		if (s.find("Platinum 8268") != std::string::npos)
+		{
+			logicalCore.coreType = (core < 12) ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM;
+		}
+		else if (s.find("i9-9980XE") != std::string::npos)
+		{
+			logicalCore.coreType = (core < 16) ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM;
+		}
+		else
+		{
+			// Split homogeneous cores into logical heterogeneous 50/50 clusters
+			logicalCore.coreType = (core < (procInfo.numLogicalCores / 2) ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM);
+
+			// Useful for Testing Asymetric Hybrid Configurations (2+8 (4 HT Cores + 8 Atom Cores)
+			//logicalCore.coreType = (core < 4 ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM);
+		}
+	}
+#endif
+
+	logicalCore.probed = 1;
+}
 
-						// Useful for Testing Asymetric Hybrid Configurations (2+8 (4 HT Cores + 8 Atom Cores)
-						//logicalCore.coreType = (core < 4 ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM);
-					}
+#if defined(HYBRIDDETECT_OS_WIN) || defined(HYBRIDDETECT_OS_LINUX)
+#ifndef HYBRIDDETECT_MAX_PROBE_THREADS
+#define HYBRIDDETECT_MAX_PROBE_THREADS 8 // Upper bound on helper threads used by ProbeLogicalProcessors
 #endif
-				}
 
-				// Heterogeneous processor clusters
-				procInfo.coreMasks[static_cast<short>(CoreTypes::ANY)] |= affinityMask;
+// Runs ProbeLogicalProcessor for every entry in procInfo.cores the helpers can be pinned to, those are marked probed.
+// The cores are split into contiguous batches, each batch is probed by a helper thread that pins itself to one
+// logical processor at a time (SetThreadGroupAffinity on Windows, sched_setaffinity on Linux). Every helper
+// writes only to its own entries, so the result does not depend on thread timing, and the caller's affinity is
+// never modified: GetProcessorInfo can be called concurrently, also from pinned threads.
+inline void ProbeLogicalProcessors(PROCESSOR_INFO& procInfo, unsigned CPUIDFunctionMax)
+{
+	HYBRID_DETECT_TRACE(7, ">>>");
+
+	const unsigned coreCount = (unsigned)procInfo.cores.size();
+	if (coreCount == 0) return;
+
+	unsigned maxCPU = 0;
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		maxCPU = (unsigned)logicalCore.id > maxCPU ? (unsigned)logicalCore.id : maxCPU;
+	}
+
+	unsigned threadCount = std::thread::hardware_concurrency();
+	threadCount = threadCount < 1 ? 1 : threadCount;
+	threadCount = threadCount < HYBRIDDETECT_MAX_PROBE_THREADS ? threadCount : HYBRIDDETECT_MAX_PROBE_THREADS;
+	threadCount = threadCount < coreCount ? threadCount : coreCount;
+
+	const unsigned batchSize = (coreCount + threadCount - 1) / threadCount;
+
+	auto probeBatch = [&procInfo, CPUIDFunctionMax, maxCPU](unsigned first, unsigned last)
+	{
+#if defined(HYBRIDDETECT_OS_LINUX)
+		cpu_set_t* cpuSet = CPU_ALLOC(maxCPU + 1);
+		const size_t cpuSetSize = CPU_ALLOC_SIZE(maxCPU + 1);
+#else
+		(void)maxCPU;
+#endif
+
+		for (unsigned core = first; core < last; core++)
+		{
+			LOGICAL_PROCESSOR_INFO& logicalCore = procInfo.cores[core];
+
+#if defined(HYBRIDDETECT_OS_WIN)
+			// Group affinity is enough to switch the current thread to the logical processor immediately,
+			// and unlike SetThreadAffinityMask it can reach processors outside of the primary group.
+			GROUP_AFFINITY nextGroup = {};
+			nextGroup.Group = static_cast<WORD>(logicalCore.group);
+			nextGroup.Mask = static_cast<KAFFINITY>(IndexToMask(logicalCore.logicalProcessorIndex));
+
+			// Processors outside of the process affinity keep the OS data only, probed stays 0.
+			if (SetThreadGroupAffinity(GetCurrentThread(), &nextGroup, nullptr))
+			{
+				ProbeLogicalProcessor(procInfo, logicalCore, core, CPUIDFunctionMax);
+			}
+#else
+			CPU_ZERO_S(cpuSetSize, cpuSet);
+			CPU_SET_S(logicalCore.id, cpuSetSize, cpuSet);
+
+			// Processors outside of our cpuset keep the sysfs data only, probed stays 0.
+			if (sched_setaffinity(0, cpuSetSize, cpuSet) == 0)
+			{
+				ProbeLogicalProcessor(procInfo, logicalCore, core, CPUIDFunctionMax);
+			}
+#endif
+		}
+
+#if defined(HYBRIDDETECT_OS_LINUX)
+		CPU_FREE(cpuSet);
+#endif
+	};
+
+	std::vector<std::thread> probes;
+	for (unsigned first = 0; first < coreCount; first += batchSize)
+	{
+		probes.emplace_back(probeBatch, first, first + batchSize < coreCount ? first + batchSize : coreCount);
+	}
+
+	for (std::thread& probe : probes)
+	{
+		probe.join();
+	}
+
+	HYBRID_DETECT_TRACE(7, "<<<");
+}
+#endif // HYBRIDDETECT_OS_WIN || HYBRIDDETECT_OS_LINUX
+
+// Synthetic topology injected by InjectTopology, e.g. parsed from "8P+16E, 2 NUMA nodes, L2 per 4 E-cores".
+typedef struct _TOPOLOGY_DESCRIPTION
+{
+	unsigned							pCores = 0;
+	unsigned							pThreads = 2;				// Logical processors per P-Core, 1 without SMT
+	unsigned							eCores = 0;
+	unsigned							eCoresPerL2 = 4;			// E-Cores per module (shared L2)
+	unsigned							numaNodes = 1;
+	unsigned							pL2Size = 2 * 1024 * 1024;
+	unsigned							eL2Size = 4 * 1024 * 1024;
+	unsigned							l3Size = 0;					// Per NUMA node, 0 for 3MB per P-Core & per module
+} TOPOLOGY_DESCRIPTION, * PTOPOLOGY_DESCRIPTION;
+
+// Parses a comma separated topology description into desc. Understood terms (case insensitive):
+// "<n>P+<m>E" (either part may be omitted), "<n> NUMA nodes", "L2 per <n> E-cores", "SMT<n>" & "no SMT".
+inline bool ParseTopologyDescription(const char* text, TOPOLOGY_DESCRIPTION& desc)
+{
+	desc = TOPOLOGY_DESCRIPTION();
+	if (!text) return false;
+
+	std::string lower(text);
+	std::transform(lower.begin(), lower.end(), lower.begin(), [](char c) { return (char)tolower((unsigned char)c); });
+
+	size_t begin = 0;
+	while (begin <= lower.size())
+	{
+		size_t end = lower.find(',', begin);
+		if (end == std::string::npos) end = lower.size();
+
+		std::string term = lower.substr(begin, end - begin);
+		term.erase(0, term.find_first_not_of(' '));
+		term.erase(term.find_last_not_of(' ') + 1);
+		begin = end + 1;
+
+		if (term.empty()) continue;
+
+		// Leading number of a term, 0 when missing
+		auto number = [&term](size_t offset, const char** next = nullptr)
+		{
+			char* end = nullptr;
+			const char* start = term.c_str() + (offset < term.size() ? offset : term.size());
+			const unsigned long value = strtoul(start, &end, 10);
+			if (next) *next = end;
+			return end == start ? 0u : (unsigned)value;
+		};
+
+		if (term.find("numa") != std::string::npos)
+		{
+			if ((desc.numaNodes = number(0)) == 0) return false;
+		}
+		else if (term.compare(0, 6, "l2 per") == 0)
+		{
+			if ((desc.eCoresPerL2 = number(6)) == 0) return false;
+		}
+		else if (term == "no smt")
+		{
+			desc.pThreads = 1;
+		}
+		else if (term.compare(0, 3, "smt") == 0)
+		{
+			if ((desc.pThreads = number(3)) == 0) return false;
+		}
+		else
+		{
+			// <n>p+<m>e
+			size_t offset = 0;
+			while (offset < term.size())
+			{
+				const char* next = nullptr;
+				const unsigned value = number(offset, &next);
+				while (*next == ' ') next++;
+
+				if (*next == 'p') desc.pCores = value;
+				else if (*next == 'e') desc.eCores = value;
+				else return false;
+
+				next++;
+				while (*next == ' ' || *next == '+') next++;
+				offset = next - term.c_str();
+			}
+		}
+	}
+
+	return desc.pCores + desc.eCores > 0;
+}
+
+// Replaces the topology of procInfo (filled by GetProcessorInfo) with a synthetic one: core types, physical
+// cores, caches, modules & NUMA nodes are those of desc, P-Core threads first then E-Cores, as enumerated by
+// hybrid parts. Every synthetic logical processor keeps the id, group & mask of the real logical processor it
+// is mapped onto (round robin when desc has more of them than the host), so RunOn & TaskScheduler affinity
+// calls land on real CPUs. Lets split-pool policies be benchmarked for future parts on homogeneous machines.
+// Once logical processors wrap around, mask based queries (coreMasks, TopologyIndex, ...) see shared real
+// processors, counts from cores/cpuSets/modules stay exact.
+inline bool InjectTopology(PROCESSOR_INFO& procInfo, const TOPOLOGY_DESCRIPTION& desc)
+{
+	HYBRID_DETECT_TRACE(5, ">>> %dP(%d threads)+%dE", (int)desc.pCores, (int)desc.pThreads, (int)desc.eCores);
+	if (desc.pCores + desc.eCores == 0 || desc.pThreads == 0 || desc.eCoresPerL2 == 0 || desc.numaNodes == 0) return false;
+
+	std::vector<LOGICAL_PROCESSOR_INFO> host = procInfo.cores;
+	if (host.empty())
+	{
+		host.resize(1);
+		host[0].processorMask = IndexToProcessorMask(0);
+	}
+
+	const unsigned nodeCount = desc.numaNodes;
+	const unsigned moduleCount = (desc.eCores + desc.eCoresPerL2 - 1) / desc.eCoresPerL2;
+
+	procInfo.cores.clear();
+	procInfo.caches.clear();
+	procInfo.nodes.assign(nodeCount, NUMA_NODE_INFO());
+
+	// Built here rather than by UpdateModules, masks are ambiguous once logical processors wrap around
+	std::vector<MODULE_INFO> modules(desc.pCores + moduleCount);
+	std::vector<ProcessorMask> nodeMasks(nodeCount);
+
+	const unsigned physicalCores = desc.pCores + desc.eCores;
+	for (unsigned physicalCore = 0; physicalCore < physicalCores; physicalCore++)
+	{
+		const bool pCore = physicalCore < desc.pCores;
+		const unsigned typeIndex = pCore ? physicalCore : physicalCore - desc.pCores;
+		const unsigned node = typeIndex * nodeCount / (pCore ? desc.pCores : desc.eCores);
+		const unsigned threads = pCore ? desc.pThreads : 1;
+
+		CACHE_INFO l1, l2;
+		l1.level = 1;
+		l1.size = pCore ? 48 * 1024 : 32 * 1024;
+		l1.lineSize = 64;
+		l1.associativity = pCore ? 12 : 8;
+		l1.type = CacheData;
+		l2.level = 2;
+		l2.size = pCore ? desc.pL2Size : desc.eL2Size;
+		l2.lineSize = 64;
+		l2.associativity = 16;
+		l2.type = CacheUnified;
+
+		for (unsigned thread = 0; thread < threads; thread++)
+		{
+			LOGICAL_PROCESSOR_INFO logicalCore = host[procInfo.cores.size() % host.size()];
+			logicalCore.coreType = pCore ? CoreTypes::INTEL_CORE : CoreTypes::INTEL_ATOM;
+			logicalCore.efficiencyClass = pCore ? 1 : 0;
+			logicalCore.coreIndex = physicalCore;
+			logicalCore.node = node;
+			logicalCore.parked = 0;
+
+			l1.processorMask |= logicalCore.processorMask;
+			nodeMasks[node] |= logicalCore.processorMask;
+			if (pCore) l2.processorMask |= logicalCore.processorMask;
+
+			MODULE_INFO& module = pCore ? modules[physicalCore] : modules[desc.pCores + typeIndex / desc.eCoresPerL2];
+			module.coreType = logicalCore.coreType;
+			module.processorMask |= logicalCore.processorMask;
+#ifdef ENABLE_CPU_SETS
+			module.cpuSets.push_back(logicalCore.id);
+#endif
+			procInfo.cores.push_back(logicalCore);
+		}
+
+		procInfo.caches.push_back(l1);
+		if (pCore)
+		{
+			modules[physicalCore].cacheIndex = (unsigned)procInfo.caches.size();
+			procInfo.caches.push_back(l2);
+		}
+	}
+
+	for (unsigned module = desc.pCores; module < modules.size(); module++)
+	{
+		CACHE_INFO l2;
+		l2.level = 2;
+		l2.size = desc.eL2Size;
+		l2.lineSize = 64;
+		l2.associativity = 16;
+		l2.type = CacheUnified;
+		l2.processorMask = modules[module].processorMask;
+
+		modules[module].cacheIndex = (unsigned)procInfo.caches.size();
+		procInfo.caches.push_back(l2);
+	}
+	procInfo.modules = modules;
+	UpdateCoreTypeSets(procInfo);
+
+	const unsigned l3Size = desc.l3Size ? desc.l3Size : 3 * 1024 * 1024 * (desc.pCores + moduleCount) / nodeCount;
+	for (unsigned node = 0; node < nodeCount; node++)
+	{
+		procInfo.nodes[node].nodeNumber = node;
+		procInfo.nodes[node].mask = nodeMasks[node];
+
+		CACHE_INFO l3;
+		l3.level = 3;
+		l3.size = l3Size;
+		l3.lineSize = 64;
+		l3.associativity = 12;
+		l3.type = CacheUnified;
+		l3.processorMask = nodeMasks[node];
+		procInfo.caches.push_back(l3);
+	}
+
+	procInfo.hybrid = desc.pCores > 0 && desc.eCores > 0;
+	procInfo.numNUMANodes = nodeCount;
+	procInfo.numProcessorPackages = 1;
+	procInfo.numPhysicalCores = physicalCores;
+	procInfo.numLogicalCores = (unsigned)procInfo.cores.size();
+	procInfo.numL1Caches = physicalCores;
+	procInfo.numL2Caches = desc.pCores + moduleCount;
+	procInfo.numL3Caches = nodeCount;
+
+	UpdateAllowedProcessors(procInfo);
+	HYBRID_DETECT_TRACE(5, "<<< %d logical processors", (int)procInfo.numLogicalCores);
+	return true;
+}
+
+inline bool InjectTopology(PROCESSOR_INFO& procInfo, const char* description)
+{
+	TOPOLOGY_DESCRIPTION desc;
+	return ParseTopologyDescription(description, desc) && InjectTopology(procInfo, desc);
+}
+
+// Environment variable read by GetProcessorInfo: a topology description to inject in place of the detected one,
+// so unmodified applications can be run against a synthetic topology.
+#define HYBRIDDETECT_TOPOLOGY_ENVIRONMENT		"HYBRIDDETECT_TOPOLOGY"
+
+inline bool GetTopologyEnvironment(std::string& description)
+{
+#if defined(HYBRIDDETECT_OS_WIN)
+	char buffer[256];
+	const DWORD length = GetEnvironmentVariableA(HYBRIDDETECT_TOPOLOGY_ENVIRONMENT, buffer, sizeof(buffer));
+	if (length == 0 || length >= sizeof(buffer)) return false;
+	description.assign(buffer, length);
+#else
+	const char* value = getenv(HYBRIDDETECT_TOPOLOGY_ENVIRONMENT);
+	if (!value || !*value) return false;
+	description = value;
+#endif
+	return true;
+}
+
+// Calls CPUID & GetLogicalProcessors & CallNTPowerInformation to fill in PROCESSOR_INFO with the topology
+// of the running system, HYBRIDDETECT_TOPOLOGY is left to GetProcessorInfo.
+inline void EnumerateProcessorInfo(PROCESSOR_INFO& procInfo)
+{
+	HYBRID_DETECT_TRACE(7, ">>>");
+#ifdef ENABLE_HYBRID_DETECT
+	// https://software.intel.com/content/www/us/en/develop/download/intel-architecture-instruction-set-extensions-programming-reference.html
+
+		// Store registers from CPUID
+	std::array<unsigned, 4>  cpuInfo{}; // zero-init
+
+	// Maximum leaf ordinal Reported by CPUID
+	unsigned            CPUIDFunctionMax;
+
+	std::bitset<32>     bits;
+
+	procInfo.coreMasks.emplace((short)CoreTypes::ANY, ProcessorMask());
+	procInfo.coreMasks.emplace((short)CoreTypes::NONE, ProcessorMask());
+#if HYBRIDDETECT_CPU_X86_64
+	procInfo.coreMasks.emplace((short)CoreTypes::RESERVED0, ProcessorMask());
+	procInfo.coreMasks.emplace((short)CoreTypes::INTEL_ATOM, ProcessorMask());
+	procInfo.coreMasks.emplace((short)CoreTypes::RESERVED1, ProcessorMask());
+	procInfo.coreMasks.emplace((short)CoreTypes::INTEL_CORE, ProcessorMask());
+#else
+	procInfo.coreMasks.emplace((short)CoreTypes::PERFLEVEL0, ProcessorMask());
+	procInfo.coreMasks.emplace((short)CoreTypes::PERFLEVEL1, ProcessorMask());
+#endif
+
+#ifdef ENABLE_CPU_SETS
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::ANY, std::vector<ULONG>()));
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::NONE, std::vector<ULONG>()));
+#if HYBRIDDETECT_CPU_X86_64
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::RESERVED0, std::vector<ULONG>()));
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::INTEL_ATOM, std::vector<ULONG>()));
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::RESERVED1, std::vector<ULONG>()));
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::INTEL_CORE, std::vector<ULONG>()));
+#else
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::PERFLEVEL0, std::vector<ULONG>()));
+	procInfo.cpuSets.emplace(std::make_pair((short)CoreTypes::PERFLEVEL1, std::vector<ULONG>()));
+#endif
+#endif
+
+	//Basic CPUID Information
+	CallCPUID(LEAF_CPUID_BASIC, cpuInfo);
+
+	// Store highest function number.
+	CPUIDFunctionMax = cpuInfo[CPUID_EAX];
+
+#if HYBRIDDETECT_CPU_X86_64
+	// Read Vendor ID from CPUID
+	memcpy(procInfo.vendorID + 0, &cpuInfo[CPUID_EBX], sizeof(cpuInfo[CPUID_EBX]));
+	memcpy(procInfo.vendorID + 4, &cpuInfo[CPUID_EDX], sizeof(cpuInfo[CPUID_EDX]));
+	memcpy(procInfo.vendorID + 8, &cpuInfo[CPUID_ECX], sizeof(cpuInfo[CPUID_ECX]));
+	procInfo.vendorID[12] = '\0';
+#else
+	static const char kVendorApple[] = "Apple";
+	strcpy(procInfo.vendorID, kVendorApple);
+	procInfo.brandString[0] = 0;
+#endif
+
+	CallCPUID(1, cpuInfo);
+	procInfo.cpuid_1_eax = cpuInfo[CPUID_EAX];
+	bits = cpuInfo[CPUID_ECX];
+	procInfo.flags.SSE3 = bits[0];
+	procInfo.flags.PCLMULQDQ = bits[1];
+	procInfo.flags.SSSE3 = bits[9];
+	procInfo.flags.FMA = bits[12];
+	procInfo.flags.SSE4_1 = bits[19];
+	procInfo.flags.SSE4_2 = bits[20];
+	procInfo.flags.AES = bits[25];
+	procInfo.flags.XSAVE = bits[26];
+	procInfo.flags.OSXSAVE = bits[27];
+	procInfo.flags.AVX = bits[28];
+	procInfo.flags.F16C = bits[29];
+	procInfo.flags.RDRAND = bits[30];
+
+	if (procInfo.flags.OSXSAVE)
+	{
+		uint64_t xcr0 = XGETBV(0);
+		if (xcr0 & 0x6)
+		{
+			procInfo.flags.OS_Supports_YMM = 1;
+			if (xcr0 & 0xe0)
+			{
+				procInfo.flags.OS_Supports_ZMM = 1;
+			}
+		}
+	}
+
+	CallCPUID(LEAF_EXTENDED_FEATURE_FLAGS, cpuInfo, 0, CPUIDFunctionMax);
+	{
+		bits = cpuInfo[CPUID_EBX];
+		procInfo.flags.AVX2 = bits[5];
+		procInfo.flags.AVX512F = bits[16];
+		procInfo.flags.AVX512DQ = bits[17];
+		procInfo.flags.AVX512_IFMA = bits[21];
+		procInfo.flags.AVX512CD = bits[28];
+		procInfo.flags.AVX512BW = bits[30];
+		procInfo.flags.AVX512VL = bits[31];
+	}
+
+#if HYBRIDDETECT_CPU_X86_64
+	// Read Brand String from Extended CPUID information
+	CallCPUID(LEAF_EXTENDED_BRAND_STRING_1, cpuInfo);
+	memcpy(procInfo.brandString + 00, cpuInfo.data(), sizeof(cpuInfo));
+	CallCPUID(LEAF_EXTENDED_BRAND_STRING_2, cpuInfo);
+	memcpy(procInfo.brandString + 16, cpuInfo.data(), sizeof(cpuInfo));
+	CallCPUID(LEAF_EXTENDED_BRAND_STRING_3, cpuInfo);
+	memcpy(procInfo.brandString + 32, cpuInfo.data(), sizeof(cpuInfo));
+#elif defined(__APPLE__)
+	{
+		size_t len = sizeof(procInfo.brandString);
+		sysctlbyname("machdep.cpu.brand_string", &procInfo.brandString, &len, NULL, 0);
+	}
+#endif
+
+	// Structured Extended Feature Flags Enumeration Leaf 
+	// (Output depends on ECX input value)
+	CallCPUID(LEAF_EXTENDED_FEATURE_FLAGS, cpuInfo);
+	{
+		bits = cpuInfo[CPUID_EDX];
+#ifndef ENABLE_SOFTWARE_PROXY
+		procInfo.hybrid = bits[15];
+#else
+		procInfo.hybrid = true;
+#endif
+	}
+
+	// Thermal and Power Management Leaf
+	CallCPUID(LEAF_THERMAL_POWER, cpuInfo);
+	{
+		bits = cpuInfo[CPUID_EAX];
+		procInfo.turboBoost = bits[1];
+		procInfo.turboBoost3_0 = bits[14];
+	}
+
+	GetLogicalProcessorsEx(procInfo);
+
+#ifdef HYBRIDDETECT_OS_WIN
+	// Fill in Logical Processors, short circuit if error.
+	if (GetLogicalProcessors(procInfo))
+	{
+		HYBRID_DETECT_TRACE(5, "=== procInfo.numLogicalCores = %d, procInfo.numGroups = %d", procInfo.numLogicalCores, procInfo.numGroups);
+
+		// Query Current Frequency for each Logical Processor using CallNTPowerInformation
+		// https://docs.microsoft.com/en-us/windows/win32/api/powerbase/nf-powerbase-callntpowerinformation
+		std::vector<LOGICAL_PROCESSOR_POWER_INFORMATION> pwrInfo(procInfo.numLogicalCores);
+		DWORD size = sizeof(LOGICAL_PROCESSOR_POWER_INFORMATION) * procInfo.numLogicalCores;
+		CallNtPowerInformation(ProcessorInformation, nullptr, 0, &pwrInfo[0], size);
+
+		// Entries & processor masks follow the group order: logical processors of later groups come after the
+		// ones of earlier groups in procInfo.cores & the masks.
+		for (unsigned group = 0; group < procInfo.numGroups; group++)
+		{
+			const unsigned groupOffset = GetGroupOffset(procInfo, group);
+
+			HYBRID_DETECT_TRACE(5, "=== group = %d, procInfo.groups[group].maximumProcessorCount = %d, procInfo.groups[group].activeProcessorCount = %d", group,
+				procInfo.groups[group].maximumProcessorCount, procInfo.groups[group].activeProcessorCount);
+
+			// Enumerate each logical core. Need active or maximum processor count?
+			for (unsigned core = 0; core < procInfo.groups[group].activeProcessorCount; core++)
+			{
+#ifndef ENABLE_CPU_SETS
+				// Logical Processor Info struct for storage.
+				LOGICAL_PROCESSOR_INFO					logicalCore;
+				logicalCore.group = group;
+				logicalCore.logicalProcessorIndex = core;
+				procInfo.cores.push_back(logicalCore);
+#endif
+				procInfo.cores[groupOffset + core].processorMask = IndexToProcessorMask(groupOffset + core);
+			}
+		}
+
+		// CPUID is read on helper threads, the affinity of the calling thread is left alone.
+		ProbeLogicalProcessors(procInfo, CPUIDFunctionMax);
+
+		for (unsigned group = 0; group < procInfo.numGroups; group++)
+		{
+			const unsigned groupOffset = GetGroupOffset(procInfo, group);
+
+			for (unsigned core = 0; core < procInfo.groups[group].activeProcessorCount; core++)
+			{
+				const unsigned index = groupOffset + core;
+				LOGICAL_PROCESSOR_INFO& logicalCore = procInfo.cores[index];
+
+				HYBRID_DETECT_TRACE(5, "=== core = %d", index);
+
+				logicalCore.currentFrequency = pwrInfo[index].currentMhz;
+				logicalCore.powerInformation = pwrInfo[index];
+
+				// Heterogeneous processor clusters
+				procInfo.coreMasks[static_cast<short>(CoreTypes::ANY)] |= logicalCore.processorMask;
+
+				// Homogeneous processor clusters
+				procInfo.coreMasks[static_cast<short>(logicalCore.coreType)] |= logicalCore.processorMask;
+
+#ifdef ENABLE_CPU_SETS
+				procInfo.cpuSets[static_cast<unsigned int>(CoreTypes::ANY)].push_back(logicalCore.id);
+				procInfo.cpuSets[static_cast<unsigned int>(logicalCore.coreType)].push_back(logicalCore.id);
+#endif
+			}
+		}
+	}
+#else // HYBRIDDETECT_OS_WIN
+
+#ifdef __APPLE__
+	{
+		size_t len = sizeof(procInfo.numPhysicalCores);
+		sysctlbyname("hw.physicalcpu", &procInfo.numPhysicalCores, &len, NULL, 0);
+		len = sizeof(procInfo.numLogicalCores);
+		sysctlbyname("hw.ncpu", &procInfo.numLogicalCores, &len, NULL, 0);
+
+		bool bHybrid = false;
+		len = sizeof(int);
+		int nperflevels{};
+		sysctlbyname("hw.nperflevels", &nperflevels, &len, NULL, 0);
+		bHybrid = nperflevels > 1;
+
+		procInfo.hybrid = bHybrid;
+	}
+#endif // APPLE
+
+#ifdef HYBRIDDETECT_OS_LINUX
+#if HYBRIDDETECT_CPU_X86_64
+	ProbeLogicalProcessors(procInfo, CPUIDFunctionMax);
+#endif
+
+	for (LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		// Heterogeneous processor clusters
+		procInfo.coreMasks[static_cast<short>(CoreTypes::ANY)] |= logicalCore.processorMask;
+
+		// Homogeneous processor clusters
+		procInfo.coreMasks[static_cast<short>(logicalCore.coreType)] |= logicalCore.processorMask;
+
+#ifdef ENABLE_CPU_SETS
+		procInfo.cpuSets[static_cast<unsigned int>(CoreTypes::ANY)].push_back(logicalCore.id);
+		procInfo.cpuSets[static_cast<unsigned int>(logicalCore.coreType)].push_back(logicalCore.id);
+#endif
+	}
+#endif // HYBRIDDETECT_OS_LINUX
+#endif
+#ifndef ENABLE_SOFTWARE_PROXY
+	ClassifyCoreTypes(procInfo);
+#endif
+	UpdateModules(procInfo);
+	UpdateAllowedProcessors(procInfo);
+#endif
+	HYBRID_DETECT_TRACE(7, "<<< ");
+}
+
+// Injects the topology described by HYBRIDDETECT_TOPOLOGY into an enumerated procInfo, when set.
+inline bool ApplyTopologyEnvironment(PROCESSOR_INFO& procInfo)
+{
+#ifdef ENABLE_HYBRID_DETECT
+	std::string topology;
+	if (!GetTopologyEnvironment(topology)) return false;
+
+	if (InjectTopology(procInfo, topology.c_str())) return true;
+
+	HYBRID_DETECT_TRACE(1, "=== invalid %s: %s", HYBRIDDETECT_TOPOLOGY_ENVIRONMENT, topology.c_str());
+#else
+	(void)procInfo;
+#endif
+	return false;
+}
+
+// Fills in PROCESSOR_INFO with the topology of the running system (EnumerateProcessorInfo), or the synthetic
+// one described by HYBRIDDETECT_TOPOLOGY.
+inline void GetProcessorInfo(PROCESSOR_INFO& procInfo)
+{
+	EnumerateProcessorInfo(procInfo);
+	ApplyTopologyEnvironment(procInfo);
+}
+
+// Topology snapshots: PROCESSOR_INFO serialized field by field so processes that restart often can skip
+// GetProcessorInfo (and its migration across every logical processor) when the system has not changed.
+#define HYBRIDDETECT_SNAPSHOT_MAGIC				0x53544448  // "HDTS"
+#define HYBRIDDETECT_SNAPSHOT_VERSION			3
+
+// Build options changing the layout of PROCESSOR_INFO, a snapshot is only loaded by a matching build.
+#define HYBRIDDETECT_SNAPSHOT_BUILD_PER_LOGICAL_ISA	0x1
+#define HYBRIDDETECT_SNAPSHOT_BUILD_CPU_SETS		0x2
+#define HYBRIDDETECT_SNAPSHOT_BUILD_X86_64			0x4
+
+inline unsigned GetSnapshotBuildFlags()
+{
+	unsigned buildFlags = 0;
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+	buildFlags |= HYBRIDDETECT_SNAPSHOT_BUILD_PER_LOGICAL_ISA;
+#endif
+#ifdef ENABLE_CPU_SETS
+	buildFlags |= HYBRIDDETECT_SNAPSHOT_BUILD_CPU_SETS;
+#endif
+#if HYBRIDDETECT_CPU_X86_64
+	buildFlags |= HYBRIDDETECT_SNAPSHOT_BUILD_X86_64;
+#endif
+	return buildFlags;
+}
+
+// Cheap identification of the running system, checked before a snapshot is trusted.
+typedef struct _PROCESSOR_FINGERPRINT
+{
+	unsigned							cpuid_1_eax = 0;
+	char								brandString[64] = {};
+	ProcessorMask						online; // Online/active logical processors
+} PROCESSOR_FINGERPRINT, * PPROCESSOR_FINGERPRINT;
+
+inline bool operator==(const PROCESSOR_FINGERPRINT& a, const PROCESSOR_FINGERPRINT& b)
+{
+	return a.cpuid_1_eax == b.cpuid_1_eax &&
+		!strncmp(a.brandString, b.brandString, sizeof(a.brandString)) &&
+		a.online == b.online;
+}
+
+inline bool operator!=(const PROCESSOR_FINGERPRINT& a, const PROCESSOR_FINGERPRINT& b)
+{
+	return !(a == b);
+}
+
+// Reads the fingerprint without enumerating the topology or moving the calling thread.
+inline void GetProcessorFingerprint(PROCESSOR_FINGERPRINT& fingerprint)
+{
+	HYBRID_DETECT_TRACE(7, ">>>");
+	fingerprint = PROCESSOR_FINGERPRINT();
+
+#if HYBRIDDETECT_CPU_X86_64
+	std::array<unsigned, 4>  cpuInfo{}; // zero-init
+
+	CallCPUID(1, cpuInfo);
+	fingerprint.cpuid_1_eax = cpuInfo[CPUID_EAX];
+
+	CallCPUID(LEAF_EXTENDED_BRAND_STRING_1, cpuInfo);
+	memcpy(fingerprint.brandString + 00, cpuInfo.data(), sizeof(cpuInfo));
+	CallCPUID(LEAF_EXTENDED_BRAND_STRING_2, cpuInfo);
+	memcpy(fingerprint.brandString + 16, cpuInfo.data(), sizeof(cpuInfo));
+	CallCPUID(LEAF_EXTENDED_BRAND_STRING_3, cpuInfo);
+	memcpy(fingerprint.brandString + 32, cpuInfo.data(), sizeof(cpuInfo));
+#elif defined(__APPLE__)
+	{
+		size_t len = sizeof(fingerprint.brandString);
+		sysctlbyname("machdep.cpu.brand_string", &fingerprint.brandString, &len, NULL, 0);
+	}
+#endif
+
+#if defined(HYBRIDDETECT_OS_WIN)
+	// Active processors of every group, numbered like PROCESSOR_INFO masks (see GetGroupOffset).
+	unsigned groupOffset = 0;
+
+	for (EnumLogicalProcessorInformation enumInfo(RelationGroup);
+		auto pinfo = enumInfo.Current(); enumInfo.MoveNext()) {
+		for (WORD group = 0; group < pinfo->Group.ActiveGroupCount; group++)
+		{
+			const PROCESSOR_GROUP_INFO& groupInfo = pinfo->Group.GroupInfo[group];
+
+			for (unsigned bit = 0; bit < 64; bit++)
+			{
+				if (groupInfo.ActiveProcessorMask & static_cast<KAFFINITY>(IndexToMask(bit))) fingerprint.online.Set(groupOffset + bit);
+			}
+			groupOffset += groupInfo.ActiveProcessorCount;
+		}
+	}
+#elif defined(HYBRIDDETECT_OS_LINUX)
+	std::vector<unsigned> online;
+
+	if (ReadSysfsCPUList("/sys/devices/system/cpu/online", online))
+	{
+		fingerprint.online = CPUListToMask(online);
+	}
+#elif defined(__APPLE__)
+	{
+		int ncpu = 0;
+		size_t len = sizeof(ncpu);
+		sysctlbyname("hw.ncpu", &ncpu, &len, NULL, 0);
+
+		for (int cpu = 0; cpu < ncpu; cpu++) fingerprint.online.Set(cpu);
+	}
+#endif
+	HYBRID_DETECT_TRACE(7, "<<< ");
+}
+
+// Minimal append-only writer used by SaveProcessorInfo, values are stored in native byte order.
+class SnapshotWriter
+{
+public:
+	SnapshotWriter(std::vector<unsigned char>& buffer) : m_buffer(buffer) {}
+
+	template<typename T>
+	void Write(const T& value)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&value);
+		m_buffer.insert(m_buffer.end(), bytes, bytes + sizeof(T));
+	}
+
+	void WriteBytes(const void* data, size_t size)
+	{
+		const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data);
+		m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+	}
+
+	void WriteMask(const ProcessorMask& mask)
+	{
+		Write<unsigned>(mask.WordCount());
+		for (unsigned word = 0; word < mask.WordCount(); word++) Write<ULONG64>(mask.Word(word));
+	}
+
+private:
+	std::vector<unsigned char>& m_buffer;
+};
+
+// Bounds checked reader used by LoadProcessorInfo, any read past the end marks the snapshot invalid.
+class SnapshotReader
+{
+public:
+	SnapshotReader(const unsigned char* data, size_t size) : m_data(data), m_size(size), m_offset(0), m_valid(data != nullptr) {}
+
+	template<typename T>
+	T Read()
+	{
+		T value{};
+		ReadBytes(&value, sizeof(T));
+		return value;
+	}
+
+	void ReadBytes(void* data, size_t size)
+	{
+		if (!m_valid || size > m_size - m_offset)
+		{
+			m_valid = false;
+			return;
+		}
+		memcpy(data, m_data + m_offset, size);
+		m_offset += size;
+	}
+
+	ProcessorMask ReadMask()
+	{
+		ProcessorMask mask;
+		const unsigned wordCount = ReadCount(sizeof(ULONG64));
+
+		for (unsigned word = 0; word < wordCount; word++)
+		{
+			const ULONG64 bits = Read<ULONG64>();
+
+			for (unsigned bit = 0; bits && bit < 64; bit++)
+			{
+				if (bits & IndexToMask(bit)) mask.Set(word * 64 + bit);
+			}
+		}
+		return mask;
+	}
+
+	// Element count of a following array, rejected when the remaining bytes cannot hold it.
+	unsigned ReadCount(size_t elementSize)
+	{
+		const unsigned count = Read<unsigned>();
+		if (m_valid && elementSize && count > (m_size - m_offset) / elementSize) m_valid = false;
+		return m_valid ? count : 0;
+	}
+
+	bool Valid() const { return m_valid; }
+	bool AtEnd() const { return m_offset == m_size; }
+
+private:
+	const unsigned char*	m_data;
+	size_t					m_size;
+	size_t					m_offset;
+	bool					m_valid;
+};
+
+// Bit-fields of LOGICAL_PROCESSOR_INFO packed in declaration order.
+inline ULONG64 PackLogicalProcessorFlags(const LOGICAL_PROCESSOR_INFO& logicalCore)
+{
+	const unsigned fields[] = {
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+		logicalCore.SSE, logicalCore.AVX, logicalCore.AVX2, logicalCore.AVX512, logicalCore.AVX512F,
+		logicalCore.AVX512DQ, logicalCore.AVX512PF, logicalCore.AVX512ER, logicalCore.AVX512CD,
+		logicalCore.AVX512BW, logicalCore.AVX512VL, logicalCore.AVX512_IFMA, logicalCore.AVX512_VBMI,
+		logicalCore.AVX512_VBMI2, logicalCore.AVX512_VNNI, logicalCore.AVX512_BITALG,
+		logicalCore.AVX512_VPOPCNTDQ, logicalCore.AVX512_4VNNIW, logicalCore.AVX512_4FMAPS,
+		logicalCore.AVX512_VP2INTERSECT, logicalCore.SGX, logicalCore.SHA,
+#endif
+		logicalCore.parked, logicalCore.allocated, logicalCore.allocatedToTargetProcess, logicalCore.realTime,
+		logicalCore.probed
+	};
+	ULONG64 packed = 0;
+
+	for (unsigned i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+	{
+		if (fields[i]) packed |= IndexToMask(i);
+	}
+	return packed;
+}
+
+inline void UnpackLogicalProcessorFlags(LOGICAL_PROCESSOR_INFO& logicalCore, ULONG64 packed)
+{
+	unsigned i = 0;
+	auto next = [&]() { return (packed & IndexToMask(i++)) ? 1u : 0u; };
+
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+	logicalCore.SSE = next();
+	logicalCore.AVX = next();
+	logicalCore.AVX2 = next();
+	logicalCore.AVX512 = next();
+	logicalCore.AVX512F = next();
+	logicalCore.AVX512DQ = next();
+	logicalCore.AVX512PF = next();
+	logicalCore.AVX512ER = next();
+	logicalCore.AVX512CD = next();
+	logicalCore.AVX512BW = next();
+	logicalCore.AVX512VL = next();
+	logicalCore.AVX512_IFMA = next();
+	logicalCore.AVX512_VBMI = next();
+	logicalCore.AVX512_VBMI2 = next();
+	logicalCore.AVX512_VNNI = next();
+	logicalCore.AVX512_BITALG = next();
+	logicalCore.AVX512_VPOPCNTDQ = next();
+	logicalCore.AVX512_4VNNIW = next();
+	logicalCore.AVX512_4FMAPS = next();
+	logicalCore.AVX512_VP2INTERSECT = next();
+	logicalCore.SGX = next();
+	logicalCore.SHA = next();
+#endif
+	logicalCore.parked = next();
+	logicalCore.allocated = next();
+	logicalCore.allocatedToTargetProcess = next();
+	logicalCore.realTime = next();
+	logicalCore.probed = next();
+}
+
+// Serializes procInfo together with the fingerprint of the system it was enumerated on.
+inline void SaveProcessorInfo(const PROCESSOR_INFO& procInfo, const PROCESSOR_FINGERPRINT& fingerprint, std::vector<unsigned char>& buffer)
+{
+	SnapshotWriter writer(buffer);
+
+	buffer.clear();
+
+	writer.Write<unsigned>(HYBRIDDETECT_SNAPSHOT_MAGIC);
+	writer.Write<unsigned>(HYBRIDDETECT_SNAPSHOT_VERSION);
+	writer.Write<unsigned>(GetSnapshotBuildFlags());
+
+	writer.Write<unsigned>(fingerprint.cpuid_1_eax);
+	writer.WriteBytes(fingerprint.brandString, sizeof(fingerprint.brandString));
+	writer.WriteMask(fingerprint.online);
+
+	writer.WriteBytes(procInfo.vendorID, sizeof(procInfo.vendorID));
+	writer.WriteBytes(procInfo.brandString, sizeof(procInfo.brandString));
+	writer.Write<unsigned>(procInfo.numGroups);
+	writer.Write<unsigned>(procInfo.numNUMANodes);
+	writer.Write<unsigned>(procInfo.numProcessorPackages);
+	writer.Write<unsigned>(procInfo.numPhysicalCores);
+	writer.Write<unsigned>(procInfo.numLogicalCores);
+	writer.Write<unsigned>(procInfo.numL1Caches);
+	writer.Write<unsigned>(procInfo.numL2Caches);
+	writer.Write<unsigned>(procInfo.numL3Caches);
+	writer.Write<unsigned char>(procInfo.hybrid);
+	writer.Write<unsigned char>(procInfo.turboBoost);
+	writer.Write<unsigned char>(procInfo.turboBoost3_0);
+	writer.Write<unsigned>(procInfo.cpuid_1_eax);
+	writer.Write<std::uint64_t>(procInfo.flagsUI64);
+
+	writer.Write<unsigned>((unsigned)procInfo.groups.size());
+	for (const GROUP_INFO& group : procInfo.groups)
+	{
+		writer.Write<unsigned>(group.activeGroupCount);
+		writer.Write<unsigned>(group.maximumGroupCount);
+		writer.Write<unsigned>(group.activeProcessorCount);
+		writer.Write<unsigned>(group.maximumProcessorCount);
+		writer.Write<ULONG64>(group.activeProcessorMask);
+	}
+
+	writer.Write<unsigned>((unsigned)procInfo.nodes.size());
+	for (const NUMA_NODE_INFO& node : procInfo.nodes)
+	{
+		writer.Write<unsigned>(node.nodeNumber);
+		writer.Write<unsigned>(node.group);
+		writer.WriteMask(node.mask);
+	}
+
+	writer.Write<unsigned>((unsigned)procInfo.caches.size());
+	for (const CACHE_INFO& cache : procInfo.caches)
+	{
+		writer.Write<unsigned>(cache.group);
+		writer.WriteMask(cache.processorMask);
+		writer.Write<unsigned>(cache.level);
+		writer.Write<unsigned>(cache.size);
+		writer.Write<unsigned>(cache.lineSize);
+		writer.Write<unsigned>(cache.type);
+		writer.Write<unsigned>(cache.associativity);
+	}
+
+	writer.Write<unsigned>((unsigned)procInfo.cores.size());
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		writer.Write<unsigned>(logicalCore.id);
+		writer.Write<unsigned>(logicalCore.group);
+		writer.Write<unsigned>(logicalCore.node);
+		writer.Write<unsigned>(logicalCore.coreIndex);
+		writer.Write<unsigned>(logicalCore.logicalProcessorIndex);
+		writer.WriteMask(logicalCore.processorMask);
+		writer.Write<unsigned>(logicalCore.baseFrequency);
+		writer.Write<unsigned>(logicalCore.currentFrequency);
+		writer.Write<unsigned>(logicalCore.maximumFrequency);
+		writer.Write<unsigned>(logicalCore.busFrequency);
+		writer.Write<ULONG64>(PackLogicalProcessorFlags(logicalCore));
+		writer.Write<ULONG64>(logicalCore.allocationTag);
+		writer.Write<unsigned>(logicalCore.efficiencyClass);
+		writer.Write<unsigned>(logicalCore.schedulingClass);
+		writer.Write<int>((int)logicalCore.coreType);
+		writer.Write<LOGICAL_PROCESSOR_POWER_INFORMATION>(logicalCore.powerInformation);
+	}
+
+	writer.Write<unsigned>((unsigned)procInfo.coreMasks.size());
+	for (const auto& coreMask : procInfo.coreMasks)
+	{
+		writer.Write<short>(coreMask.first);
+		writer.WriteMask(coreMask.second);
+	}
+
+#ifdef ENABLE_CPU_SETS
+	writer.Write<unsigned>((unsigned)procInfo.cpuSets.size());
+	for (const auto& cpuSet : procInfo.cpuSets)
+	{
+		writer.Write<unsigned>(cpuSet.first);
+		writer.Write<unsigned>((unsigned)cpuSet.second.size());
+		for (ULONG id : cpuSet.second) writer.Write<ULONG>(id);
+	}
+#endif
+
+	writer.Write<unsigned>((unsigned)procInfo.scores.size());
+	for (const CORE_TYPE_SCORE& score : procInfo.scores)
+	{
+		writer.Write<int>(static_cast<int>(score.coreType));
+		for (double value : score.score) writer.Write<double>(value);
+	}
+}
+
+// Restores a snapshot written by SaveProcessorInfo. Fails on a truncated or foreign snapshot, or when
+// expected (e.g. from GetProcessorFingerprint) does not match the fingerprint the snapshot was taken on.
+// procInfo is only modified on success.
+inline bool LoadProcessorInfo(PROCESSOR_INFO& procInfo, const unsigned char* data, size_t size, const PROCESSOR_FINGERPRINT* expected = nullptr)
+{
+	HYBRID_DETECT_TRACE(7, ">>>");
+	SnapshotReader reader(data, size);
+
+	if (reader.Read<unsigned>() != HYBRIDDETECT_SNAPSHOT_MAGIC ||
+		reader.Read<unsigned>() != HYBRIDDETECT_SNAPSHOT_VERSION ||
+		reader.Read<unsigned>() != GetSnapshotBuildFlags() ||
+		!reader.Valid())
+	{
+		HYBRID_DETECT_TRACE(5, "=== not a compatible snapshot");
+		return false;
+	}
+
+	PROCESSOR_FINGERPRINT fingerprint;
+	fingerprint.cpuid_1_eax = reader.Read<unsigned>();
+	reader.ReadBytes(fingerprint.brandString, sizeof(fingerprint.brandString));
+	fingerprint.online = reader.ReadMask();
+
+	if (!reader.Valid() || (expected && *expected != fingerprint))
+	{
+		HYBRID_DETECT_TRACE(5, "=== snapshot fingerprint mismatch");
+		return false;
+	}
+
+	PROCESSOR_INFO snapshot;
+
+	reader.ReadBytes(snapshot.vendorID, sizeof(snapshot.vendorID));
+	reader.ReadBytes(snapshot.brandString, sizeof(snapshot.brandString));
+	snapshot.vendorID[sizeof(snapshot.vendorID) - 1] = '\0';
+	snapshot.brandString[sizeof(snapshot.brandString) - 1] = '\0';
+	snapshot.numGroups = reader.Read<unsigned>();
+	snapshot.numNUMANodes = reader.Read<unsigned>();
+	snapshot.numProcessorPackages = reader.Read<unsigned>();
+	snapshot.numPhysicalCores = reader.Read<unsigned>();
+	snapshot.numLogicalCores = reader.Read<unsigned>();
+	snapshot.numL1Caches = reader.Read<unsigned>();
+	snapshot.numL2Caches = reader.Read<unsigned>();
+	snapshot.numL3Caches = reader.Read<unsigned>();
+	snapshot.hybrid = reader.Read<unsigned char>() != 0;
+	snapshot.turboBoost = reader.Read<unsigned char>() != 0;
+	snapshot.turboBoost3_0 = reader.Read<unsigned char>() != 0;
+	snapshot.cpuid_1_eax = reader.Read<unsigned>();
+	snapshot.flagsUI64 = reader.Read<std::uint64_t>();
+
+	snapshot.groups.resize(reader.ReadCount(sizeof(unsigned) * 4 + sizeof(ULONG64)));
+	for (GROUP_INFO& group : snapshot.groups)
+	{
+		group.activeGroupCount = reader.Read<unsigned>();
+		group.maximumGroupCount = reader.Read<unsigned>();
+		group.activeProcessorCount = reader.Read<unsigned>();
+		group.maximumProcessorCount = reader.Read<unsigned>();
+		group.activeProcessorMask = reader.Read<ULONG64>();
+	}
+
+	snapshot.nodes.resize(reader.ReadCount(sizeof(unsigned) * 3));
+	for (NUMA_NODE_INFO& node : snapshot.nodes)
+	{
+		node.nodeNumber = reader.Read<unsigned>();
+		node.group = reader.Read<unsigned>();
+		node.mask = reader.ReadMask();
+	}
+
+	snapshot.caches.resize(reader.ReadCount(sizeof(unsigned) * 7));
+	for (CACHE_INFO& cache : snapshot.caches)
+	{
+		cache.group = reader.Read<unsigned>();
+		cache.processorMask = reader.ReadMask();
+		cache.level = reader.Read<unsigned>();
+		cache.size = reader.Read<unsigned>();
+		cache.lineSize = reader.Read<unsigned>();
+		cache.type = reader.Read<unsigned>();
+		cache.associativity = reader.Read<unsigned>();
+	}
+
+	snapshot.cores.resize(reader.ReadCount(sizeof(unsigned) * 10));
+	for (LOGICAL_PROCESSOR_INFO& logicalCore : snapshot.cores)
+	{
+		logicalCore.id = reader.Read<unsigned>();
+		logicalCore.group = reader.Read<unsigned>();
+		logicalCore.node = reader.Read<unsigned>();
+		logicalCore.coreIndex = reader.Read<unsigned>();
+		logicalCore.logicalProcessorIndex = reader.Read<unsigned>();
+		logicalCore.processorMask = reader.ReadMask();
+		logicalCore.baseFrequency = reader.Read<unsigned>();
+		logicalCore.currentFrequency = reader.Read<unsigned>();
+		logicalCore.maximumFrequency = reader.Read<unsigned>();
+		logicalCore.busFrequency = reader.Read<unsigned>();
+		UnpackLogicalProcessorFlags(logicalCore, reader.Read<ULONG64>());
+		logicalCore.allocationTag = reader.Read<ULONG64>();
+		logicalCore.efficiencyClass = reader.Read<unsigned>();
+		logicalCore.schedulingClass = reader.Read<unsigned>();
+		logicalCore.coreType = static_cast<CoreTypes>(reader.Read<int>());
+		logicalCore.powerInformation = reader.Read<LOGICAL_PROCESSOR_POWER_INFORMATION>();
+	}
+
+	for (unsigned i = reader.ReadCount(sizeof(short) + sizeof(unsigned)); i > 0; i--)
+	{
+		const short coreType = reader.Read<short>();
+		snapshot.coreMasks[coreType] = reader.ReadMask();
+	}
+
+#ifdef ENABLE_CPU_SETS
+	for (unsigned i = reader.ReadCount(sizeof(unsigned) * 2); i > 0; i--)
+	{
+		std::vector<ULONG>& cpuSet = snapshot.cpuSets[reader.Read<unsigned>()];
+		cpuSet.resize(reader.ReadCount(sizeof(ULONG)));
+		for (ULONG& id : cpuSet) id = reader.Read<ULONG>();
+	}
+#endif
+
+	snapshot.scores.resize(reader.ReadCount(sizeof(int) + sizeof(double) * CALIBRATION_KERNEL_COUNT));
+	for (CORE_TYPE_SCORE& score : snapshot.scores)
+	{
+		score.coreType = static_cast<CoreTypes>(reader.Read<int>());
+		for (double& value : score.score) value = reader.Read<double>();
+	}
+
+	if (!reader.Valid() || !reader.AtEnd())
+	{
+		HYBRID_DETECT_TRACE(5, "=== truncated or corrupt snapshot");
+		return false;
+	}
+
+	procInfo = snapshot;
+	UpdateModules(procInfo);
+	HYBRID_DETECT_TRACE(7, "<<< ");
+	return true;
+}
+
+inline bool SaveProcessorInfo(const PROCESSOR_INFO& procInfo, const PROCESSOR_FINGERPRINT& fingerprint, const char* path)
+{
+	std::vector<unsigned char> buffer;
+	SaveProcessorInfo(procInfo, fingerprint, buffer);
+
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	file.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+	return file.good();
+}
+
+inline bool LoadProcessorInfo(PROCESSOR_INFO& procInfo, const char* path, const PROCESSOR_FINGERPRINT* expected = nullptr)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file) return false;
+
+	std::vector<unsigned char> buffer((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return LoadProcessorInfo(procInfo, buffer.data(), buffer.size(), expected);
+}
+
+inline bool CalibrateCoreTypes(PROCESSOR_INFO& procInfo, unsigned durationUs = 2000);
+
+// GetProcessorInfo backed by a snapshot file: the snapshot is used when its fingerprint matches the running
+// system, otherwise the topology is enumerated and the snapshot (re)written. Returns true on a snapshot hit.
+// Frequencies & power information in a snapshot are those at enumeration time, see UpdateProcessorInfo.
+// With calibrate, core types are calibrated (CalibrateCoreTypes) unless the snapshot already holds scores.
+// Snapshots only hold the enumerated topology, HYBRIDDETECT_TOPOLOGY is injected after loading/saving.
+inline bool GetProcessorInfoCached(PROCESSOR_INFO& procInfo, const char* path, bool calibrate = false)
+{
+	HYBRID_DETECT_TRACE(7, ">>>");
+	PROCESSOR_FINGERPRINT fingerprint;
+	GetProcessorFingerprint(fingerprint);
+
+	if (path && LoadProcessorInfo(procInfo, path, &fingerprint))
+	{
+		// Affinity & quota belong to this process, not to the snapshot.
+		UpdateAllowedProcessors(procInfo);
+
+		if (calibrate && procInfo.scores.empty() && CalibrateCoreTypes(procInfo))
+		{
+			SaveProcessorInfo(procInfo, fingerprint, path);
+		}
+		ApplyTopologyEnvironment(procInfo);
+		HYBRID_DETECT_TRACE(7, "<<< snapshot");
+		return true;
+	}
+
+	EnumerateProcessorInfo(procInfo);
+	if (calibrate) CalibrateCoreTypes(procInfo);
+
+	if (path) SaveProcessorInfo(procInfo, fingerprint, path);
+	ApplyTopologyEnvironment(procInfo);
+
+	HYBRID_DETECT_TRACE(7, "<<< enumerated");
+	return false;
+}
+
+// Instruction set levels a kernel can be specialized for, from least to most capable.
+enum ISALevel
+{
+	ISA_SCALAR = 0,
+	ISA_SSE4 = 1,	// SSE4.1 & SSE4.2 (& SSSE3)
+	ISA_AVX2 = 2,	// AVX2 & FMA with OS YMM state support
+	ISA_AVX512 = 3,	// AVX-512 F/CD/BW/DQ/VL (Skylake-X) with OS ZMM state support
+	ISA_COUNT
+};
+
+inline const char* ISALevelString(ISALevel level)
+{
+	switch (level)
+	{
+	case ISA_SSE4:
+		return "SSE4";
+	case ISA_AVX2:
+		return "AVX2";
+	case ISA_AVX512:
+		return "AVX-512";
+	default:
+		return "Scalar";
+	}
+}
+
+// Highest ISALevel usable with the given feature flags (CPU & OS support).
+inline ISALevel GetISALevel(const FeatureFlags& flags)
+{
+#if HYBRIDDETECT_CPU_X86_64
+	if (flags.AVX2_Supported() && flags.FMA && flags.AVX512_SKX_Supported()) return ISA_AVX512;
+	if (flags.AVX2_Supported() && flags.FMA) return ISA_AVX2;
+	if (flags.SSSE3 && flags.SSE4_1 && flags.SSE4_2) return ISA_SSE4;
+#else
+	(void)flags;
+#endif
+	return ISA_SCALAR;
+}
+
+// Number of ISA bits leading the PackLogicalProcessorFlags layout.
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+#define HYBRIDDETECT_ISA_FEATURE_BITS			22
+#else
+#define HYBRIDDETECT_ISA_FEATURE_BITS			0
+#endif
+
+// ISA level of one logical processor: the FeatureFlags read on the calling thread (SSE4, FMA, OS state support)
+// narrowed by the AVX2/AVX-512 bits read on that logical processor under ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION.
+inline ISALevel GetISALevel(const PROCESSOR_INFO& procInfo, const LOGICAL_PROCESSOR_INFO& logicalCore)
+{
+	ISALevel level = GetISALevel(procInfo.flags);
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+	if (level >= ISA_AVX512 && !(logicalCore.AVX512F && logicalCore.AVX512CD && logicalCore.AVX512BW && logicalCore.AVX512DQ && logicalCore.AVX512VL))
+	{
+		level = ISA_AVX2;
+	}
+	if (level >= ISA_AVX2 && !logicalCore.AVX2)
+	{
+		level = ISA_SSE4;
+	}
+#else
+	(void)logicalCore;
+#endif
+	return level;
+}
+
+// ISA support common to a set of logical processors: code limited to it may migrate freely between them.
+typedef struct _ISA_CAPABILITIES
+{
+	ISALevel							level = ISA_SCALAR;
+	ULONG64								features = 0;	// Per logical processor ISA bits, PackLogicalProcessorFlags layout
+	unsigned							count = 0;		// Logical processors in the set
+} ISA_CAPABILITIES, * PISA_CAPABILITIES;
+
+// Common denominator of the logical processors matching filter(logicalCore) this process may run on. Logical
+// processors the probe could not pin to (outside the cpuset or affinity) have no per logical ISA bits, and are
+// skipped rather than counted as lacking every extension.
+template<typename F>
+inline ISA_CAPABILITIES GetISACapabilities(const PROCESSOR_INFO& procInfo, F filter)
+{
+	ISA_CAPABILITIES capabilities;
+	capabilities.level = ISA_AVX512;
+	capabilities.features = (1ULL << HYBRIDDETECT_ISA_FEATURE_BITS) - 1;
+
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		if (!filter(logicalCore)) continue;
+		if (procInfo.allowedMask.Any() && !logicalCore.processorMask.Intersects(procInfo.allowedMask)) continue;
+#if ENABLE_PER_LOGICAL_CPUID_ISA_DETECTION
+		if (!logicalCore.probed) continue;
+#endif
+
+		const ISALevel level = GetISALevel(procInfo, logicalCore);
+		if (level < capabilities.level) capabilities.level = level;
+
+		capabilities.features &= PackLogicalProcessorFlags(logicalCore);
+		capabilities.count++;
+	}
+
+	if (capabilities.count == 0)
+	{
+		capabilities = ISA_CAPABILITIES();
+	}
+	return capabilities;
+}
+
+// ISA common denominator of a core type, ANY for the whole system.
+inline ISA_CAPABILITIES GetCoreTypeISA(const PROCESSOR_INFO& procInfo, CoreTypes coreType)
+{
+	return GetISACapabilities(procInfo, [coreType](const LOGICAL_PROCESSOR_INFO& logicalCore)
+	{
+		return coreType == CoreTypes::ANY || logicalCore.coreType == coreType;
+	});
+}
+
+// ISA common denominator of a cluster of logical processors, e.g. CACHE_INFO::processorMask of an L2.
+inline ISA_CAPABILITIES GetClusterISA(const PROCESSOR_INFO& procInfo, const ProcessorMask& cluster)
+{
+	return GetISACapabilities(procInfo, [&cluster](const LOGICAL_PROCESSOR_INFO& logicalCore)
+	{
+		return logicalCore.processorMask.Intersects(cluster);
+	});
+}
+
+// Function attributes for variants compiled in a translation unit built for a lower ISA (GCC/Clang).
+// MSVC emits any intrinsic regardless of /arch, the macros are empty there.
+#if defined(__GNUC__) && HYBRIDDETECT_CPU_X86_64
+#define HYBRIDDETECT_TARGET_SSE4		__attribute__((target("ssse3,sse4.1,sse4.2")))
+#define HYBRIDDETECT_TARGET_AVX2		__attribute__((target("avx2,fma")))
+#define HYBRIDDETECT_TARGET_AVX512		__attribute__((target("avx512f,avx512cd,avx512bw,avx512dq,avx512vl")))
+#else
+#define HYBRIDDETECT_TARGET_SSE4
+#define HYBRIDDETECT_TARGET_AVX2
+#define HYBRIDDETECT_TARGET_AVX512
+#endif
+
+// Function multiversioning: a kernel registers a scalar implementation plus optional SSE4/AVX2/AVX-512 variants
+// and calls through a function pointer resolved once from PROCESSOR_INFO::flags.
+//
+//	static ISADispatch<void(*)(float*, size_t)> gNoise(NoiseScalar);
+//	gNoise.Register(ISA_AVX2, NoiseAVX2).Register(ISA_AVX512, NoiseAVX512);
+//	gNoise.Resolve(procInfo);
+//	gNoise(data, count);
+//
+// Register variants before resolving. Resolve/Get/calls are thread-safe and lock-free.
+template<typename F>
+class ISADispatch
+{
+public:
+	explicit ISADispatch(F scalar)
+	{
+		for (unsigned level = 0; level < ISA_COUNT; level++) m_variants[level] = nullptr;
+		m_variants[ISA_SCALAR] = scalar;
+		m_resolved.store(nullptr, std::memory_order_relaxed);
+	}
+
+	ISADispatch& Register(ISALevel level, F variant)
+	{
+		if (level < ISA_COUNT) m_variants[level] = variant;
+		return *this;
+	}
+
+	// Most capable registered variant not above level.
+	F Select(ISALevel level) const
+	{
+		for (int candidate = level < ISA_COUNT ? level : ISA_COUNT - 1; candidate >= 0; candidate--)
+		{
+			if (m_variants[candidate]) return m_variants[candidate];
+		}
+		return nullptr;
+	}
+
+	// Resolves & caches the variant every logical processor of the system supports, threads may migrate
+	// between core types. Use Select(GetCoreTypeISA(procInfo, type).level) for work pinned to one core type.
+	F Resolve(const PROCESSOR_INFO& procInfo)
+	{
+		F resolved = m_resolved.load(std::memory_order_acquire);
+
+		if (!resolved)
+		{
+			const ISALevel level = procInfo.cores.empty() ? GetISALevel(procInfo.flags) : GetCoreTypeISA(procInfo, CoreTypes::ANY).level;
+			resolved = Select(level);
+			m_resolved.store(resolved, std::memory_order_release);
+		}
+		return resolved;
+	}
+
+	// Cached variant, the scalar implementation until Resolve has been called.
+	F Get() const
+	{
+		F resolved = m_resolved.load(std::memory_order_acquire);
+		return resolved ? resolved : m_variants[ISA_SCALAR];
+	}
+
+	// Forgets the cached variant, e.g. to resolve again against other (test) feature flags.
+	void Reset() { m_resolved.store(nullptr, std::memory_order_release); }
+
+	template<typename... Args>
+	auto operator()(Args&&... args) const -> decltype(std::declval<F>()(std::forward<Args>(args)...))
+	{
+		return Get()(std::forward<Args>(args)...);
+	}
+
+private:
+	F				m_variants[ISA_COUNT];
+	std::atomic<F>	m_resolved;
+};
+
+// Read-only view over contiguous storage owned by a TopologyIndex (C++14 has no std::span).
+template<typename T>
+class TopologySpan
+{
+public:
+	TopologySpan() : m_data(nullptr), m_size(0) {}
+	TopologySpan(const T* data, size_t size) : m_data(data), m_size(size) {}
+
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+	const T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	const T& operator[](size_t index) const { return m_data[index]; }
+
+private:
+	const T*	m_data;
+	size_t		m_size;
+};
+
+// Flat, immutable view of PROCESSOR_INFO for placement queries on hot paths.
+// Logical processors are addressed by their index in procInfo.cores ("cpu" below). Every relation
+// (cpu -> core -> L2 cluster -> L3 cluster -> NUMA node -> core type) is precomputed into contiguous
+// arrays, members of a core/cluster/node/type are stored CSR style (offsets + cpu list).
+// Build once after GetProcessorInfo; all queries are const, O(1) and allocation-free, so a built
+// index can be read from any number of threads without synchronization.
+class TopologyIndex
+{
+public:
+	enum : unsigned { INVALID = 0xffffffff };
+
+	TopologyIndex() {}
+	explicit TopologyIndex(const PROCESSOR_INFO& procInfo) { Build(procInfo); }
+
+	unsigned CPUCount() const { return static_cast<unsigned>(m_cpuCore.size()); }
+	unsigned CoreCount() const { return m_cores.Count(); }
+	unsigned L2Count() const { return m_l2s.Count(); }
+	unsigned L3Count() const { return m_l3s.Count(); }
+	unsigned NodeCount() const { return m_nodes.Count(); }
+
+	// Per logical processor relations, INVALID when the relation is unknown (e.g. no L3).
+	unsigned Core(unsigned cpu) const { return cpu < CPUCount() ? m_cpuCore[cpu] : INVALID; }
+	unsigned L2(unsigned cpu) const { return cpu < CPUCount() ? m_cpuL2[cpu] : INVALID; }
+	unsigned L3(unsigned cpu) const { return cpu < CPUCount() ? m_cpuL3[cpu] : INVALID; }
+	unsigned Node(unsigned cpu) const { return cpu < CPUCount() ? m_cpuNode[cpu] : INVALID; }
+	CoreTypes Type(unsigned cpu) const { return cpu < CPUCount() ? m_cpuType[cpu] : CoreTypes::NONE; }
+
+	// CPU Set ID (Windows) / OS CPU number (Linux) of a logical processor, as stored in procInfo.cpuSets.
+	ULONG CPUSetID(unsigned cpu) const { return cpu < CPUCount() ? m_cpuSetID[cpu] : static_cast<ULONG>(INVALID); }
+
+	// Logical processor for a system wide processor number (ProcessorMask bit, see GetProcessorNumber).
+	unsigned CPUFromProcessorNumber(unsigned number) const { return number < m_processorNumberCPU.size() ? m_processorNumberCPU[number] : INVALID; }
+
+	// Members of a core, cluster, node or core type.
+	TopologySpan<unsigned> CoreCPUs(unsigned core) const { return m_cores.Members(core); }
+	TopologySpan<unsigned> L2CPUs(unsigned l2) const { return m_l2s.Members(l2); }
+	TopologySpan<unsigned> L3CPUs(unsigned l3) const { return m_l3s.Members(l3); }
+	TopologySpan<unsigned> NodeCPUs(unsigned node) const { return m_nodes.Members(node); }
+	TopologySpan<unsigned> TypeCPUs(CoreTypes type) const
+	{
+		return type == CoreTypes::ANY ? TopologySpan<unsigned>(m_allCPUs.data(), m_allCPUs.size()) : m_types.Members(TypeSlot(type));
+	}
+	TopologySpan<unsigned> NodeTypeCPUs(unsigned node, CoreTypes type) const
+	{
+		const unsigned slot = TypeSlot(type);
+		return (node < NodeCount() && slot != INVALID) ? m_nodeTypes.Members(node * TypeCount() + slot) : TopologySpan<unsigned>();
+	}
+
+	// Logical processors sharing the core (SMT siblings, including cpu itself) or the L2/L3 of cpu.
+	TopologySpan<unsigned> Siblings(unsigned cpu) const { return CoreCPUs(Core(cpu)); }
+	TopologySpan<unsigned> SharingL2(unsigned cpu) const { return L2CPUs(L2(cpu)); }
+	TopologySpan<unsigned> SharingL3(unsigned cpu) const { return L3CPUs(L3(cpu)); }
+
+	// Core types present in the system (ANY is not a slot, TypeCPUs(ANY) returns every logical processor).
+	unsigned TypeCount() const { return static_cast<unsigned>(m_typeKeys.size()); }
+	CoreTypes TypeAt(unsigned slot) const { return slot < TypeCount() ? m_typeKeys[slot] : CoreTypes::NONE; }
+
+	void Build(const PROCESSOR_INFO& procInfo)
+	{
+		const unsigned cpuCount = static_cast<unsigned>(procInfo.cores.size());
+
+		m_cpuCore.assign(cpuCount, INVALID);
+		m_cpuL2.assign(cpuCount, INVALID);
+		m_cpuL3.assign(cpuCount, INVALID);
+		m_cpuNode.assign(cpuCount, INVALID);
+		m_cpuType.assign(cpuCount, CoreTypes::NONE);
+		m_cpuSetID.assign(cpuCount, 0);
+		m_allCPUs.resize(cpuCount);
+		m_processorNumberCPU.clear();
+		m_typeKeys.clear();
+
+		std::map<std::pair<unsigned, unsigned>, unsigned>	coreIDs;	// (group, coreIndex) -> dense core id
+		std::map<unsigned, unsigned>						nodeIDs;	// node number -> dense node id
+
+		for (const NUMA_NODE_INFO& node : procInfo.nodes)
+		{
+			nodeIDs.emplace(node.nodeNumber, static_cast<unsigned>(nodeIDs.size()));
+		}
+
+		for (unsigned cpu = 0; cpu < cpuCount; cpu++)
+		{
+			const LOGICAL_PROCESSOR_INFO& logicalCore = procInfo.cores[cpu];
+			const unsigned number = GetProcessorNumber(procInfo, logicalCore);
+
+			if (number >= m_processorNumberCPU.size()) m_processorNumberCPU.resize(number + 1, INVALID);
+			m_processorNumberCPU[number] = cpu;
+
+			m_cpuCore[cpu] = coreIDs.emplace(std::make_pair(logicalCore.group, logicalCore.coreIndex), static_cast<unsigned>(coreIDs.size())).first->second;
+			m_cpuNode[cpu] = nodeIDs.emplace(logicalCore.node, static_cast<unsigned>(nodeIDs.size())).first->second;
+			m_cpuType[cpu] = logicalCore.coreType;
+			m_cpuSetID[cpu] = logicalCore.id;
+			m_allCPUs[cpu] = cpu;
+
+			if (std::find(m_typeKeys.begin(), m_typeKeys.end(), logicalCore.coreType) == m_typeKeys.end())
+			{
+				m_typeKeys.push_back(logicalCore.coreType);
+			}
+		}
+		std::sort(m_typeKeys.begin(), m_typeKeys.end());
+
+		// L2/L3 clusters, numbered in procInfo.caches order. Instruction caches do not define a cluster.
+		unsigned l2Count = 0;
+		unsigned l3Count = 0;
+
+		for (const CACHE_INFO& cache : procInfo.caches)
+		{
+			if (cache.type == CacheInstruction || (cache.level != 2 && cache.level != 3)) continue;
+
+			std::vector<unsigned>& cpuCache = cache.level == 2 ? m_cpuL2 : m_cpuL3;
+			const unsigned cluster = cache.level == 2 ? l2Count++ : l3Count++;
+
+			cache.processorMask.ForEach([&](unsigned number)
+			{
+				const unsigned cpu = CPUFromProcessorNumber(number);
+				if (cpu != INVALID && cpuCache[cpu] == INVALID) cpuCache[cpu] = cluster;
+			});
+		}
+
+		std::vector<unsigned> cpuTypeSlot(cpuCount);
+		std::vector<unsigned> cpuNodeType(cpuCount);
+
+		for (unsigned cpu = 0; cpu < cpuCount; cpu++)
+		{
+			cpuTypeSlot[cpu] = TypeSlot(m_cpuType[cpu]);
+			cpuNodeType[cpu] = m_cpuNode[cpu] * TypeCount() + cpuTypeSlot[cpu];
+		}
+
+		m_cores.Build(m_cpuCore, static_cast<unsigned>(coreIDs.size()));
+		m_l2s.Build(m_cpuL2, l2Count);
+		m_l3s.Build(m_cpuL3, l3Count);
+		m_nodes.Build(m_cpuNode, static_cast<unsigned>(nodeIDs.size()));
+		m_types.Build(cpuTypeSlot, TypeCount());
+		m_nodeTypes.Build(cpuNodeType, static_cast<unsigned>(nodeIDs.size()) * TypeCount());
+	}
+
+private:
+	// Compressed sparse rows: members of group g are cpus[offsets[g] .. offsets[g + 1]).
+	struct Groups
+	{
+		std::vector<unsigned> offsets;
+		std::vector<unsigned> cpus;
+
+		unsigned Count() const { return offsets.empty() ? 0 : static_cast<unsigned>(offsets.size() - 1); }
+
+		TopologySpan<unsigned> Members(unsigned group) const
+		{
+			if (group >= Count()) return TopologySpan<unsigned>();
+			return TopologySpan<unsigned>(cpus.data() + offsets[group], offsets[group + 1] - offsets[group]);
+		}
+
+		// Counting sort of the cpus by group, cpus without a group (INVALID) are left out.
+		void Build(const std::vector<unsigned>& cpuGroup, unsigned groupCount)
+		{
+			offsets.assign(groupCount + 1, 0);
+			for (unsigned group : cpuGroup) if (group < groupCount) offsets[group + 1]++;
+			for (unsigned group = 0; group < groupCount; group++) offsets[group + 1] += offsets[group];
+
+			std::vector<unsigned> next(offsets.begin(), offsets.end() - 1);
+			cpus.assign(offsets[groupCount], 0);
+			for (unsigned cpu = 0; cpu < cpuGroup.size(); cpu++)
+			{
+				if (cpuGroup[cpu] < groupCount) cpus[next[cpuGroup[cpu]]++] = cpu;
+			}
+		}
+	};
+
+	unsigned TypeSlot(CoreTypes type) const
+	{
+		for (unsigned slot = 0; slot < m_typeKeys.size(); slot++)
+		{
+			if (m_typeKeys[slot] == type) return slot;
+		}
+		return INVALID;
+	}
+
+	std::vector<unsigned>	m_cpuCore;
+	std::vector<unsigned>	m_cpuL2;
+	std::vector<unsigned>	m_cpuL3;
+	std::vector<unsigned>	m_cpuNode;
+	std::vector<CoreTypes>	m_cpuType;
+	std::vector<ULONG>		m_cpuSetID;
+	std::vector<unsigned>	m_processorNumberCPU;
+	std::vector<unsigned>	m_allCPUs;
+	std::vector<CoreTypes>	m_typeKeys;
+
+	Groups					m_cores;
+	Groups					m_l2s;
+	Groups					m_l3s;
+	Groups					m_nodes;
+	Groups					m_types;
+	Groups					m_nodeTypes; // node * TypeCount() + type slot
+};
+
+// Part of a cache a partitioned working set may use, the rest is left to code, stacks & other data.
+#ifndef HYBRIDDETECT_CACHE_PARTITION_DIVISOR
+#define HYBRIDDETECT_CACHE_PARTITION_DIVISOR	2
+#endif
+
+// Usable logical processors sharing one cache & the chunks of a partitioned range given to them.
+typedef struct _CACHE_PARTITION
+{
+	unsigned							cacheIndex = 0xffffffff;	// Index in procInfo.caches, 0xffffffff without cache information
+	ProcessorMask						processorMask;				// Run the chunks of this group on these logical processors
+	unsigned							cpuCount = 0;
+	size_t								firstChunk = 0;
+	size_t								chunkCount = 0;
+} CACHE_PARTITION, * PCACHE_PARTITION;
+
+// Range of elements split into equally sized chunks, chunk i covers [ChunkBegin(i), ChunkEnd(i)).
+// Consecutive chunks are given to the same group, so neighbouring data shares a cache.
+typedef struct _CACHE_PARTITIONING
+{
+	size_t								elementCount = 0;
+	size_t								elementsPerChunk = 0;
+	size_t								chunkCount = 0;
+	std::vector<CACHE_PARTITION>		groups;
+
+	size_t ChunkBegin(size_t chunk) const
+	{
+		return chunk * elementsPerChunk;
+	}
+
+	size_t ChunkEnd(size_t chunk) const
+	{
+		const size_t end = (chunk + 1) * elementsPerChunk;
+		return end < elementCount ? end : elementCount;
+	}
+} CACHE_PARTITIONING, * PCACHE_PARTITIONING;
+
+// Splits elementCount elements of elementSize bytes into chunks whose working set fits the share of the
+// level cacheLevel data/unified cache of each logical processor sharing it, grouped by that cache.
+// Only logical processors of coreType (ANY for all) the process may run on are used. At least minChunks
+// chunks are made, and never fewer than one per logical processor. Returns false when no cache of that
+// level is known, partitioning then splits the range evenly over a single group.
+inline bool PartitionForCache(const PROCESSOR_INFO& procInfo, size_t elementCount, size_t elementSize, unsigned cacheLevel,
+	CACHE_PARTITIONING& partitioning, size_t minChunks = 0, CoreTypes coreType = CoreTypes::ANY)
+{
+	HYBRID_DETECT_TRACE(5, ">>>");
+	partitioning = CACHE_PARTITIONING();
+	partitioning.elementCount = elementCount;
+	if (elementSize == 0) elementSize = 1;
+
+	ProcessorMask usable;
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		if (coreType != CoreTypes::ANY && logicalCore.coreType != coreType) continue;
+		usable |= logicalCore.processorMask;
+	}
+	if (procInfo.allowedMask.Any() && usable.Intersects(procInfo.allowedMask))
+	{
+		usable &= procInfo.allowedMask;
+	}
+
+	size_t elementsPerChunk = 0;
+	for (unsigned i = 0; i < procInfo.caches.size(); i++)
+	{
+		const CACHE_INFO& cache = procInfo.caches[i];
+		if (cache.level != cacheLevel || cache.type == CacheInstruction) continue;
+
+		CACHE_PARTITION group;
+		group.cacheIndex = i;
+		group.processorMask = cache.processorMask & usable;
+		group.cpuCount = (unsigned)group.processorMask.Count();
+		if (group.cpuCount == 0) continue;
+
+		// Whole cache lines per chunk whenever a line holds several elements
+		size_t elements = (size_t)cache.size / HYBRIDDETECT_CACHE_PARTITION_DIVISOR / group.cpuCount / elementSize;
+		const size_t elementsPerLine = cache.lineSize > elementSize ? cache.lineSize / elementSize : 1;
+		if (elements > elementsPerLine) elements -= elements % elementsPerLine;
+		if (elements == 0) elements = 1;
+
+		if (elementsPerChunk == 0 || elements < elementsPerChunk) elementsPerChunk = elements;
+		partitioning.groups.push_back(group);
+	}
+
+	const bool found = !partitioning.groups.empty();
+	if (!found)
+	{
+		CACHE_PARTITION group;
+		group.processorMask = usable;
+		group.cpuCount = (unsigned)usable.Count();
+		if (group.cpuCount == 0) group.cpuCount = 1;
+		partitioning.groups.push_back(group);
+		elementsPerChunk = elementCount;
+	}
+
+	size_t cpuCount = 0;
+	for (const CACHE_PARTITION& group : partitioning.groups) cpuCount += group.cpuCount;
+	if (minChunks < cpuCount) minChunks = cpuCount;
+
+	if (elementCount > 0)
+	{
+		if (elementsPerChunk == 0 || (elementCount + elementsPerChunk - 1) / elementsPerChunk < minChunks)
+		{
+			elementsPerChunk = (elementCount + minChunks - 1) / minChunks;
+		}
+		partitioning.elementsPerChunk = elementsPerChunk;
+		partitioning.chunkCount = (elementCount + elementsPerChunk - 1) / elementsPerChunk;
+	}
+
+	// Chunks are handed out in proportion to the logical processors of each group
+	size_t cpusBefore = 0;
+	for (CACHE_PARTITION& group : partitioning.groups)
+	{
+		group.firstChunk = partitioning.chunkCount * cpusBefore / cpuCount;
+		cpusBefore += group.cpuCount;
+		group.chunkCount = partitioning.chunkCount * cpusBefore / cpuCount - group.firstChunk;
+	}
+
+	HYBRID_DETECT_TRACE(5, "<<< %d chunks of %d elements in %d groups", (int)partitioning.chunkCount, (int)partitioning.elementsPerChunk, (int)partitioning.groups.size());
+	return found;
+}
+
+// Answers "which core type is the calling thread running on" without CPUID leaf 0x1A, e.g. once per batch of an
+// adaptive kernel. The processor number comes from GetCurrentProcessorNumberEx on Windows and sched_getcpu on Linux
+// (read from the rseq area or the vDSO, no system call), and is looked up in a processor number -> core type
+// table built once from PROCESSOR_INFO. The answer may be stale as soon as it
+// is returned unless the thread is bound to one core type.
+class CoreTypeTable
+{
+public:
+	static const unsigned UNKNOWN_PROCESSOR = ~0u;
+
+	void Build(const PROCESSOR_INFO& procInfo)
+	{
+		m_types.clear();
+		for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+		{
+			const unsigned number = GetProcessorNumber(procInfo, logicalCore);
+			if (number >= m_types.size()) m_types.resize(number + 1, static_cast<BYTE>(CoreTypes::NONE));
+			m_types[number] = static_cast<BYTE>(logicalCore.coreType);
+		}
+
+#if defined(HYBRIDDETECT_OS_WIN)
+		m_groupOffsets.clear();
+		for (unsigned group = 0; group < procInfo.groups.size(); group++)
+		{
+			m_groupOffsets.push_back(GetGroupOffset(procInfo, group));
+		}
+#endif
+	}
+
+	// Core type of an OS processor number (Windows: group offset + number in group), NONE when unknown.
+	CoreTypes Lookup(unsigned number) const
+	{
+		return number < m_types.size() ? static_cast<CoreTypes>(m_types[number]) : CoreTypes::NONE;
+	}
+
+	// OS processor number the calling thread is running on, UNKNOWN_PROCESSOR (Lookup gives NONE) when unknown.
+	unsigned CurrentProcessorNumber() const
+	{
+#if defined(HYBRIDDETECT_OS_WIN)
+		PROCESSOR_NUMBER number;
+		GetCurrentProcessorNumberEx(&number);
+		return (number.Group < m_groupOffsets.size() ? m_groupOffsets[number.Group] : 0) + number.Number;
+#elif defined(HYBRIDDETECT_OS_LINUX)
+		const int cpu = sched_getcpu();
+		return cpu < 0 ? UNKNOWN_PROCESSOR : static_cast<unsigned>(cpu);
+#else
+		return UNKNOWN_PROCESSOR;
+#endif
+	}
+
+	// Core type the calling thread is running on.
+	CoreTypes Current() const
+	{
+		return Lookup(CurrentProcessorNumber());
+	}
+
+private:
+	std::vector<BYTE>			m_types;
+#if defined(HYBRIDDETECT_OS_WIN)
+	std::vector<unsigned>		m_groupOffsets;
+#endif
+};
+
+// Workload classes of RecommendThreads.
+enum WorkloadClass
+{
+	WORKLOAD_LATENCY_CRITICAL,	// One thread per physical core, SMT siblings left idle
+	WORKLOAD_THROUGHPUT,		// One thread per logical processor
+	WORKLOAD_BACKGROUND,		// One thread per two physical cores of the most efficient core type
+};
+
+inline const char* WorkloadClassString(WorkloadClass workload)
+{
+	switch (workload)
+	{
+	case WORKLOAD_LATENCY_CRITICAL: return "Latency Critical";
+	case WORKLOAD_THROUGHPUT: return "Throughput";
+	case WORKLOAD_BACKGROUND: return "Background";
+	default: return "Unknown";
+	}
+}
+
+// Thread count & logical processors recommended for one pool.
+typedef struct _THREAD_RECOMMENDATION
+{
+	unsigned							threadCount = 0;
+	ProcessorMask						processorMask;	// Logical processors the pool threads should run on
+#ifdef ENABLE_CPU_SETS
+	std::vector<ULONG>					cpuSets;		// CPU Set IDs (Windows) / OS CPU numbers (Linux) of processorMask
+#endif
+} THREAD_RECOMMENDATION, * PTHREAD_RECOMMENDATION;
+
+// Recommends the size & placement of a pool of coreType (ANY for all) threads running a workload. Only logical
+// processors this process may run on (allowedMask) that are not parked are used. The count is limited by the CPU
+// quota left once quotaUsed threads (other pools, the main thread) are accounted for, then reduced by
+// reservedThreads threads of the process already running on these logical processors (e.g. the main thread).
+// Deterministic: the same PROCESSOR_INFO & arguments always give the same recommendation.
+inline void RecommendThreads(const PROCESSOR_INFO& procInfo, WorkloadClass workload, CoreTypes coreType,
+	THREAD_RECOMMENDATION& recommendation, unsigned reservedThreads = 0, unsigned quotaUsed = 0)
+{
+	HYBRID_DETECT_TRACE(5, ">>> %s", WorkloadClassString(workload));
+	recommendation = THREAD_RECOMMENDATION();
+
+	// Background work goes to the most efficient core type when the pool may use any of them.
+	unsigned efficiencyClass = 0xffffffff;
+	if (workload == WORKLOAD_BACKGROUND && coreType == CoreTypes::ANY && procInfo.hybrid)
+	{
+		for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+		{
+			if (logicalCore.efficiencyClass < efficiencyClass) efficiencyClass = logicalCore.efficiencyClass;
+		}
+	}
+
+	std::vector<std::pair<unsigned, unsigned>> physicalCores; // (group, coreIndex)
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		if (coreType != CoreTypes::ANY && logicalCore.coreType != coreType) continue;
+		if (efficiencyClass != 0xffffffff && logicalCore.efficiencyClass != efficiencyClass) continue;
+		if (logicalCore.parked) continue;
+		if (procInfo.allowedMask.Any() && !logicalCore.processorMask.Intersects(procInfo.allowedMask)) continue;
+
+		if (workload != WORKLOAD_THROUGHPUT)
+		{
+			const std::pair<unsigned, unsigned> physicalCore(logicalCore.group, logicalCore.coreIndex);
+			if (std::find(physicalCores.begin(), physicalCores.end(), physicalCore) != physicalCores.end()) continue;
+			physicalCores.push_back(physicalCore);
+		}
+
+		recommendation.processorMask |= logicalCore.processorMask;
+#ifdef ENABLE_CPU_SETS
+		recommendation.cpuSets.push_back(logicalCore.id);
+#endif
+		recommendation.threadCount++;
+	}
+
+	if (workload == WORKLOAD_BACKGROUND && recommendation.threadCount > 1)
+	{
+		recommendation.threadCount /= 2;
+	}
+
+	if (procInfo.cpuQuota > 0.0)
+	{
+		const unsigned quota = static_cast<unsigned>(ceil(procInfo.cpuQuota));
+		const unsigned available = quota > quotaUsed ? quota - quotaUsed : 0;
+		if (available < recommendation.threadCount) recommendation.threadCount = available;
+	}
+
+	recommendation.threadCount = recommendation.threadCount > reservedThreads ? recommendation.threadCount - reservedThreads : 0;
+	HYBRID_DETECT_TRACE(5, "<<< %d threads", (int)recommendation.threadCount);
+}
+
+// Frequency of a logical processor at one point in time.
+typedef struct _FREQUENCY_SAMPLE
+{
+	ULONG64								timestamp = 0;			// steady_clock nanoseconds, 0 before the first sample
+	unsigned							currentFrequency = 0;	// MHz, as reported by the OS (cpufreq / power information)
+	unsigned							effectiveFrequency = 0;	// MHz, from APERF/MPERF deltas, 0 when unavailable
+} FREQUENCY_SAMPLE, * PFREQUENCY_SAMPLE;
+
+// Background sampler of per logical processor frequencies, a replacement for polling UpdateProcessorInfo.
+// A sampler thread reads /sys/devices/system/cpu/cpu*/cpufreq/scaling_cur_freq (and APERF/MPERF through
+// /dev/cpu/*/msr when readable) on Linux, CallNtPowerInformation on Windows, at a configurable interval.
+// Samples are published into a ring of frames (one sample per logical processor per frame) made of atomics:
+// readers never lock, block or make system calls, and the writer never waits for readers.
+class FrequencySampler
+{
+public:
+	FrequencySampler() {}
+	~FrequencySampler() { Stop(); }
+
+	FrequencySampler(const FrequencySampler&) = delete;
+	FrequencySampler& operator=(const FrequencySampler&) = delete;
+
+	// Starts sampling the logical processors of procInfo (indexed like procInfo.cores). frames is the number of
+	// samples kept per logical processor, at least 2 so a frame is always complete while the next is written.
+	bool Start(const PROCESSOR_INFO& procInfo, std::chrono::microseconds interval = std::chrono::milliseconds(10), unsigned frames = 64)
+	{
+		Stop();
+
+		m_cpuCount = static_cast<unsigned>(procInfo.cores.size());
+		m_frameCount = frames < 2 ? 2 : frames;
+		if (m_cpuCount == 0) return false;
+
+		m_samples.reset(new std::atomic<ULONG64>[static_cast<size_t>(m_cpuCount) * m_frameCount]);
+		m_timestamps.reset(new std::atomic<ULONG64>[m_frameCount]);
+		for (size_t i = 0; i < static_cast<size_t>(m_cpuCount) * m_frameCount; i++) m_samples[i].store(0, std::memory_order_relaxed);
+		for (unsigned i = 0; i < m_frameCount; i++) m_timestamps[i].store(0, std::memory_order_relaxed);
+
+		m_generation.store(0, std::memory_order_relaxed);
+		m_intervalUs.store(static_cast<ULONG64>(interval.count()), std::memory_order_relaxed);
+		m_stop = false;
+
+		if (!OpenSources(procInfo)) return false;
+
+		m_thread = std::thread(&FrequencySampler::Run, this);
+		return true;
+	}
+
+	void Stop()
+	{
+		if (m_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_wake.notify_all();
+			m_thread.join();
+		}
+		CloseSources();
+	}
+
+	bool Running() const { return m_thread.joinable(); }
+
+	// Takes effect at the next sample.
+	void SetInterval(std::chrono::microseconds interval)
+	{
+		m_intervalUs.store(static_cast<ULONG64>(interval.count()), std::memory_order_relaxed);
+	}
+
+	// Number of frames written so far.
+	ULONG64 Generation() const { return m_generation.load(std::memory_order_acquire); }
+
+	// Most recent sample of a logical processor.
+	FREQUENCY_SAMPLE Latest(unsigned cpu) const
+	{
+		FREQUENCY_SAMPLE sample;
+		History(cpu, &sample, 1);
+		return sample;
+	}
+
+	// Copies up to count of the most recent samples of a logical processor, newest first. Returns the number copied.
+	size_t History(unsigned cpu, FREQUENCY_SAMPLE* samples, size_t count) const
+	{
+		if (cpu >= m_cpuCount || !samples) return 0;
+
+		const ULONG64 generation = Generation();
+		// The frame being written next is not readable, older frames may be overwritten while copying.
+		const ULONG64 available = generation < m_frameCount - 1 ? generation : m_frameCount - 1;
+		size_t copied = 0;
+
+		for (; copied < count && copied < available; copied++)
+		{
+			const unsigned frame = static_cast<unsigned>((generation - 1 - copied) % m_frameCount);
+			const ULONG64 packed = m_samples[static_cast<size_t>(frame) * m_cpuCount + cpu].load(std::memory_order_relaxed);
+
+			samples[copied].timestamp = m_timestamps[frame].load(std::memory_order_relaxed);
+			samples[copied].currentFrequency = static_cast<unsigned>(packed & 0xffffffff);
+			samples[copied].effectiveFrequency = static_cast<unsigned>(packed >> 32);
+		}
+
+		// Drop the frames the writer lapped while they were copied.
+		const ULONG64 lapped = Generation() - generation;
+		const size_t valid = lapped >= m_frameCount - 1 ? 0 : static_cast<size_t>(m_frameCount - 1 - lapped);
+		return copied < valid ? copied : valid;
+	}
+
+	// Writes the latest frequencies into procInfo.cores[].currentFrequency (and powerInformation.currentMhz).
+	void Update(PROCESSOR_INFO& procInfo) const
+	{
+		for (unsigned cpu = 0; cpu < procInfo.cores.size() && cpu < m_cpuCount; cpu++)
+		{
+			const FREQUENCY_SAMPLE sample = Latest(cpu);
+			if (!sample.timestamp) continue;
+
+			procInfo.cores[cpu].currentFrequency = sample.effectiveFrequency ? sample.effectiveFrequency : sample.currentFrequency;
+			procInfo.cores[cpu].powerInformation.currentMhz = sample.currentFrequency;
+		}
+	}
+
+private:
+	static ULONG64 Now()
+	{
+		return static_cast<ULONG64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	void Run()
+	{
+		auto next = std::chrono::steady_clock::now();
+
+		for (;;)
+		{
+			Sample();
+
+			next += std::chrono::microseconds(m_intervalUs.load(std::memory_order_relaxed));
+			const auto now = std::chrono::steady_clock::now();
+			if (next < now) next = now; // Don't try to catch up after a stall
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_wake.wait_until(lock, next, [this] { return m_stop; })) break;
+		}
+	}
+
+	// Writes frame (generation % frames) and publishes it.
+	void Sample()
+	{
+		const ULONG64 generation = m_generation.load(std::memory_order_relaxed);
+		const unsigned frame = static_cast<unsigned>(generation % m_frameCount);
+		std::atomic<ULONG64>* samples = &m_samples[static_cast<size_t>(frame) * m_cpuCount];
+
+#if defined(HYBRIDDETECT_OS_WIN)
+		CallNtPowerInformation(ProcessorInformation, nullptr, 0, m_powerInformation.data(),
+			static_cast<ULONG>(sizeof(LOGICAL_PROCESSOR_POWER_INFORMATION) * m_powerInformation.size()));
+
+		for (unsigned cpu = 0; cpu < m_cpuCount; cpu++)
+		{
+			samples[cpu].store(cpu < m_powerInformation.size() ? m_powerInformation[cpu].currentMhz : 0, std::memory_order_relaxed);
+		}
+#elif defined(HYBRIDDETECT_OS_LINUX)
+		for (unsigned cpu = 0; cpu < m_cpuCount; cpu++)
+		{
+			SOURCE& source = m_sources[cpu];
+			ULONG64 currentFrequency = 0;
+			ULONG64 effectiveFrequency = 0;
+			char buffer[32];
+
+			if (source.cpufreq >= 0)
+			{
+				const ssize_t size = pread(source.cpufreq, buffer, sizeof(buffer) - 1, 0);
+				if (size > 0)
+				{
+					buffer[size] = 0;
+					currentFrequency = strtoull(buffer, nullptr, 10) / 1000; // kHz
+				}
+			}
+
+			ULONG64 aperf = 0;
+			ULONG64 mperf = 0;
+
+			if (source.msr >= 0 &&
+				pread(source.msr, &aperf, sizeof(aperf), 0xE8) == sizeof(aperf) &&	// IA32_APERF
+				pread(source.msr, &mperf, sizeof(mperf), 0xE7) == sizeof(mperf))		// IA32_MPERF
+			{
+				// MPERF counts at the base (TSC) frequency while the processor is not halted.
+				if (source.mperf && mperf > source.mperf && source.baseFrequency)
+				{
+					effectiveFrequency = static_cast<ULONG64>(static_cast<double>(aperf - source.aperf) / static_cast<double>(mperf - source.mperf) * source.baseFrequency);
+				}
+				source.aperf = aperf;
+				source.mperf = mperf;
+			}
+
+			samples[cpu].store((currentFrequency & 0xffffffff) | (effectiveFrequency << 32), std::memory_order_relaxed);
+		}
+#endif
+		m_timestamps[frame].store(Now(), std::memory_order_relaxed);
+		m_generation.store(generation + 1, std::memory_order_release);
+	}
+
+	bool OpenSources(const PROCESSOR_INFO& procInfo)
+	{
+#if defined(HYBRIDDETECT_OS_WIN)
+		m_powerInformation.assign(procInfo.numLogicalCores > m_cpuCount ? procInfo.numLogicalCores : m_cpuCount, LOGICAL_PROCESSOR_POWER_INFORMATION());
+		return true;
+#elif defined(HYBRIDDETECT_OS_LINUX)
+		bool opened = false;
+
+		m_sources.assign(m_cpuCount, SOURCE());
+
+		for (unsigned cpu = 0; cpu < m_cpuCount; cpu++)
+		{
+			const LOGICAL_PROCESSOR_INFO& logicalCore = procInfo.cores[cpu];
+			const std::string number = std::to_string(logicalCore.logicalProcessorIndex);
+			SOURCE& source = m_sources[cpu];
+
+			source.cpufreq = open(("/sys/devices/system/cpu/cpu" + number + "/cpufreq/scaling_cur_freq").c_str(), O_RDONLY | O_CLOEXEC);
+			source.msr = open(("/dev/cpu/" + number + "/msr").c_str(), O_RDONLY | O_CLOEXEC);
+			source.baseFrequency = logicalCore.baseFrequency;
+
+			opened = opened || source.cpufreq >= 0 || source.msr >= 0;
+		}
+		return opened;
+#else
+		(void)procInfo;
+		return false;
+#endif
+	}
+
+	void CloseSources()
+	{
+#if defined(HYBRIDDETECT_OS_LINUX)
+		for (SOURCE& source : m_sources)
+		{
+			if (source.cpufreq >= 0) close(source.cpufreq);
+			if (source.msr >= 0) close(source.msr);
+		}
+		m_sources.clear();
+#endif
+	}
+
+#if defined(HYBRIDDETECT_OS_WIN)
+	std::vector<LOGICAL_PROCESSOR_POWER_INFORMATION>	m_powerInformation;
+#elif defined(HYBRIDDETECT_OS_LINUX)
+	struct SOURCE
+	{
+		int			cpufreq = -1;
+		int			msr = -1;
+		unsigned	baseFrequency = 0;
+		ULONG64		aperf = 0;
+		ULONG64		mperf = 0;
+	};
+	std::vector<SOURCE>						m_sources;
+#endif
+
+	unsigned								m_cpuCount = 0;
+	unsigned								m_frameCount = 0;
+	std::unique_ptr<std::atomic<ULONG64>[]>	m_samples;		// frame * m_cpuCount + cpu: MHz | effective MHz << 32
+	std::unique_ptr<std::atomic<ULONG64>[]>	m_timestamps;	// per frame
+	std::atomic<ULONG64>					m_generation{ 0 };
+	std::atomic<ULONG64>					m_intervalUs{ 10000 };
+
+	std::thread								m_thread;
+	std::mutex								m_mutex;
+	std::condition_variable					m_wake;
+	bool									m_stop = false;
+};
+
+// Watches the logical processors the process can use and publishes a new immutable PROCESSOR_INFO generation
+// when they change: CPUs going online/offline (/sys/devices/system/cpu/online), the cgroup cpuset
+// (cpuset.cpus.effective) & affinity on Linux, parked/allocated CPU sets & active processors on Windows.
+// Linux changes wake the watcher through inotify where the kernel notifies them, every source is also polled.
+// A change is published once it has been stable for the settle time, so core parking toggling under load
+// doesn't rebuild thread pools continuously. Calibration scores are carried over to the new generations.
+class TopologyWatcher
+{
+public:
+	typedef std::shared_ptr<const PROCESSOR_INFO>		Snapshot;
+	typedef std::function<void(const Snapshot&)>		Callback;
+
+	TopologyWatcher() {}
+	~TopologyWatcher() { Stop(); }
+
+	TopologyWatcher(const TopologyWatcher&) = delete;
+	TopologyWatcher& operator=(const TopologyWatcher&) = delete;
+
+	// Starts watching, initial is published as generation 1.
+	bool Start(const PROCESSOR_INFO& initial, std::chrono::milliseconds interval = std::chrono::milliseconds(500),
+		std::chrono::milliseconds settle = std::chrono::milliseconds(1000))
+	{
+		HYBRID_DETECT_TRACE(7, ">>>");
+		Stop();
+
+		m_interval = interval;
+		m_settle = settle;
+		m_stop = false;
+		m_refresh = false;
+
+		{
+			std::lock_guard<std::mutex> lock(m_currentMutex);
+			m_current = std::make_shared<const PROCESSOR_INFO>(initial);
+		}
+		m_generation.store(1, std::memory_order_release);
+
+#if defined(HYBRIDDETECT_OS_LINUX)
+		m_event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		OpenWatches();
+#endif
+		m_thread = std::thread(&TopologyWatcher::Run, this);
+		HYBRID_DETECT_TRACE(7, "<<< ");
+		return true;
+	}
+
+	void Stop()
+	{
+		if (m_thread.joinable())
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			Wake();
+			m_thread.join();
+		}
+#if defined(HYBRIDDETECT_OS_LINUX)
+		CloseWatches();
+		if (m_event >= 0) close(m_event);
+		m_event = -1;
+#endif
+	}
+
+	bool Running() const { return m_thread.joinable(); }
+
+	// Checks the sources now instead of at the next poll, a change still has to settle before it is published.
+	void Refresh()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_refresh = true;
+		}
+		Wake();
+	}
+
+	// Latest published generation, the PROCESSOR_INFO stays valid while the snapshot is held.
+	Snapshot Current() const
+	{
+		std::lock_guard<std::mutex> lock(m_currentMutex);
+		return m_current;
+	}
+
+	// Number of generations published, 0 before Start.
+	ULONG64 Generation() const { return m_generation.load(std::memory_order_acquire); }
+
+	// Callbacks run on the watcher thread after a generation is published. Returns an ID for RemoveCallback.
+	unsigned AddCallback(Callback callback)
+	{
+		std::lock_guard<std::mutex> lock(m_callbackMutex);
+		m_callbacks.emplace_back(++m_callbackID, std::move(callback));
+		return m_callbackID;
+	}
+
+	// The callback may still be running on the watcher thread when this returns.
+	void RemoveCallback(unsigned id)
+	{
+		std::lock_guard<std::mutex> lock(m_callbackMutex);
+		m_callbacks.erase(std::remove_if(m_callbacks.begin(), m_callbacks.end(),
+			[id](const std::pair<unsigned, Callback>& entry) { return entry.first == id; }), m_callbacks.end());
+	}
+
+private:
+	// Everything a change of usable logical processors shows up in, compared as a whole.
+	static std::string ReadState()
+	{
+		std::string state;
+
+#if defined(HYBRIDDETECT_OS_WIN)
+		state = std::to_string(GetActiveProcessorCount(ALL_PROCESSOR_GROUPS));
+#ifdef ENABLE_CPU_SETS
+		ULONG bufferSize = 0;
+		GetSystemCpuSetInformation(nullptr, 0, &bufferSize, GetCurrentProcess(), 0);
+
+		std::unique_ptr<uint8_t[]> buffer(new uint8_t[bufferSize]);
+
+		if (bufferSize && GetSystemCpuSetInformation(reinterpret_cast<PSYSTEM_CPU_SET_INFORMATION>(buffer.get()), bufferSize, &bufferSize, GetCurrentProcess(), 0))
+		{
+			for (ULONG offset = 0; offset < bufferSize; )
+			{
+				const PSYSTEM_CPU_SET_INFORMATION cpuSet = reinterpret_cast<PSYSTEM_CPU_SET_INFORMATION>(buffer.get() + offset);
+
+				if (cpuSet->Type == CPU_SET_INFORMATION_TYPE::CpuSetInformation)
+				{
+					state += ' ' + std::to_string(cpuSet->CpuSet.Id) + ':' +
+						(cpuSet->CpuSet.Parked ? 'p' : '-') + (cpuSet->CpuSet.Allocated ? 'a' : '-') + (cpuSet->CpuSet.AllocatedToTargetProcess ? 't' : '-');
+				}
+				offset += cpuSet->Size;
+			}
+		}
+#endif
+		DWORD_PTR processAffinity = 0;
+		DWORD_PTR systemAffinity = 0;
+
+		if (GetProcessAffinityMask(GetCurrentProcess(), &processAffinity, &systemAffinity))
+		{
+			state += " affinity " + std::to_string(static_cast<ULONG64>(processAffinity));
+		}
+#elif defined(HYBRIDDETECT_OS_LINUX)
+		std::string value;
+		std::string path;
+
+		if (ReadSysfsString("/sys/devices/system/cpu/online", value)) state += "online " + value;
+		if (GetCgroupPath("", path) || GetCgroupPath("cpuset", path)) state += " cgroup " + path;
+
+		std::vector<unsigned> cgroupCPUs;
+		if (GetCgroupCPUSet(cgroupCPUs))
+		{
+			state += " cpuset";
+			for (unsigned cpu : cgroupCPUs) state += ' ' + std::to_string(cpu);
+		}
+
+		std::vector<unsigned> processCPUs;
+		if (GetProcessAffinity(processCPUs))
+		{
+			state += " affinity";
+			for (unsigned cpu : processCPUs) state += ' ' + std::to_string(cpu);
+		}
+#endif
+		return state;
+	}
+
+#if defined(HYBRIDDETECT_OS_LINUX)
+	// Logical processors the process may run on: the affinity of its main thread, the one taskset & sched_setaffinity
+	// of the process ID change. Unlike sched_getaffinity, CPUs that are offline are listed too.
+	static bool GetProcessAffinity(std::vector<unsigned>& cpus)
+	{
+		std::ifstream status("/proc/self/status");
+		std::string line;
+
+		while (std::getline(status, line))
+		{
+			if (line.compare(0, 18, "Cpus_allowed_list:") != 0) continue;
+
+			const size_t begin = line.find_first_not_of(" \t", 18);
+			return begin != std::string::npos && ParseCPUList(line.substr(begin), cpus) && !cpus.empty();
+		}
+		return false;
+	}
+
+	// Runs the watcher thread on the logical processors of the process rather than those of the thread calling Start
+	// (often pinned), GetProcessorInfo derives the allowed logical processors from the calling thread. Returns them.
+	static ProcessorMask FollowProcessAffinity()
+	{
+		std::vector<unsigned> cpus;
+		if (!GetProcessAffinity(cpus)) return ProcessorMask();
+
+		const unsigned maxCPU = *std::max_element(cpus.begin(), cpus.end());
+		cpu_set_t* affinity = CPU_ALLOC(maxCPU + 1);
+		const size_t affinitySize = CPU_ALLOC_SIZE(maxCPU + 1);
+
+		if (affinity)
+		{
+			CPU_ZERO_S(affinitySize, affinity);
+			for (unsigned cpu : cpus) CPU_SET_S(cpu, affinitySize, affinity);
+
+			sched_setaffinity(0, affinitySize, affinity);
+			CPU_FREE(affinity);
+		}
+		return CPUListToMask(cpus);
+	}
+#endif
+
+	void Run()
+	{
+		m_state = ReadState();
+
+		std::string pending = m_state;
+		auto pendingSince = std::chrono::steady_clock::now();
+
+		for (;;)
+		{
+			// Wait for a notification, a refresh or the next poll; sooner while a change is settling.
+			const std::chrono::milliseconds timeout = pending != m_state && m_settle < m_interval ? m_settle : m_interval;
+
+#if defined(HYBRIDDETECT_OS_LINUX)
+			pollfd fds[2] = { { m_event, POLLIN, 0 }, { m_inotify, POLLIN, 0 } };
+			poll(fds, m_inotify >= 0 ? 2 : 1, static_cast<int>(timeout.count()));
+
+			ULONG64 count;
+			while (m_event >= 0 && read(m_event, &count, sizeof(count)) > 0) {}
+
+			char events[4096];
+			while (m_inotify >= 0 && read(m_inotify, events, sizeof(events)) > 0) {}
+#endif
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+#if !defined(HYBRIDDETECT_OS_LINUX)
+				m_wake.wait_for(lock, timeout, [this] { return m_stop || m_refresh; });
+#endif
+				if (m_stop) break;
+				m_refresh = false;
+			}
+
+			const std::string state = ReadState();
+			const auto now = std::chrono::steady_clock::now();
+
+			if (state != pending)
+			{
+				pending = state;
+				pendingSince = now;
+			}
+
+			if (pending != m_state && now - pendingSince >= m_settle)
+			{
+				m_state = pending;
+				Publish();
+#if defined(HYBRIDDETECT_OS_LINUX)
+				// The process may have moved to another cgroup.
+				CloseWatches();
+				OpenWatches();
+#endif
+			}
+		}
+	}
+
+	void Publish()
+	{
+		HYBRID_DETECT_TRACE(5, "=== topology changed: %s", m_state.c_str());
 
-				// Homogeneous processor clusters
-				procInfo.coreMasks[static_cast<short>(logicalCore.coreType)] |= affinityMask;
+		std::shared_ptr<PROCESSOR_INFO> procInfo = std::make_shared<PROCESSOR_INFO>();
+#if defined(HYBRIDDETECT_OS_LINUX)
+		// The affinity of the process may have changed since the previous generation.
+		const ProcessorMask processMask = FollowProcessAffinity();
+		GetProcessorInfo(*procInfo);
 
-#ifdef ENABLE_CPU_SETS
-				procInfo.cpuSets[static_cast<unsigned int>(CoreTypes::ANY)].push_back(logicalCore.id);
-				procInfo.cpuSets[static_cast<unsigned int>(logicalCore.coreType)].push_back(logicalCore.id);
+		// Should the watcher thread have failed to follow, never offer more than the process may use.
+		if (processMask.Any())
+		{
+			procInfo->allowedMask &= processMask;
+		}
 #else
-				procInfo.cores.push_back(logicalCore);
+		GetProcessorInfo(*procInfo);
 #endif
-				//pwrInfo.clear();
-			}
 
+		const Snapshot previous = Current();
+		if (previous) procInfo->scores = previous->scores;
 
+		Snapshot snapshot = procInfo;
+		{
+			std::lock_guard<std::mutex> lock(m_currentMutex);
+			m_current = snapshot;
+		}
+		m_generation.fetch_add(1, std::memory_order_acq_rel);
 
-			// Reset Group Affinity
-			SetThreadGroupAffinity(GetCurrentThread(), &prevGroup, nullptr);
+		std::vector<std::pair<unsigned, Callback>> callbacks;
+		{
+			std::lock_guard<std::mutex> lock(m_callbackMutex);
+			callbacks = m_callbacks;
+		}
+		for (const std::pair<unsigned, Callback>& entry : callbacks)
+		{
+			entry.second(snapshot);
 		}
+	}
 
-		// Reset Process Affinity Mask
-		SetThreadAffinityMask(GetCurrentThread(), processAffinityMask);
+	void Wake()
+	{
+#if defined(HYBRIDDETECT_OS_LINUX)
+		const ULONG64 one = 1;
+		if (m_event >= 0 && write(m_event, &one, sizeof(one)) < 0) {}
+#else
+		m_wake.notify_all();
+#endif
 	}
-#else // HYBRIDDETECT_OS_WIN
 
-#ifdef __APPLE__
+#if defined(HYBRIDDETECT_OS_LINUX)
+	// sysfs & cgroup v1 files rarely raise inotify events, cgroup v2 notifies cpuset.cpus.effective & cgroup.events.
+	void OpenWatches()
 	{
-		size_t len = sizeof(procInfo.numPhysicalCores);
-		sysctlbyname("hw.physicalcpu", &procInfo.numPhysicalCores, &len, NULL, 0);
-		len = sizeof(procInfo.numLogicalCores);
-		sysctlbyname("hw.ncpu", &procInfo.numLogicalCores, &len, NULL, 0);
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (m_inotify < 0) return;
 
-		bool bHybrid = false;
-		len = sizeof(int);
-		int nperflevels{};
-		sysctlbyname("hw.nperflevels", &nperflevels, &len, NULL, 0);
-		bHybrid = nperflevels > 1;
+		inotify_add_watch(m_inotify, "/sys/devices/system/cpu/online", IN_MODIFY);
 
-		procInfo.hybrid = bHybrid;
+		std::string path;
+		if (GetCgroupPath("", path))
+		{
+			const std::string directory = "/sys/fs/cgroup" + path + (path.empty() || path.back() != '/' ? "/" : "");
+
+			inotify_add_watch(m_inotify, (directory + "cpuset.cpus.effective").c_str(), IN_MODIFY);
+			inotify_add_watch(m_inotify, (directory + "cgroup.events").c_str(), IN_MODIFY);
+		}
 	}
-#endif // APPLE
-#endif
+
+	void CloseWatches()
+	{
+		if (m_inotify >= 0) close(m_inotify);
+		m_inotify = -1;
+	}
+
+	int										m_inotify = -1;
+	int										m_event = -1;
 #endif
-	HYBRID_DETECT_TRACE(7, "<<< ");
-}
+
+	std::chrono::milliseconds				m_interval{ 500 };
+	std::chrono::milliseconds				m_settle{ 1000 };
+	std::string								m_state;
+
+	mutable std::mutex						m_currentMutex;
+	Snapshot								m_current;
+	std::atomic<ULONG64>					m_generation{ 0 };
+
+	std::mutex								m_callbackMutex;
+	std::vector<std::pair<unsigned, Callback>>	m_callbacks;
+	unsigned								m_callbackID = 0;
+
+	std::thread								m_thread;
+	std::mutex								m_mutex;
+	std::condition_variable					m_wake;
+	bool									m_stop = false;
+	bool									m_refresh = false;
+};
 
 #ifdef HYBRIDDETECT_OS_WIN
 inline bool SetMemoryPriority(HANDLE threadHandle, UINT memoryPriority)
@@ -1193,64 +4338,223 @@ inline bool AutoPowerThrottling(HANDLE threadHandle)
 }
 #endif
 
+#ifdef HYBRIDDETECT_OS_WIN
+inline bool IsCurrentThread(HANDLE threadHandle)
+{
+	return threadHandle == GetCurrentThread();
+}
+#endif
+
+#ifdef HYBRIDDETECT_OS_LINUX
+// Win32 style thread helpers so the RunOn* API reads the same on Linux.
+inline HANDLE GetCurrentThread()
+{
+	return pthread_self();
+}
+
+inline bool IsCurrentThread(HANDLE threadHandle)
+{
+	return pthread_equal(threadHandle, pthread_self()) != 0;
+}
+
+inline int GetCurrentProcessorNumber()
+{
+	return sched_getcpu();
+}
+
+inline void Sleep(unsigned milliseconds)
+{
+	if (milliseconds == 0)
+	{
+		// Surrender time-slice
+		sched_yield();
+	}
+	else
+	{
+		usleep(milliseconds * 1000);
+	}
+}
+
+// Applies the affinity built by fill(set, size) to a thread. A cpu_set_t on the stack holds CPU_SETSIZE (1024)
+// processors, only larger processor numbers need a dynamically allocated set.
+template<typename F>
+inline bool SetThreadAffinityLinux(HANDLE threadHandle, unsigned maxCPU, F fill)
+{
+	if (maxCPU < CPU_SETSIZE)
+	{
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		fill(&set, sizeof(set));
+		return pthread_setaffinity_np(threadHandle, sizeof(set), &set) == 0;
+	}
+
+	cpu_set_t* set = CPU_ALLOC(maxCPU + 1);
+	if (!set) return false;
+
+	const size_t size = CPU_ALLOC_SIZE(maxCPU + 1);
+	CPU_ZERO_S(size, set);
+	fill(set, size);
+
+	const bool succeeded = pthread_setaffinity_np(threadHandle, size, set) == 0;
+	CPU_FREE(set);
+	return succeeded;
+}
+
+// Linux counterpart of SetThreadSelectedCpuSets, CPU Set IDs are OS CPU numbers on Linux (see GetLogicalProcessorsEx).
+// Fails, like pthread_setaffinity_np, when none of the CPUs may be used by the thread (e.g. cgroup cpuset).
+inline bool SetThreadSelectedCpuSets(HANDLE threadHandle, const ULONG* cpuSetIds, ULONG cpuSetIdCount)
+{
+	ULONG maxCPU = 0;
+
+	for (ULONG i = 0; i < cpuSetIdCount; i++)
+	{
+		maxCPU = std::max(maxCPU, cpuSetIds[i]);
+	}
+
+	return SetThreadAffinityLinux(threadHandle, maxCPU, [&](cpu_set_t* set, size_t size)
+	{
+		for (ULONG i = 0; i < cpuSetIdCount; i++) CPU_SET_S(cpuSetIds[i], size, set);
+	});
+}
+
+// Pins a thread to the logical processors of a ProcessorMask (bit n = OS CPU number n on Linux).
+inline bool SetThreadAffinityProcessorMask(HANDLE threadHandle, const ProcessorMask& mask)
+{
+	const unsigned maxCPU = mask.WordCount() * 64;
+
+	return SetThreadAffinityLinux(threadHandle, maxCPU, [&](cpu_set_t* set, size_t size)
+	{
+		mask.ForEach([&](unsigned cpu) { CPU_SET_S(cpu, size, set); });
+	});
+}
+#endif
+
 #ifdef ENABLE_CPU_SETS
 
+// Pre-resolved, immutable list of CPU Set IDs. Resolve once (GetCPUSetView) and pass to the RunOn* overloads
+// taking views on hot paths: nothing is copied, looked up or allocated per call.
+typedef TopologySpan<ULONG> CPUSetView;
+
+inline CPUSetView ToCPUSetView(const std::vector<ULONG>& cpuSet)
+{
+	return CPUSetView(cpuSet.data(), cpuSet.size());
+}
+
+// CPU Set of a core type, without copying or inserting into procInfo.cpuSets.
+// The view stays valid until procInfo.cpuSets is modified or destroyed.
+inline CPUSetView GetCPUSetView(const PROCESSOR_INFO& procInfo, const CoreTypes type)
+{
+	auto cpuSet = procInfo.cpuSets.find(static_cast<unsigned>(type));
+	return cpuSet != procInfo.cpuSets.end() ? ToCPUSetView(cpuSet->second) : CPUSetView();
+}
+
 #ifdef ENABLE_RUNON
-inline short RunOnCPUSet(PROCESSOR_INFO& procInfo, HANDLE threadHandle, std::vector<ULONG> cpuSet, std::vector<ULONG> fallbackSet = {})
+// Last CPU Sets applied to the calling thread through views, used to skip redundant SetThreadSelectedCpuSets
+// calls. Views are identified by their storage, which must be immutable while cached (see GetCPUSetView).
+typedef struct _RUNON_CACHE
 {
-	if (cpuSet.size() > 0)
+	const ULONG*						cpuSet = nullptr;
+	size_t								cpuSetSize = 0;
+	const ULONG*						fallbackSet = nullptr;
+	size_t								fallbackSetSize = 0;
+	short								result = -1;
+} RUNON_CACHE, * PRUNON_CACHE;
+
+inline RUNON_CACHE& GetRunOnCache()
+{
+	static thread_local RUNON_CACHE cache;
+	return cache;
+}
+
+// Forgets the CPU Sets cached for the calling thread, e.g. after changing its affinity outside of RunOn*
+// or after re-enumerating the PROCESSOR_INFO the cached views pointed into.
+inline void ResetRunOnCache()
+{
+	GetRunOnCache() = RUNON_CACHE();
+}
+
+inline short RunOnCPUSet(PROCESSOR_INFO& procInfo, HANDLE threadHandle, CPUSetView cpuSet, CPUSetView fallbackSet, bool useCache)
+{
+	// Only the calling thread's affinity is known to this thread.
+	RUNON_CACHE& cache = GetRunOnCache();
+	useCache = useCache && IsCurrentThread(threadHandle);
+
+	if (useCache &&
+		cache.cpuSet == cpuSet.data() && cache.cpuSetSize == cpuSet.size() &&
+		cache.fallbackSet == fallbackSet.data() && cache.fallbackSetSize == fallbackSet.size() &&
+		cache.result >= 0)
 	{
-		if (SetThreadSelectedCpuSets(threadHandle, &cpuSet[0], cpuSet.size()))
-		{
-			return 1;
-		}
+		return cache.result;
 	}
 
-	if (fallbackSet.size() > 0)
+	short result = -1;
+
+	if (cpuSet.size() > 0 && SetThreadSelectedCpuSets(threadHandle, cpuSet.data(), static_cast<ULONG>(cpuSet.size())))
+	{
+		result = 1;
+	}
+	else if (fallbackSet.size() > 0 && SetThreadSelectedCpuSets(threadHandle, fallbackSet.data(), static_cast<ULONG>(fallbackSet.size())))
 	{
-		if (SetThreadSelectedCpuSets(threadHandle, &fallbackSet[0], fallbackSet.size()))
+		result = 0;
+	}
+	else
+	{
+		CPUSetView anySet = GetCPUSetView(procInfo, CoreTypes::ANY);
+
+		if (anySet.size() > 0)
 		{
-			return 0;
+			SetThreadSelectedCpuSets(threadHandle, anySet.data(), static_cast<ULONG>(anySet.size()));
 		}
 	}
 
-	std::vector<ULONG> anySet = procInfo.cpuSets[CoreTypes::ANY];
-
-	if (anySet.size() > 0)
+	if (IsCurrentThread(threadHandle))
 	{
-		if (SetThreadSelectedCpuSets(threadHandle, &anySet[0], anySet.size()))
+		ResetRunOnCache();
+
+		if (useCache)
 		{
-			return -1;
+			cache.cpuSet = cpuSet.data();
+			cache.cpuSetSize = cpuSet.size();
+			cache.fallbackSet = fallbackSet.data();
+			cache.fallbackSetSize = fallbackSet.size();
+			cache.result = result;
 		}
 	}
 
-	return -1;
+	return result;
+}
+
+// Allocation-free: Run A Thread On A Pre-Resolved CPU Set
+inline short RunOnCPUSet(PROCESSOR_INFO& procInfo, HANDLE threadHandle, CPUSetView cpuSet, CPUSetView fallbackSet = CPUSetView())
+{
+	return RunOnCPUSet(procInfo, threadHandle, cpuSet, fallbackSet, true);
+}
+
+// Vectors may be temporaries, their storage can't identify a cached CPU Set.
+inline short RunOnCPUSet(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const std::vector<ULONG>& cpuSet, const std::vector<ULONG>& fallbackSet = {})
+{
+	return RunOnCPUSet(procInfo, threadHandle, ToCPUSetView(cpuSet), ToCPUSetView(fallbackSet), false);
 }
 #else
-inline short RunOnCPUSet(PROCESSOR_INFO& , HANDLE , std::vector<ULONG> , std::vector<ULONG> fallbackSet = {})
+inline short RunOnCPUSet(PROCESSOR_INFO& , HANDLE , CPUSetView , CPUSetView fallbackSet = CPUSetView())
 {
 	return -1;
 }
-#endif
 
-// Run A Thread On the Atom or Core Logical Processor Cluster
-inline short RunOn(
-	PROCESSOR_INFO& 
-#ifdef ENABLE_RUNON
-	procInfo
-#endif
-	, 
-#if defined(ENABLE_RUNON_PRIORITY) || defined(ENABLE_RUNON_MEMORY_PRIORITY) || defined(ENABLE_RUNON_EXECUTION_SPEED) || defined(ENABLE_RUNON)
-	HANDLE threadHandle,
-#else
-	HANDLE,
+inline short RunOnCPUSet(PROCESSOR_INFO& , HANDLE , const std::vector<ULONG>& , const std::vector<ULONG>& fallbackSet = {})
+{
+	return -1;
+}
 #endif
-#if defined(ENABLE_RUNON) || defined(ENABLE_RUNON_PRIORITY) || defined(ENABLE_RUNON_MEMORY_PRIORITY) || defined(ENABLE_RUNON_EXECUTION_SPEED)
-	const CoreTypes type, 
+
+// Thread priority, memory priority & power throttling hints for a core type.
+inline void SetCoreTypeHints(
+#if defined(ENABLE_RUNON_PRIORITY) || defined(ENABLE_RUNON_MEMORY_PRIORITY) || defined(ENABLE_RUNON_EXECUTION_SPEED)
+	HANDLE threadHandle, const CoreTypes type
 #else
-	const CoreTypes,
+	HANDLE, const CoreTypes
 #endif
-	const std::vector<ULONG> fallbackSet = {})
+)
 {
 #ifdef ENABLE_RUNON_PRIORITY
 	switch (type)
@@ -1296,31 +4600,53 @@ inline short RunOn(
 		break;
 	}
 #endif
+}
 
+// Run A Thread On the Atom or Core Logical Processor Cluster
+inline short RunOn(
+	PROCESSOR_INFO& 
 #ifdef ENABLE_RUNON
-	//HYBRIDDETECT_DEBUG_REQUIRE(procInfo.coreMasks.size());
-
-	if (procInfo.cpuSets.size() > 0)
-	{
-		std::vector<ULONG> cpuSet = procInfo.cpuSets[type];
-		return RunOnCPUSet(procInfo, threadHandle, cpuSet, fallbackSet);
-	}
+	procInfo
+#endif
+	, 
+	HANDLE threadHandle,
+	const CoreTypes type, 
+	const std::vector<ULONG>& fallbackSet = {})
+{
+	SetCoreTypeHints(threadHandle, type);
 
-	return RunOnCPUSet(procInfo, threadHandle, fallbackSet);
+#ifdef ENABLE_RUNON
+	// procInfo.cpuSets is stable storage, the calling thread's CPU Set can be cached unless a fallback list is given.
+	return RunOnCPUSet(procInfo, threadHandle, GetCPUSetView(procInfo, type), ToCPUSetView(fallbackSet), fallbackSet.empty());
 #else
+	(void)fallbackSet;
 	return 0;
 #endif
 }
 
+// Allocation-free: Run A Thread On A Pre-Resolved CPU Set, see GetCPUSetView
+inline short RunOn(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const CoreTypes type, CPUSetView cpuSet, CPUSetView fallbackSet = CPUSetView())
+{
+	SetCoreTypeHints(threadHandle, type);
+	return RunOnCPUSet(procInfo, threadHandle, cpuSet, fallbackSet);
+}
+
+// Allocation-free: Run The Current Thread On A Pre-Resolved CPU Set, see GetCPUSetView
+inline short RunOn(PROCESSOR_INFO& procInfo, const CoreTypes type, CPUSetView cpuSet, CPUSetView fallbackSet = CPUSetView())
+{
+	HANDLE threadHandle = GetCurrentThread();
+	return RunOn(procInfo, threadHandle, type, cpuSet, fallbackSet);
+}
+
 // Run The Current Thread On Atom or Core Logical Processor Cluster
 #ifdef ENABLE_RUNON
-inline short RunOn(PROCESSOR_INFO& procInfo, const CoreTypes type, const std::vector<ULONG> fallbackSet = {})
+inline short RunOn(PROCESSOR_INFO& procInfo, const CoreTypes type, const std::vector<ULONG>& fallbackSet = {})
 {
 	HANDLE threadHandle = GetCurrentThread();
 	return RunOn(procInfo, threadHandle, type, fallbackSet);
 }
 #else
-inline short RunOn(PROCESSOR_INFO& , const CoreTypes , const std::vector<ULONG> fallbackSet = {})
+inline short RunOn(PROCESSOR_INFO& , const CoreTypes , const std::vector<ULONG>& fallbackSet = {})
 {
 	return 0;
 }
@@ -1328,12 +4654,12 @@ inline short RunOn(PROCESSOR_INFO& , const CoreTypes , const std::vector<ULONG>
 
 // Run A Thread On Any Logical Processor
 #ifdef ENABLE_RUNON
-inline short RunOnAny(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const std::vector<ULONG> fallbackSet = {})
+inline short RunOnAny(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const std::vector<ULONG>& fallbackSet = {})
 {
 	return RunOn(procInfo, threadHandle, CoreTypes::ANY, fallbackSet);
 }
 #else
-inline short RunOnAny(PROCESSOR_INFO& , HANDLE , const std::vector<ULONG> fallbackSet = {})
+inline short RunOnAny(PROCESSOR_INFO& , HANDLE , const std::vector<ULONG>& fallbackSet = {})
 {
 	return 0;
 }
@@ -1341,13 +4667,13 @@ inline short RunOnAny(PROCESSOR_INFO& , HANDLE , const std::vector<ULONG> fallba
 
 // Run The Current Thread On Any Logical Processor
 #ifdef ENABLE_RUNON
-inline short RunOnAny(PROCESSOR_INFO& procInfo, const std::vector<ULONG> fallbackSet = {})
+inline short RunOnAny(PROCESSOR_INFO& procInfo, const std::vector<ULONG>& fallbackSet = {})
 {
 	HANDLE threadHandle = GetCurrentThread();
 	return RunOnAny(procInfo, threadHandle, fallbackSet);
 }
 #else
-inline short RunOnAny(PROCESSOR_INFO& , const std::vector<ULONG> fallbackSet = {})
+inline short RunOnAny(PROCESSOR_INFO& , const std::vector<ULONG>& fallbackSet = {})
 {
 	return 0;
 }
@@ -1355,18 +4681,16 @@ inline short RunOnAny(PROCESSOR_INFO& , const std::vector<ULONG> fallbackSet = {
 
 // Run A Thread On One Logical Processor
 #ifdef ENABLE_RUNON
-inline short RunOnOne(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const short coreID, const std::vector<ULONG> fallbackSet = {})
+inline short RunOnOne(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const short coreID, const std::vector<ULONG>& fallbackSet = {})
 {
-	bool succeeded = false;
-
 #ifdef _DEBUG
 	// Where are we starting?
 	//int startedOn = GetCurrentProcessorNumber();
 #endif
-	if (coreID < procInfo.numLogicalCores)
+	if (coreID >= 0 && static_cast<unsigned>(coreID) < procInfo.numLogicalCores)
 	{
-		std::vector<ULONG> coreSet = { procInfo.cores[coreID].id };
-		short succeeded = RunOnCPUSet(procInfo, threadHandle, coreSet, fallbackSet);
+		const ULONG coreSet = procInfo.cores[coreID].id;
+		short succeeded = RunOnCPUSet(procInfo, threadHandle, CPUSetView(&coreSet, 1), ToCPUSetView(fallbackSet), false);
 
 #ifdef _DEBUG
 		// Check to see if the core is masked
@@ -1393,10 +4717,10 @@ inline short RunOnOne(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const short
 		return succeeded;
 	}
 
-	return RunOnCPUSet(procInfo, threadHandle, fallbackSet, procInfo.cpuSets[CoreTypes::ANY]);
+	return RunOnCPUSet(procInfo, threadHandle, ToCPUSetView(fallbackSet), GetCPUSetView(procInfo, CoreTypes::ANY), false);
 }
 #else
-inline short RunOnOne(PROCESSOR_INFO& , HANDLE , const short , const std::vector<ULONG> fallbackSet = {})
+inline short RunOnOne(PROCESSOR_INFO& , HANDLE , const short , const std::vector<ULONG>& fallbackSet = {})
 {
 	return -1;
 }
@@ -1404,13 +4728,13 @@ inline short RunOnOne(PROCESSOR_INFO& , HANDLE , const short , const std::vector
 
 // Run The Current Thread On One Logical Processor
 #ifdef ENABLE_RUNON
-inline bool RunOnOne(PROCESSOR_INFO& procInfo, const short coreID, const std::vector<ULONG> fallbackSet = {})
+inline bool RunOnOne(PROCESSOR_INFO& procInfo, const short coreID, const std::vector<ULONG>& fallbackSet = {})
 {
 	HANDLE threadHandle = GetCurrentThread();
 	return RunOnOne(procInfo, threadHandle, coreID, fallbackSet);
 }
 #else
-inline bool RunOnOne(PROCESSOR_INFO& , const short , const std::vector<ULONG> fallbackSet = {})
+inline bool RunOnOne(PROCESSOR_INFO& , const short , const std::vector<ULONG>& fallbackSet = {})
 {
 	return false;
 }
@@ -1418,50 +4742,109 @@ inline bool RunOnOne(PROCESSOR_INFO& , const short , const std::vector<ULONG> fa
 
 #else
 
-// Run A Current Thread On A Custom Logical Processor Cluster
-inline short RunOnMask(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const ULONG64 mask, const ULONG64 fallbackMask = 0xffffffff)
+#ifdef HYBRIDDETECT_OS_WIN
+// A Windows thread runs in a single processor group at a time. Selects the group holding most of the
+// logical processors in mask and returns the group relative affinity for SetThreadGroupAffinity.
+inline bool ProcessorMaskToGroupAffinity(const PROCESSOR_INFO& procInfo, const ProcessorMask& mask, GROUP_AFFINITY& groupAffinity)
 {
-#ifdef ENABLE_RUNON
 	DWORD_PTR  processAffinityMask;
 	DWORD_PTR  systemAffinityMask;
 
-	// Get the system and process affinity mask
+	// Get the system and process affinity mask (only reported for processes in a single group)
 	GetProcessAffinityMask(GetCurrentProcess(), &processAffinityMask, &systemAffinityMask);
 
-	ULONG64 threadAffinityMask = mask;
+	const unsigned numGroups = procInfo.groups.size() > 0 ? static_cast<unsigned>(procInfo.groups.size()) : 1;
+	size_t mostProcessors = 0;
+
+	groupAffinity = {};
+
+	for (unsigned group = 0; group < numGroups; group++)
+	{
+		const unsigned offset = GetGroupOffset(procInfo, group);
+		const unsigned count = procInfo.groups.size() > 0 ? procInfo.groups[group].activeProcessorCount : 64;
+		KAFFINITY groupMask = 0;
+
+		for (unsigned bit = 0; bit < count && bit < 64; bit++)
+		{
+			if (mask.Test(offset + bit)) groupMask |= static_cast<KAFFINITY>(IndexToMask(bit));
+		}
+
+		// Is the thread-mask allowed in this process?
+		if (numGroups == 1)
+		{
+			groupMask &= (processAffinityMask & systemAffinityMask);
+		}
+
+		const size_t processors = std::bitset<64>(groupMask).count();
+
+		if (processors > mostProcessors)
+		{
+			mostProcessors = processors;
+			groupAffinity.Group = static_cast<WORD>(group);
+			groupAffinity.Mask = groupMask;
+		}
+	}
+
+	return mostProcessors > 0;
+}
+#endif
+
+// Run A Current Thread On A Custom Logical Processor Cluster
+inline short RunOnMask(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const ProcessorMask& mask, const ProcessorMask& fallbackMask = 0xffffffff)
+{
+#if defined(ENABLE_RUNON) && defined(HYBRIDDETECT_OS_LINUX)
+	// Is the thread-mask allowed for this thread?
+	if (mask.Any() && SetThreadAffinityProcessorMask(threadHandle, mask))
+	{
+		return 1;
+	}
+
+	// Is fall-back thread-mask allowed for this thread?
+	if (fallbackMask.Any() && SetThreadAffinityProcessorMask(threadHandle, fallbackMask))
+	{
+		return 0;
+	}
+
+	// Fallback to any logical processor!
+	auto any = procInfo.coreMasks.find(static_cast<short>(CoreTypes::ANY));
 
-	//HYBRIDDETECT_DEBUG_REQUIRE((systemAffinityMask & threadAffinityMask));
-	//HYBRIDDETECT_DEBUG_REQUIRE((processAffinityMask & threadAffinityMask));
+	if (any != procInfo.coreMasks.end())
+	{
+		SetThreadAffinityProcessorMask(threadHandle, any->second);
+	}
+	return -1;
+#elif defined(ENABLE_RUNON)
+	GROUP_AFFINITY groupAffinity;
 
 	// Is the thread-mask allowed in this system/process?
-	if ((systemAffinityMask & threadAffinityMask) && (processAffinityMask & threadAffinityMask))
+	if (ProcessorMaskToGroupAffinity(procInfo, mask, groupAffinity))
 	{
 		// Run On Thread In Process
-		SetThreadAffinityMask(threadHandle, processAffinityMask & threadAffinityMask);
+		SetThreadGroupAffinity(threadHandle, &groupAffinity, nullptr);
 		return 1;
 	}
 
-	//HYBRIDDETECT_DEBUG_REQUIRE(systemAffinityMask & fallbackMask);
-	//HYBRIDDETECT_DEBUG_REQUIRE(processAffinityMask & fallbackMask);
-
 	// Is fall-back thread-mask allowed in this system/process?
-	if ((systemAffinityMask & fallbackMask) && (processAffinityMask & fallbackMask))
+	if (ProcessorMaskToGroupAffinity(procInfo, fallbackMask, groupAffinity))
 	{
-		SetThreadAffinityMask(threadHandle, processAffinityMask & fallbackMask);
+		SetThreadGroupAffinity(threadHandle, &groupAffinity, nullptr);
 		return 0;
 	}
-	else
+
+	// Fallback to any logical processor!
+	auto any = procInfo.coreMasks.find(static_cast<short>(CoreTypes::ANY));
+
+	if (any != procInfo.coreMasks.end() && ProcessorMaskToGroupAffinity(procInfo, any->second, groupAffinity))
 	{
-		// Fallback to process affinity mask!
-		SetThreadAffinityMask(threadHandle, processAffinityMask);
-		return -1;
+		SetThreadGroupAffinity(threadHandle, &groupAffinity, nullptr);
 	}
+	return -1;
 #endif
 	return -1;
 }
 
 // Run The Current Thread On A Custom Logical Processor Cluster
-inline short RunOnMask(PROCESSOR_INFO& procInfo, const ULONG64 mask, const ULONG64 fallbackMask = 0xffffffff)
+inline short RunOnMask(PROCESSOR_INFO& procInfo, const ProcessorMask& mask, const ProcessorMask& fallbackMask = 0xffffffff)
 {
 #ifdef ENABLE_RUNON
 	HANDLE threadHandle = GetCurrentThread();
@@ -1472,7 +4855,7 @@ inline short RunOnMask(PROCESSOR_INFO& procInfo, const ULONG64 mask, const ULONG
 }
 
 // Run A Thread On the Atom or Core Logical Processor Cluster
-inline short RunOn(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const CoreTypes type, const ULONG64 fallbackMask = 0xffffffff)
+inline short RunOn(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const CoreTypes type, const ProcessorMask& fallbackMask = 0xffffffff)
 {
 #ifdef ENABLE_RUNON_PRIORITY
 	switch (type)
@@ -1491,10 +4874,11 @@ inline short RunOn(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const CoreType
 #ifdef ENABLE_RUNON
 	//HYBRIDDETECT_DEBUG_REQUIRE(procInfo.coreMasks.size());
 
-	if (procInfo.coreMasks.size())
+	auto threadMask = procInfo.coreMasks.find(static_cast<short>(type));
+
+	if (threadMask != procInfo.coreMasks.end())
 	{
-		ULONG64 threadMask = procInfo.coreMasks[type];
-		return RunOnMask(procInfo, threadHandle, threadMask, fallbackMask);
+		return RunOnMask(procInfo, threadHandle, threadMask->second, fallbackMask);
 	}
 
 	return RunOnMask(procInfo, threadHandle, fallbackMask);
@@ -1504,7 +4888,7 @@ inline short RunOn(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const CoreType
 }
 
 // Run The Current Thread On Atom or Core Logical Processor Cluster
-inline short RunOn(PROCESSOR_INFO& procInfo, const CoreTypes type, const ULONG64 fallbackMask = 0xffffffff)
+inline short RunOn(PROCESSOR_INFO& procInfo, const CoreTypes type, const ProcessorMask& fallbackMask = 0xffffffff)
 {
 #ifdef ENABLE_RUNON
 	HANDLE threadHandle = GetCurrentThread();
@@ -1515,7 +4899,7 @@ inline short RunOn(PROCESSOR_INFO& procInfo, const CoreTypes type, const ULONG64
 }
 
 // Run A Thread On Any Logical Processor
-inline short RunOnAny(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const ULONG64 fallbackMask = 0xffffffff)
+inline short RunOnAny(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const ProcessorMask& fallbackMask = 0xffffffff)
 {
 #ifdef ENABLE_RUNON
 	return RunOn(procInfo, threadHandle, CoreTypes::ANY, fallbackMask);
@@ -1525,7 +4909,7 @@ inline short RunOnAny(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const ULONG
 }
 
 // Run The Current Thread On Any Logical Processor
-inline short RunOnAny(PROCESSOR_INFO& procInfo, const ULONG64 fallbackMask = 0xffffffff)
+inline short RunOnAny(PROCESSOR_INFO& procInfo, const ProcessorMask& fallbackMask = 0xffffffff)
 {
 #ifdef ENABLE_RUNON
 	HANDLE threadHandle = GetCurrentThread();
@@ -1536,7 +4920,7 @@ inline short RunOnAny(PROCESSOR_INFO& procInfo, const ULONG64 fallbackMask = 0xf
 }
 
 // Run A Thread On One Logical Processor
-inline bool RunOnOne(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const short coreID, const ULONG64 fallbackMask = 0xffffffff)
+inline bool RunOnOne(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const short coreID, const ProcessorMask& fallbackMask = 0xffffffff)
 {
 #ifdef ENABLE_RUNON
 	bool succeeded = false;
@@ -1547,7 +4931,7 @@ inline bool RunOnOne(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const short
 #endif
 	if (coreID < procInfo.numLogicalCores)
 	{
-		bool succeeded = RunOnMask(procInfo, threadHandle, IndexToMask(coreID), fallbackMask);
+		bool succeeded = RunOnMask(procInfo, threadHandle, IndexToProcessorMask(coreID), fallbackMask);
 
 #ifdef _DEBUG
 		// Check to see if the core is masked
@@ -1574,14 +4958,14 @@ inline bool RunOnOne(PROCESSOR_INFO& procInfo, HANDLE threadHandle, const short
 		return succeeded;
 	}
 
-	return RunOnMask(procInfo, threadHandle, IndexToMask(coreID), fallbackMask);
+	return RunOnMask(procInfo, threadHandle, IndexToProcessorMask(coreID), fallbackMask);
 #else
 	return false;
 #endif
 }
 
 // Run The Current Thread On One Logical Processor
-inline bool RunOnOne(PROCESSOR_INFO& procInfo, const short coreID, const ULONG64 fallbackMask = 0xffffffff)
+inline bool RunOnOne(PROCESSOR_INFO& procInfo, const short coreID, const ProcessorMask& fallbackMask = 0xffffffff)
 {
 #ifdef ENABLE_RUNON
 	HANDLE threadHandle = GetCurrentThread();
@@ -1593,4 +4977,152 @@ inline bool RunOnOne(PROCESSOR_INFO& procInfo, const short coreID, const ULONG64
 
 #endif
 
+// Size of the buffer streamed by the CALIBRATION_MEMORY kernel, well beyond the last level cache.
+#ifndef HYBRIDDETECT_CALIBRATION_MEMORY_SIZE
+#define HYBRIDDETECT_CALIBRATION_MEMORY_SIZE	(64 * 1024 * 1024)
+#endif
+
+// Calibration kernels: each runs a batch of work items & returns a value depending on all of them.
+inline ULONG64 CalibrateScalarInt(ULONG64 seed, unsigned items)
+{
+	ULONG64 a = seed, b = seed ^ 0x9E3779B97F4A7C15ULL;
+
+	for (unsigned i = 0; i < items; i++)
+	{
+		a = a * 6364136223846793005ULL + 1442695040888963407ULL;
+		b ^= b << 13;
+		b ^= b >> 7;
+		b ^= b << 17;
+		a += b;
+	}
+	return a ^ b;
+}
+
+inline float CalibrateSIMDFP32(float* data, unsigned count, unsigned passes)
+{
+	for (unsigned pass = 0; pass < passes; pass++)
+	{
+		for (unsigned i = 0; i < count; i++)
+		{
+			data[i] = data[i] * 0.9999f + 0.0001f;
+		}
+	}
+	return data[0];
+}
+
+inline ULONG64 CalibrateMemory(const ULONG64* data, size_t count)
+{
+	ULONG64 sum0 = 0, sum1 = 0, sum2 = 0, sum3 = 0;
+
+	for (size_t i = 0; i + 3 < count; i += 4)
+	{
+		sum0 += data[i];
+		sum1 += data[i + 1];
+		sum2 += data[i + 2];
+		sum3 += data[i + 3];
+	}
+	return sum0 + sum1 + sum2 + sum3;
+}
+
+// Runs short kernels (scalar integer, FP32 SIMD, memory streaming) on a thread pinned to each core type of
+// procInfo, one core type at a time, & stores the best of three runs of durationUs microseconds per kernel in
+// procInfo.scores. Core types with no allowed logical processor, or that the thread can't be pinned to, get no
+// score. Each run lasts at least durationUs & one pass over the memory kernel buffer (~100ms in
+// total per core type on current parts). Save the result with SaveProcessorInfo or let
+// GetProcessorInfoCached(..., true) persist it alongside the topology.
+inline bool CalibrateCoreTypes(PROCESSOR_INFO& procInfo, unsigned durationUs)
+{
+	HYBRID_DETECT_TRACE(5, ">>>");
+	procInfo.scores.clear();
+
+#ifdef ENABLE_RUNON
+	std::vector<CoreTypes> coreTypes;
+	for (const LOGICAL_PROCESSOR_INFO& logicalCore : procInfo.cores)
+	{
+		// Skip logical processors this process can't run on (affinity, cpuset).
+		if (procInfo.allowedMask.Any() && !logicalCore.processorMask.Intersects(procInfo.allowedMask))
+		{
+			continue;
+		}
+
+		if (std::find(coreTypes.begin(), coreTypes.end(), logicalCore.coreType) == coreTypes.end())
+		{
+			coreTypes.push_back(logicalCore.coreType);
+		}
+	}
+
+	std::vector<ULONG64> memory(HYBRIDDETECT_CALIBRATION_MEMORY_SIZE / sizeof(ULONG64));
+	for (size_t i = 0; i < memory.size(); i++) memory[i] = i;
+
+	for (CoreTypes coreType : coreTypes)
+	{
+		CORE_TYPE_SCORE score;
+		score.coreType = coreType;
+		bool pinned = true;
+
+		std::thread calibration([&]()
+		{
+			// RunOn returns 1 only when pinned to coreType, otherwise the kernels would measure wherever the thread lands.
+			if (coreTypes.size() > 1) pinned = RunOn(procInfo, coreType) == 1;
+			if (!pinned) return;
+
+			alignas(64) float data[1024];
+			for (float& value : data) value = 1.0f;
+			volatile ULONG64 sink = 0;
+
+			for (unsigned kernel = 0; kernel < CALIBRATION_KERNEL_COUNT; kernel++)
+			{
+				for (unsigned run = 0; run < 3; run++)
+				{
+					const auto start = std::chrono::steady_clock::now();
+					const auto deadline = start + std::chrono::microseconds(durationUs);
+					double items = 0.0;
+					auto now = start;
+
+					do
+					{
+						switch (kernel)
+						{
+						case CALIBRATION_SCALAR_INT:
+							sink = sink + CalibrateScalarInt(sink + 1, 4096);
+							items += 4096;
+							break;
+						case CALIBRATION_SIMD_FP32:
+							sink = sink + static_cast<ULONG64>(CalibrateSIMDFP32(data, 1024, 16));
+							items += 1024 * 16;
+							break;
+						default:
+							sink = sink + CalibrateMemory(memory.data(), memory.size());
+							items += static_cast<double>(memory.size());
+							break;
+						}
+						now = std::chrono::steady_clock::now();
+					} while (now < deadline);
+
+					const double elapsedUs = std::chrono::duration<double, std::micro>(now - start).count();
+					const double rate = items / elapsedUs;
+					if (rate > score.score[kernel]) score.score[kernel] = rate;
+				}
+			}
+		});
+		calibration.join();
+
+		if (!pinned)
+		{
+			HYBRID_DETECT_TRACE(5, "=== %s: pin failed, skipped", CoreTypeString(coreType));
+			continue;
+		}
+
+		HYBRID_DETECT_TRACE(5, "=== %s: int %f fp32 %f memory %f", CoreTypeString(coreType),
+			score.score[CALIBRATION_SCALAR_INT], score.score[CALIBRATION_SIMD_FP32], score.score[CALIBRATION_MEMORY]);
+		procInfo.scores.push_back(score);
+	}
+#else
+	(void)durationUs;
+#endif
+
+	HYBRID_DETECT_TRACE(5, "<<<");
+	return !procInfo.scores.empty();
+}
+
 } // namespace HybridDetect